@@ -0,0 +1,25 @@
+// (c) 2022 and onwards The vChewing Project (LGPL v3.0 License or later).
+// ====================
+// This code is released under the SPDX-License-Identifier: `LGPL-3.0-or-later`.
+
+// 全域 operator new 的計數器，用來檢查特定操作是否有配置記憶體。
+// 這些替換版運算子獨立放在這個編譯單元裡，免得編譯器把 free() 內聯到
+// 與 operator new 配對的呼叫端、進而誤報 -Wmismatched-new-delete。
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+std::atomic<size_t> allocationCount{0};
+std::atomic<size_t> allocatedBytes{0};
+
+void* operator new(size_t size) {
+  allocationCount++;
+  allocatedBytes += size;
+  if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
@@ -2,9 +2,23 @@
 // ====================
 // This code is released under the SPDX-License-Identifier: `LGPL-3.0-or-later`.
 
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <regex>
+#include <set>
+#include <thread>
+#include <type_traits>
+
 #include "../Sources/Tekkon/include/Tekkon.hh"
+#include "../Tools/TekkonConvert.hh"
 #include "gtest/gtest.h"
 
+// 全域 operator new 的計數器（見 AllocationCounter.cc），
+// 用來檢查特定操作是否有配置記憶體。
+extern std::atomic<size_t> allocationCount;
+extern std::atomic<size_t> allocatedBytes;
+
 namespace Tekkon {
 
 void checkEq(std::vector<std::string>* container, Composer* composer,
@@ -30,6 +44,36 @@ TEST(TekkonTests_Basic, InitializingPhonabet) {
   ASSERT_EQ(thePhonabetD.type, PhoneType::intonation);
 }
 
+TEST(TekkonTests_Basic, PhonabetClassification) {
+  // 注音區塊內的每個碼位都要與 allowed* 陣列的判定結果一致。
+  for (char32_t scalar = 0x3100; scalar <= 0x3130; scalar++) {
+    PhoneType expected = null;
+    if (contains(allowedConsonants, scalar)) expected = consonant;
+    if (contains(allowedSemivowels, scalar)) expected = semivowel;
+    if (contains(allowedVowels, scalar)) expected = vowel;
+    ASSERT_EQ(classifyPhonabet(scalar).type, expected);
+    ASSERT_EQ(Phonabet(scalar).type, expected);
+  }
+  for (char32_t scalar : allowedIntonations) {
+    ASSERT_EQ(classifyPhonabet(scalar).type, intonation);
+  }
+  ASSERT_EQ(classifyPhonabet(U'a').type, null);
+  ASSERT_EQ(classifyPhonabet(U'ㄪ').type, null);
+  static_assert(classifyPhonabet(U'ㄙ').type == consonant);
+  static_assert(classifyPhonabet(U'ㄙ').index == 21);
+  static_assert(classifyPhonabet(U'˙').index == 5);
+
+  // 建構 Phonabet 的過程不應配置任何記憶體。
+  size_t allocationsBefore = allocationCount.load();
+  for (char32_t scalar : allowedPhonabets) {
+    Phonabet thePhonabet = Phonabet(scalar);
+    ASSERT_NE(thePhonabet.type, null);
+  }
+  Phonabet thePhonabetFromString = Phonabet("ㄉ");
+  ASSERT_EQ(allocationCount.load(), allocationsBefore);
+  ASSERT_EQ(thePhonabetFromString.type, consonant);
+}
+
 TEST(TekkonTests_Basic, IsValidKeyWithKeys) {
   bool result;
   Tekkon::Composer composer = Composer("", ofDachen);
@@ -54,6 +98,128 @@ TEST(TekkonTests_Basic, IsValidKeyWithKeys) {
   ASSERT_TRUE(result);
 }
 
+TEST(TekkonTests_Basic, AsciiKeyTables) {
+  // ASCII 查詢表必須與各個 std::map 版本的鍵盤佈局完全一致。
+  std::vector<std::pair<MandarinParser, std::map<std::string, std::string>*>>
+      layouts = {
+          {ofDachen, &mapQwertyDachen.get()},
+          {ofDachen26, &mapDachenCP26StaticKeys.get()},
+          {ofETen, &mapQwertyETenTraditional.get()},
+          {ofHsu, &mapHsuStaticKeys.get()},
+          {ofETen26, &mapETen26StaticKeys.get()},
+          {ofIBM, &mapQwertyIBM.get()},
+          {ofMiTAC, &mapQwertyMiTAC.get()},
+          {ofSeigyou, &mapSeigyou.get()},
+          {ofFakeSeigyou, &mapFakeSeigyou.get()},
+          {ofStarlight, &mapStarlightStaticKeys.get()},
+          {ofAlvinLiu, &mapAlvinLiuStaticKeys.get()},
+      };
+  for (auto& [parser, map] : layouts) {
+    ASSERT_NE(asciiKeyTable(parser), nullptr);
+    Composer composer = Composer("", parser);
+    for (int code = 0; code < 128; code++) {
+      char key = static_cast<char>(code);
+      auto it = map->find(std::string(1, key));
+      char32_t expected = 0;
+      if (it != map->end()) expected = Phonabet(it->second).scalar();
+      ASSERT_EQ(lookupAsciiKey(parser, key), expected);
+      ASSERT_EQ(composer.inputValidityCheck(key), expected != 0);
+    }
+    ASSERT_FALSE(composer.inputValidityCheck(static_cast<char>(0xE3)));
+  }
+  ASSERT_EQ(asciiKeyTable(ofHanyuPinyin), nullptr);
+  static_assert(lookupAsciiKey(ofDachen, '1') == U'ㄅ');
+  static_assert(lookupAsciiKey(ofETen, '=') == U'ㄦ');
+
+  // 靜態注音排列的擊鍵處理不應配置任何記憶體。
+  Composer composer = Composer("", ofDachen);
+  size_t allocationsBefore = allocationCount.load();
+  for (char key : std::string("5j/4")) composer.receiveKey(key);
+  ASSERT_EQ(allocationCount.load(), allocationsBefore);
+  ASSERT_EQ(composer.getComposition(), "ㄓㄨㄥˋ");
+}
+
+// 於本檔案的動態初期化階段記錄：此時舊版 std::map 理應都還沒有被生成。
+static const bool legacyTablesUnbuiltAtStartup =
+    !mapHanyuPinyin.isBuilt() && !mapWadeGilesPinyin.isBuilt() &&
+    !mapQwertyDachen.isBuilt() && !mapArayuruPinyinIntonation.isBuilt() &&
+    !arrPhonaToHanyuPinyin.isBuilt();
+
+TEST(TekkonTests_Basic, CompileTimeStringTables) {
+  ASSERT_TRUE(legacyTablesUnbuiltAtStartup);
+  static_assert(std::is_trivially_destructible_v<
+                LazyTable<std::map<std::string, std::string>>>);
+  static_assert(pinyinReadingTable(ofHanyuPinyin).find("shi") == "ㄕ");
+  static_assert(!pinyinReadingTable(ofHanyuPinyin).contains("sh"));
+  static_assert(pinyinReadingTable(ofDachen).empty());
+  static_assert(contains(allowedPhonabets, U'˙'));
+  static_assert(allowedPhonabets.size() == 42);
+
+  // 編譯期對照表必須與按需生成的 std::map 完全一致，且排序方式相同。
+  for (MandarinParser parser : arrPinyinParsers) {
+    StringPairTable table = pinyinReadingTable(parser);
+    std::map<std::string, std::string>& map = *pinyinReadingMap(parser);
+    ASSERT_EQ(table.size(), map.size());
+    size_t i = 0;
+    for (const auto& [key, value] : map) {
+      ASSERT_EQ(table.sortedAt(i).key, key);
+      ASSERT_EQ(table.find(key), value);
+      ASSERT_FALSE(table.contains(key + "'"));
+      i++;
+    }
+    ASSERT_FALSE(table.contains(""));
+  }
+  ASSERT_EQ(mapArayuruPinyinIntonation.size(), 8);
+  ASSERT_EQ(mapArayuruPinyinIntonation["7"], "˙");
+  ASSERT_EQ(arrPhonaToHanyuPinyin[0][0], " ");
+  ASSERT_EQ(arrPhonaToHanyuPinyin.size(),
+            _phonaToHanyuPinyinTable.view().size());
+  ASSERT_EQ(mapQwertyDachen.count("1"), 1);
+  ASSERT_TRUE(mapQwertyDachen.isBuilt());
+  // 同一份生成結果會一直沿用。
+  ASSERT_EQ(&mapQwertyDachen.get(), &mapQwertyDachen.get());
+
+  // 舊版 std::map 的唯讀成員函式皆可直接呼叫。
+  ASSERT_EQ(mapHanyuPinyin.at("zhong"), "ㄓㄨㄥ");
+  ASSERT_EQ(mapHanyuPinyin.lower_bound("zho")->first, "zhong");
+  ASSERT_EQ(mapHanyuPinyin.upper_bound("zuo"), mapHanyuPinyin.end());
+  ASSERT_EQ(mapHanyuPinyin.equal_range("ang").first->second, "ㄤ");
+  ASSERT_EQ(mapHanyuPinyin.rbegin()->first, "zuo");
+  ASSERT_EQ(arrPhonaToHanyuPinyin.front()[1], "1");
+  std::map<std::string, std::string> copied = mapHanyuPinyin;
+  ASSERT_EQ(copied.size(), mapHanyuPinyin.size());
+}
+
+TEST(TekkonTests_Basic, DynamicLayoutTransitionTables) {
+  using Table = DynamicLayoutTransitionTable;
+  for (uint16_t state = 0; state < Table::stateCount; state++) {
+    ASSERT_EQ(Table::stateIndex(Table::readingAt(state)), state);
+  }
+  ASSERT_EQ(Composer::_transitionTable(ofDachen, false), nullptr);
+  ASSERT_EQ(Composer::_transitionTable(ofHanyuPinyin, false), nullptr);
+
+  // 事先算好的表格應該每一格都有內容。
+  Composer::prepareTransitionTable(ofHsu);
+  Table* table = Composer::_transitionTable(ofHsu, false);
+  ASSERT_NE(table, nullptr);
+  for (uint16_t state = 0; state < Table::stateCount; state++) {
+    for (size_t slot = 0; slot < table->slotCount(); slot++) {
+      uint32_t cell = table->cell(state, static_cast<uint8_t>(slot)).load();
+      ASSERT_TRUE(cell & Table::computedFlag);
+    }
+  }
+  uint32_t cell = table->cell(0, table->slotOf('b')).load();
+  ASSERT_EQ(Table::emittedPhonabet(cell), U'ㄅ');
+  ASSERT_EQ(Table::newState(cell).value(), "ㄅ");
+
+  // 表格算好之後，動態注音排列的擊鍵處理不應配置任何記憶體。
+  Composer composer = Composer("", ofHsu);
+  size_t allocationsBefore = allocationCount.load();
+  for (char key : std::string("gewd")) composer.receiveKey(key);
+  ASSERT_EQ(allocationCount.load(), allocationsBefore);
+  ASSERT_EQ(composer.getComposition(), "ㄍㄧㄠˊ");
+}
+
 // =========== COMPOSER POKAYOKE TESTS ===========
 
 TEST(TekkonTests_Basic, PhonabetCombinationCorrection) {
@@ -97,6 +263,463 @@ TEST(TekkonTests_Basic, PhonabetCombinationCorrection) {
   ASSERT_EQ(composer.value(), "ㄐㄩㄢˋ");
 }
 
+// 並擊糾正原本的寫法（直接操作 Phonabet），用作查表版本的對照組。
+// 回傳實際要寫入的注音符號。
+static char32_t legacyCorrectCombination(Composer& composer,
+                                         char32_t phonabet) {
+  Phonabet& consonant = composer.consonant;
+  Phonabet& semivowel = composer.semivowel;
+  Phonabet& vowel = composer.vowel;
+  Phonabet thePhone = Phonabet(phonabet);
+  switch (phonabet) {
+    case U'ㄧ':
+    case U'ㄩ':
+      if (vowel.scalar() == U'ㄜ') vowel = Phonabet(U'ㄝ');
+      break;
+    case U'ㄜ':
+      if (semivowel.scalar() == U'ㄨ') semivowel = Phonabet(U'ㄩ');
+      if (semivowel.scalar() == U'ㄧ' || semivowel.scalar() == U'ㄩ')
+        thePhone = Phonabet(U'ㄝ');
+      break;
+    case U'ㄝ':
+      if (semivowel.scalar() == U'ㄨ') semivowel = Phonabet(U'ㄩ');
+      break;
+    case U'ㄛ':
+      if (semivowel.scalar() == U'ㄩ') semivowel = Phonabet(U'ㄨ');
+      if ((consonant.scalar() == U'ㄅ' || consonant.scalar() == U'ㄆ' ||
+           consonant.scalar() == U'ㄇ' || consonant.scalar() == U'ㄈ') &&
+          semivowel.scalar() == U'ㄨ')
+        semivowel.clear();
+      break;
+    case U'ㄥ':
+      if ((consonant.scalar() == U'ㄅ' || consonant.scalar() == U'ㄆ' ||
+           consonant.scalar() == U'ㄇ' || consonant.scalar() == U'ㄈ') &&
+          semivowel.scalar() == U'ㄨ')
+        semivowel.clear();
+      break;
+    case U'ㄟ':
+      if ((consonant.scalar() == U'ㄋ' || consonant.scalar() == U'ㄌ') &&
+          (semivowel.scalar() == U'ㄨ'))
+        semivowel.clear();
+      break;
+    case U'ㄨ':
+      if ((consonant.scalar() == U'ㄅ' || consonant.scalar() == U'ㄆ' ||
+           consonant.scalar() == U'ㄇ' || consonant.scalar() == U'ㄈ') &&
+          (vowel.scalar() == U'ㄛ' || vowel.scalar() == U'ㄥ'))
+        vowel.clear();
+      if ((consonant.scalar() == U'ㄋ' || consonant.scalar() == U'ㄌ') &&
+          (vowel.scalar() == U'ㄟ'))
+        vowel.clear();
+      if (vowel.scalar() == U'ㄜ') vowel = Phonabet(U'ㄝ');
+      if (vowel.scalar() == U'ㄝ') thePhone = Phonabet(U'ㄩ');
+      break;
+    case U'ㄅ':
+    case U'ㄆ':
+    case U'ㄇ':
+    case U'ㄈ':
+      if ((semivowel.scalar() == U'ㄨ' && vowel.scalar() == U'ㄛ') ||
+          (semivowel.scalar() == U'ㄨ' && vowel.scalar() == U'ㄥ'))
+        semivowel.clear();
+      break;
+    default:
+      break;
+  }
+  if ((thePhone.type == PhoneType::vowel ||
+       thePhone.type == PhoneType::intonation) &&
+      (consonant.scalar() == U'ㄓ' || consonant.scalar() == U'ㄔ' ||
+       consonant.scalar() == U'ㄕ' || consonant.scalar() == U'ㄗ' ||
+       consonant.scalar() == U'ㄘ' || consonant.scalar() == U'ㄙ')) {
+    switch (semivowel.scalar()) {
+      case U'ㄧ':
+        semivowel.clear();
+        break;
+      case U'ㄩ':
+        if (consonant.scalar() == U'ㄓ' || consonant.scalar() == U'ㄗ')
+          consonant = Phonabet(U'ㄐ');
+        if (consonant.scalar() == U'ㄔ' || consonant.scalar() == U'ㄘ')
+          consonant = Phonabet(U'ㄑ');
+        if (consonant.scalar() == U'ㄕ' || consonant.scalar() == U'ㄙ')
+          consonant = Phonabet(U'ㄒ');
+        break;
+      default:
+        break;
+    }
+  }
+  return thePhone.scalar();
+}
+
+TEST(TekkonTests_Basic, PhonabetCombinationCorrectionTable) {
+  static_assert(DynamicLayoutTransitionTable::newState(_correctCombination(
+                    PackedReading::fromString("ㄓㄩ"), U'ˋ')) ==
+                PackedReading::fromString("ㄐㄩ"));
+  static_assert(DynamicLayoutTransitionTable::emittedPhonabet(
+                    _correctCombination(PackedReading::fromString("ㄋㄟ"),
+                                        U'ㄨ')) == U'ㄨ');
+
+  for (uint16_t index = 0; index < DynamicLayoutTransitionTable::stateCount;
+       index++) {
+    PackedReading state = DynamicLayoutTransitionTable::readingAt(index);
+    for (char32_t phonabet : allowedPhonabets) {
+      ASSERT_EQ(_correctCombination(state, phonabet),
+                _correctCombinationReference(state, phonabet))
+          << state.value() << " + " << char32ToString(phonabet);
+
+      Composer legacy("", ofDachen, false);
+      legacy.setPackedReading(state);
+      legacy.receiveKeyFromPhonabet(legacyCorrectCombination(legacy, phonabet));
+      Composer composer("", ofDachen, true);
+      composer.setPackedReading(state);
+      composer.receiveKeyFromPhonabet(phonabet);
+      ASSERT_EQ(composer.value(), legacy.value())
+          << state.value() << " + " << char32ToString(phonabet);
+    }
+  }
+}
+
+TEST(TekkonTests_Basic, ValidSyllables) {
+  static_assert(PackedReading::fromString("ㄓㄨㄤˋ").isValidSyllable());
+  static_assert(PackedReading::fromString("ㄓ").isValidSyllable());
+  static_assert(!PackedReading::fromString("ㄅ").isValidSyllable());
+  static_assert(!PackedReading::fromString("ㄅㄩ").isValidSyllable());
+  static_assert(!PackedReading::fromString("ˇ").isValidSyllable());
+  static_assert(!PackedReading().isValidSyllable());
+
+  // 位元集合與各拼音對照表的注音一側完全一致。
+  std::set<uint16_t> expected;
+  for (MandarinParser parser :
+       {ofHanyuPinyin, ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+        ofUniversalPinyin, ofWadeGilesPinyin}) {
+    for (const StringPair& pair : pinyinReadingTable(parser)) {
+      expected.insert(PackedReading::fromString(pair.value).raw);
+    }
+  }
+  size_t validCount = 0;
+  for (uint16_t index = 0; index < DynamicLayoutTransitionTable::stateCount;
+       index++) {
+    PackedReading reading = DynamicLayoutTransitionTable::readingAt(index);
+    PackedReading toneless = reading.without(PhoneType::intonation);
+    ASSERT_EQ(reading.isValidSyllable(), expected.count(toneless.raw) > 0)
+        << reading.value();
+    if (reading.isValidSyllable() && !reading.intonationIndex()) validCount++;
+  }
+  ASSERT_EQ(validCount, expected.size());
+
+  Composer composer = Composer("", ofDachen);
+  composer.receiveKeyFromPhonabet("ㄅ");
+  ASSERT_TRUE(composer.isPronounceable());
+  ASSERT_FALSE(composer.isValidSyllable());
+  composer.receiveKeyFromPhonabet("ㄚ");
+  composer.receiveKeyFromPhonabet("ˇ");
+  ASSERT_TRUE(composer.isValidSyllable());
+  composer.clear();
+  composer.receiveKeyFromPhonabet("ˇ");
+  ASSERT_FALSE(composer.isValidSyllable());
+}
+
+TEST(TekkonTests_Basic, ReadingIDs) {
+  // 序號需在各版本之間保持不變，故這裡寫死幾個已知的值。
+  static_assert(PackedReading::readingIDCount == 6160);
+  static_assert(readingIDFromZhuyin("") == 0);
+  static_assert(readingIDFromZhuyin("ㄅ") == 280);
+  static_assert(readingIDFromZhuyin("ㄓㄨㄤˋ") == 4398);
+  static_assert(readingIDFromZhuyin("ㄓㄨㄤ ") == 4395);
+  static_assert(readingIDFromPinyin("zhuang4") == 4398);
+  static_assert(readingIDFromPinyin("jwang4", ofYalePinyin) == 4398);
+  static_assert(readingIDFromPinyin("zhuangx") == 0);
+  ASSERT_EQ(readingIDToZhuyin(4398), "ㄓㄨㄤˋ");
+  ASSERT_EQ(readingIDToHanyuPinyin(4398), "zhuang4");
+
+  for (uint16_t id = 0; id < PackedReading::readingIDCount; id++) {
+    PackedReading reading = PackedReading::fromReadingID(id);
+    ASSERT_EQ(reading.readingID(), id);
+    ASSERT_EQ(readingIDFromZhuyin(readingIDToZhuyin(id)), id);
+  }
+  ASSERT_TRUE(PackedReading::fromReadingID(6160).isEmpty());
+
+  // 與 phonabetKeyForQuery() 逐一比對。
+  for (uint16_t index = 0; index < DynamicLayoutTransitionTable::stateCount;
+       index++) {
+    PackedReading reading = DynamicLayoutTransitionTable::readingAt(index);
+    for (MandarinParser parser : {ofDachen, ofHanyuPinyin}) {
+      for (bool pronounceableOnly : {false, true}) {
+        Composer composer("", parser);
+        composer.setPackedReading(reading);
+        std::string key = composer.phonabetKeyForQuery(pronounceableOnly);
+        uint16_t id = composer.readingIDForQuery(pronounceableOnly);
+        ASSERT_EQ(id == 0, key.empty()) << reading.value();
+        ASSERT_EQ(readingIDToZhuyin(id), key) << reading.value();
+      }
+    }
+  }
+}
+
+TEST(TekkonTests_Basic, KeySequenceCache) {
+  KeySequenceCache& cache = KeySequenceCache::shared();
+  ASSERT_FALSE(cache.isEnabled());
+  Composer composer("", ofDachen);
+  ASSERT_EQ(composer.receiveSequence("su3"), "ㄋㄧˇ");
+  ASSERT_EQ(cache.misses(), 0u);
+
+  cache.setCapacity(100);
+  ASSERT_EQ(cache.capacity(), 128u);
+  ASSERT_EQ(composer.receiveSequence("su3"), "ㄋㄧˇ");
+  ASSERT_EQ(composer.receiveSequence("su3"), "ㄋㄧˇ");
+  ASSERT_EQ(cache.hits(), 1u);
+  ASSERT_EQ(cache.misses(), 1u);
+  // 不同的注音排列與開關各自獨立。
+  Composer eten("", ofETen);
+  ASSERT_EQ(eten.receiveSequence("su3"), eten.receiveSequence("su3"));
+  eten.phonabetCombinationCorrectionEnabled = true;
+  eten.receiveSequence("su3");
+  ASSERT_EQ(cache.hits(), 2u);
+  ASSERT_EQ(cache.misses(), 3u);
+  // 拼音排列與過長的擊鍵序列不經過快取。
+  Composer pinyin("", ofHanyuPinyin);
+  pinyin.receiveSequence("ni3");
+  composer.receiveSequence(std::string(KeySequenceCache::maxSequenceLength + 1,
+                                       's'));
+  ASSERT_EQ(cache.hits() + cache.misses(), 5u);
+
+  // 槽位極少（頻繁互相覆蓋）的情況下，結果仍須與不經快取時一致。
+  std::mt19937 generator(20221016);
+  std::string keys = "1qaz2wsx3edc4rfv5tgb6yhn7ujm8ik,9ol.0p;/-";
+  for (size_t capacity : {1, 4, 1024}) {
+    cache.setCapacity(capacity);
+    for (MandarinParser parser :
+         {ofDachen, ofDachen26, ofETen, ofETen26, ofHsu, ofIBM, ofMiTAC,
+          ofSeigyou, ofStarlight, ofAlvinLiu}) {
+      for (int round = 0; round < 300; round++) {
+        std::string sequence;
+        for (int i = generator() % 5; i >= 0; i--) {
+          sequence += keys[generator() % keys.size()];
+        }
+        bool correction = generator() % 2;
+        bool ordering = generator() % 2;
+        Composer cached("", parser, correction);
+        cached.enforceCSVTOrdering = ordering;
+        Composer uncached = cached;
+        for (char key : sequence) {
+          if (!uncached.receiveKey(key)) break;
+        }
+        // 先讓快取記下結果，再確認命中時的結果無誤。
+        cached.receiveSequence(sequence);
+        ASSERT_EQ(cached.receiveSequence(sequence), uncached.value())
+            << parser << ": " << sequence;
+        ASSERT_EQ(cached.getComposition(true), uncached.getComposition(true));
+      }
+    }
+    ASSERT_GT(cache.hits(), 0u);
+  }
+
+  // 多個執行緒共用同一份快取時，結果仍須與不經快取時一致。
+  cache.setCapacity(64);
+  std::vector<std::thread> threads;
+  std::atomic<size_t> mismatches{0};
+  for (unsigned seed = 0; seed < 4; seed++) {
+    threads.emplace_back([seed, &keys, &mismatches] {
+      std::mt19937 threadGenerator(seed);
+      for (int round = 0; round < 2000; round++) {
+        std::string sequence;
+        for (int i = threadGenerator() % 4; i >= 0; i--) {
+          sequence += keys[threadGenerator() % keys.size()];
+        }
+        Composer cached("", round % 2 ? ofHsu : ofDachen);
+        Composer uncached = cached;
+        for (char key : sequence) {
+          if (!uncached.receiveKey(key)) break;
+        }
+        if (cached.receiveSequence(sequence) != uncached.value()) mismatches++;
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  ASSERT_EQ(mismatches.load(), 0u);
+  ASSERT_GT(cache.hits(), 0u);
+
+  cache.setCapacity(0);
+  ASSERT_FALSE(cache.isEnabled());
+}
+
+TEST(TekkonTests_Basic, KeyStreamParsing) {
+  std::vector<PackedReading> readings;
+  Composer::parseKeyStream("su3cl3gj94", ofDachen, readings);
+  ASSERT_EQ(readings.size(), 3u);
+  ASSERT_EQ(readings[0].value(), "ㄋㄧˇ");
+  ASSERT_EQ(readings[1].value(), "ㄏㄠˇ");
+  ASSERT_EQ(readings[2].value(), "ㄕㄨㄞˋ");
+  std::vector<uint16_t> ids;
+  Composer::parseKeyStream("ni3hao3shuai", ofHanyuPinyin, ids);
+  ASSERT_EQ(ids.size(), 3u);
+  ASSERT_EQ(readingIDToZhuyin(ids[0]), "ㄋㄧˇ");
+  ASSERT_EQ(readingIDToZhuyin(ids[1]), "ㄏㄠˇ");
+  ASSERT_EQ(readingIDToZhuyin(ids[2]), "ㄕㄨㄞ");
+  // 只有聲調的讀音會被略過。
+  Composer::parseKeyStream("3su3 ", ofDachen, readings);
+  ASSERT_EQ(readings.size(), 1u);
+
+  // 注音排列：按鍵要填入的槽位已有內容時，先收下既有的讀音。
+  Composer::parseKeyStream("sucl3", ofDachen, readings);
+  ASSERT_EQ(readings.size(), 2u);
+  ASSERT_EQ(readings[0].value(), "ㄋㄧ");
+  ASSERT_EQ(readings[1].value(), "ㄏㄠˇ");
+  Composer::parseKeyStream("5j/5j/", ofDachen, readings);
+  ASSERT_EQ(readings.size(), 2u);
+  ASSERT_EQ(readings[1].value(), "ㄓㄨㄥ");
+
+  // 拼音排列：兩個聲調之間的字母串沿字首樹切成音節。
+  Composer::parseKeyStream("nihao3", ofHanyuPinyin, readings);
+  ASSERT_EQ(readings.size(), 2u);
+  ASSERT_EQ(readings[0].value(), "ㄋㄧ");
+  ASSERT_EQ(readings[1].value(), "ㄏㄠˇ");
+  Composer::parseKeyStream("zhongguo2", ofHanyuPinyin, readings);
+  ASSERT_EQ(readings.size(), 2u);
+  ASSERT_EQ(readings[0].value(), "ㄓㄨㄥ");
+  ASSERT_EQ(readings[1].value(), "ㄍㄨㄛˊ");
+  Composer::parseKeyStream("woaibeijingtiananmen", ofHanyuPinyin, readings);
+  ASSERT_EQ(readings.size(), 7u);
+  ASSERT_EQ(readings[6].value(), "ㄇㄣ");
+  Composer::parseKeyStream("ch'ung2ch'ing4", ofWadeGilesPinyin, readings);
+  ASSERT_EQ(readings.size(), 2u);
+  ASSERT_EQ(readings[0].value(), "ㄔㄨㄥˊ");
+  ASSERT_EQ(readings[1].value(), "ㄑㄧㄥˋ");
+
+  // 拼音排列：每個音節都帶聲調時，結果與逐個音節處理一致。
+  std::mt19937 generator(20221016);
+  for (MandarinParser parser : arrPinyinParsers) {
+    StringPairTable table = pinyinReadingTable(parser);
+    for (int round = 0; round < 200; round++) {
+      std::string stream;
+      std::vector<PackedReading> expected;
+      for (int i = generator() % 8; i >= 0; i--) {
+        const StringPair& pair = table.sortedAt(generator() % table.size());
+        char tone = static_cast<char>('1' + generator() % 5);
+        stream += std::string(pair.key) + tone;
+        Composer composer("", parser);
+        composer.receiveSequence(std::string(pair.key), true);
+        composer.receiveKey(std::string(1, tone));
+        expected.push_back(composer.packedReading());
+      }
+      Composer::parseKeyStream(stream, parser, readings);
+      ASSERT_EQ(readings, expected) << parser << ": " << stream;
+    }
+  }
+
+  // 注音排列：與逐鍵處理（並在槽位衝突時斷開）的結果一致。
+  std::string keys = "1qaz2wsx3edc4rfv5tgb6yhn7ujm8ik,9ol.0p;/- ";
+  for (MandarinParser parser :
+       {ofDachen, ofDachen26, ofETen, ofETen26, ofHsu, ofIBM, ofMiTAC,
+        ofSeigyou, ofStarlight, ofAlvinLiu}) {
+    // 參照結果直接讀取狀態轉移表，故事先填好整張表。
+    Composer::prepareTransitionTable(parser, true);
+    for (int round = 0; round < 200; round++) {
+      std::string stream;
+      for (int i = generator() % 30; i >= 0; i--) {
+        stream += keys[generator() % keys.size()];
+      }
+      std::vector<PackedReading> expected;
+      Composer composer("", parser, true);
+      DynamicLayoutTransitionTable* table =
+          Composer::_transitionTable(parser, true);
+      for (char key : stream) {
+        if (composer.isPronounceable()) {
+          PackedReading current = composer.packedReading();
+          char32_t incoming = lookupAsciiKey(parser, key);
+          if (table) {
+            incoming = DynamicLayoutTransitionTable::emittedPhonabet(
+                table->cell(DynamicLayoutTransitionTable::stateIndex(current),
+                            table->slotOf(key))
+                    .load());
+          }
+          PhoneType type = PackedReading::typeOf(incoming);
+          if (type != null && type != PhoneType::intonation &&
+              current.indexAt(type)) {
+            expected.push_back(composer.packedReading());
+            composer.clear();
+          }
+        }
+        composer.receiveKey(key);
+        if (!composer.hasIntonation()) continue;
+        if (composer.isPronounceable()) {
+          expected.push_back(PackedReading::fromString(composer.value()));
+        }
+        composer.clear();
+      }
+      if (composer.isPronounceable()) {
+        expected.push_back(PackedReading::fromString(composer.value()));
+      }
+      Composer::parseKeyStream(stream, parser, readings, true);
+      ASSERT_EQ(readings, expected) << parser << ": " << stream;
+      Composer::parseKeyStream(stream, parser, ids, true);
+      ASSERT_EQ(ids.size(), expected.size());
+      for (size_t i = 0; i < ids.size(); i++) {
+        ASSERT_EQ(ids[i], expected[i].readingID());
+      }
+    }
+  }
+
+  // 結果陣列的容量足夠時，整個過程不配置任何記憶體。
+  Composer::prepareTransitionTable(ofETen26);
+  for (MandarinParser parser : {ofDachen, ofETen26}) {
+    readings.reserve(64);
+    size_t allocationsBefore = allocationCount.load();
+    Composer::parseKeyStream("su3cl3gj94su3cl3gj94su3cl3gj94", parser,
+                             readings);
+    ASSERT_EQ(allocationCount.load(), allocationsBefore) << parser;
+  }
+}
+
+TEST(TekkonTests_Basic, PackedReadingConversions) {
+  Composer composer = Composer("", ofDachen);
+  ASSERT_TRUE(composer.packedReading().isEmpty());
+
+  composer.receiveSequence("xu;6");
+  PackedReading packed = composer.packedReading();
+  ASSERT_EQ(packed.value(), composer.value());
+  ASSERT_EQ(packed.value(), "ㄌㄧㄤˊ");
+  ASSERT_EQ(PackedReading::fromString(composer.value()), packed);
+  ASSERT_EQ(packed.consonant(), U'ㄌ');
+  ASSERT_EQ(packed.semivowel(), U'ㄧ');
+  ASSERT_EQ(packed.vowel(), U'ㄤ');
+  ASSERT_EQ(packed.intonation(), U'ˊ');
+  ASSERT_EQ(packed.count(), composer.count());
+  ASSERT_EQ(packed.count(true), composer.count(true));
+  ASSERT_EQ(packed.isPronounceable(), composer.isPronounceable());
+  ASSERT_EQ(packed.hasIntonation(), composer.hasIntonation());
+  ASSERT_EQ(packed.hasIntonation(true), composer.hasIntonation(true));
+
+  // 陰平（空格）也要能完整地來回轉換。
+  ASSERT_EQ(PackedReading::fromString("ㄅㄚ ").value(), "ㄅㄚ ");
+  ASSERT_TRUE(PackedReading::fromString("ˇ").hasIntonation(true));
+  ASSERT_FALSE(PackedReading::fromString("ㄅ").hasIntonation());
+
+  // 以快照還原注拼槽狀態。
+  Composer restored = Composer("", ofDachen);
+  restored.setPackedReading(packed);
+  ASSERT_EQ(restored.value(), "ㄌㄧㄤˊ");
+  restored.setPackedReading(packed.without(PhoneType::intonation));
+  ASSERT_EQ(restored.value(), "ㄌㄧㄤ");
+  restored.setPackedReading(PackedReading());
+  ASSERT_TRUE(restored.isEmpty());
+
+  // 遍歷全部組合，確認字串與整數之間的轉換不失真。
+  for (uint16_t c = 0; c <= 21; c++) {
+    for (uint16_t s = 0; s <= 3; s++) {
+      for (uint16_t v = 0; v <= 13; v++) {
+        for (uint16_t t = 0; t <= 5; t++) {
+          PackedReading reading = PackedReading()
+                                      .withIndex(PhoneType::consonant, c)
+                                      .withIndex(PhoneType::semivowel, s)
+                                      .withIndex(PhoneType::vowel, v)
+                                      .withIndex(PhoneType::intonation, t);
+          ASSERT_EQ(PackedReading::fromString(reading.value()), reading);
+          restored.setPackedReading(reading);
+          ASSERT_EQ(restored.packedReading(), reading);
+        }
+      }
+    }
+  }
+}
+
 // =========== PHONABET TYPINNG HANDLING TESTS (BASIC) ===========
 
 TEST(TekkonTests_Basic, PhonabetKeyReceivingAndCompositions) {
@@ -234,6 +857,209 @@ TEST(TekkonTests_Basic, PhonabetKeyReceivingAndCompositions) {
             "ㄅㄧㄢˋ-˙ㄌㄜ-ㄊㄧㄢ");
 }
 
+// 舊版的 cnvHanyuPinyinToPhona，用作自動機版本的對照組。
+std::string legacyCnvHanyuPinyinToPhona(std::string targetJoined,
+                                        std::string newToneOne) {
+  std::regex str_reg(".*[^A-Za-z0-9 \\t-].*");
+  std::smatch matchResult;
+  if (stringInclusion(targetJoined, "_") ||
+      std::regex_match(targetJoined, matchResult, str_reg))
+    return targetJoined;
+  std::string strResult = std::move(targetJoined);
+  std::vector<std::string> keyListHYPY;
+  for (auto const& i : mapHanyuPinyin) keyListHYPY.push_back(i.first);
+  std::sort(keyListHYPY.begin(), keyListHYPY.end(),
+            [](const std::string& first, const std::string& second) {
+              return first.size() > second.size();
+            });
+  std::vector<std::string> keyListIntonation;
+  for (auto const& i : mapArayuruPinyinIntonation)
+    keyListIntonation.push_back(i.first);
+  std::sort(keyListIntonation.begin(), keyListIntonation.end(),
+            [](const std::string& first, const std::string& second) {
+              return first.size() > second.size();
+            });
+  for (auto i : keyListHYPY) {
+    replaceOccurrences(strResult, i, mapHanyuPinyin[i]);
+  }
+  for (auto i : keyListIntonation) {
+    replaceOccurrences(strResult, i,
+                       i == "1" ? newToneOne : mapArayuruPinyinIntonation[i]);
+  }
+  return strResult;
+}
+
+TEST(TekkonTests_Basic, HanyuPinyinToPhonaAutomaton) {
+  std::vector<std::string> keys;
+  for (auto const& i : mapHanyuPinyin) keys.push_back(i.first);
+  std::vector<std::string> fragments = {
+      "a", "e", "g", "n", "r", "u", "v", "1", "2", "3", "4", "5", "6",
+      "7", " ", "-", "\t", "A", "Zh", "_", "\n", "\r", ".", "ü", "ㄅ"};
+  std::vector<std::string> toneOnes = {"", " ", "1", "2x", "5", "ˉ"};
+  std::mt19937 generator(20221016);
+  for (int round = 0; round < 4000; round++) {
+    std::string target;
+    size_t pieces = generator() % 12;
+    for (size_t i = 0; i < pieces; i++) {
+      // 多數時候拼接完整的拼音鍵，偶爾夾雜其他片段。
+      if (generator() % 3)
+        target += keys[generator() % keys.size()];
+      else
+        target += fragments[generator() % fragments.size()];
+    }
+    std::string toneOne = toneOnes[generator() % toneOnes.size()];
+    ASSERT_EQ(cnvHanyuPinyinToPhona(target, toneOne),
+              legacyCnvHanyuPinyinToPhona(target, toneOne))
+        << "target: " << target << ", newToneOne: " << toneOne;
+  }
+  ASSERT_EQ(cnvHanyuPinyinToPhona("zhuang1 shuang1", "1"),
+            "ㄓㄨㄤ1 ㄕㄨㄤ1");
+  ASSERT_EQ(cnvHanyuPinyinToPhona("a\nb\nc_d"), "a\nb\nc_d");
+  ASSERT_EQ(cnvHanyuPinyinToPhona("ba1.\nba1\nba1"), "ㄅㄚ.\nㄅㄚ\nㄅㄚ");
+}
+
+// 舊版的 cnvPhonaToHanyuPinyin，用作字首樹版本的對照組。
+std::string legacyCnvPhonaToHanyuPinyin(std::string targetJoined) {
+  static std::map<std::string, std::string> lut = [] {
+    std::map<std::string, std::string> result;
+    for (const auto& pair : arrPhonaToHanyuPinyin) result[pair[0]] = pair[1];
+    return result;
+  }();
+  auto codepoints = splitByCodepoint(targetJoined);
+  std::string result;
+  size_t i = 0;
+  size_t n = codepoints.size();
+  while (i < n) {
+    bool matched = false;
+    for (size_t len = std::min<size_t>(3, n - i); len >= 1; len--) {
+      std::string key;
+      for (size_t k = i; k < i + len; k++) key += codepoints[k];
+      auto it = lut.find(key);
+      if (it != lut.end()) {
+        result += it->second;
+        i += len;
+        matched = true;
+        break;
+      }
+    }
+    if (!matched) result += codepoints[i++];
+  }
+  return result;
+}
+
+TEST(TekkonTests_Basic, PhonaToHanyuPinyinTrie) {
+  std::vector<std::string> fragments = {
+      "ㄅ", "ㄓ", "ㄨ", "ㄤ", "ㄧ", "ㄢ", "ㄩ", "ㄝ", "ㄦ", " ", "ˊ", "ˇ", "ˋ",
+      "˙",  "a",  "-",  "ㄪ", "ˉ",  "中", "\x84", "\xE3\x84"};
+  std::vector<std::string> readings;
+  for (const auto& pair : arrPhonaToHanyuPinyin) readings.push_back(pair[0]);
+  std::mt19937 generator(20221016);
+  for (int round = 0; round < 4000; round++) {
+    std::string target;
+    size_t pieces = generator() % 10;
+    for (size_t i = 0; i < pieces; i++) {
+      if (generator() % 2)
+        target += readings[generator() % readings.size()];
+      else
+        target += fragments[generator() % fragments.size()];
+    }
+    // 舊版遇到結尾不完整的 UTF-8 序列時會越界讀取，故這裡不測試該情形。
+    size_t position = 0;
+    while (position < target.size())
+      position += utf8ByteCount(static_cast<unsigned char>(target[position]));
+    if (position != target.size()) continue;
+    ASSERT_EQ(cnvPhonaToHanyuPinyin(target),
+              legacyCnvPhonaToHanyuPinyin(target));
+  }
+  ASSERT_EQ(cnvPhonaToHanyuPinyin("ㄓㄨㄤˋ\xE3"), "zhuang4\xE3");
+
+  // 寫入既有緩衝區的版本不應配置任何記憶體。
+  std::string result;
+  result.reserve(64);
+  size_t allocationsBefore = allocationCount.load();
+  cnvPhonaToHanyuPinyin("ㄓㄨㄤˋ-ㄅㄧㄢ ", result);
+  ASSERT_EQ(allocationCount.load(), allocationsBefore);
+  ASSERT_EQ(result, "zhuang4-bian1");
+}
+
+TEST(TekkonTests_Basic, HanyuPinyinTextBookStyleRenderer) {
+  std::vector<std::string> syllables;
+  for (const auto& pair : mapHanyuPinyin) syllables.push_back(pair.first);
+  std::vector<std::string> fragments = {"1", "2", "3", "4", "5", "6", "0",
+                                        "a", "n", "g", " ", "(", "Q", "起"};
+  std::mt19937 generator(20221016);
+  for (int round = 0; round < 4000; round++) {
+    std::string target;
+    size_t pieces = generator() % 10;
+    for (size_t i = 0; i < pieces; i++) {
+      if (generator() % 2)
+        target += syllables[generator() % syllables.size()] +
+                  std::to_string(generator() % 5 + 1);
+      else
+        target += fragments[generator() % fragments.size()];
+    }
+    std::string expected = target;
+    _cnvHanyuPinyinToTextBookStyleByTable(expected);
+    ASSERT_EQ(cnvHanyuPinyinToTextBookStyle(target), expected)
+        << "target: " << target;
+  }
+  ASSERT_EQ(cnvHanyuPinyinToTextBookStyle("zhuang1 lve4 er2 ai12"),
+            "zhuāng lüè ér āí");
+  // 不帶分隔的連寫音節（含省略聲調、夾雜零散字母）同樣須與逐條替換一致。
+  for (int round = 0; round < 4000; round++) {
+    std::string target;
+    for (size_t i = generator() % 8; i > 0; i--) {
+      if (generator() % 4) {
+        target += syllables[generator() % syllables.size()];
+      } else {
+        target += "aeginou"[generator() % 7];
+      }
+      if (generator() % 4) target += std::to_string(generator() % 5 + 1);
+    }
+    std::string expected = target;
+    _cnvHanyuPinyinToTextBookStyleByTable(expected);
+    ASSERT_EQ(cnvHanyuPinyinToTextBookStyle(target), expected)
+        << "target: " << target;
+  }
+  // 前一個結果以字母結尾、又與其後的字母連成較長的鍵時，須與逐條替換一致。
+  std::string interacting = "ai1n2 zhong1guo2ren2 ai1ng2";
+  std::string interactingExpected = interacting;
+  _cnvHanyuPinyinToTextBookStyleByTable(interactingExpected);
+  ASSERT_EQ(cnvHanyuPinyinToTextBookStyle(interacting), interactingExpected);
+
+  // 連寫的數字標調拼音（注音標註常見的寫法）也只需掃描一遍，不該退回逐條替換。
+  std::string joined;
+  for (int i = 0; i < 2000; i++) joined += "zhong1guo2ren2 ni3hao3 ";
+  std::string joinedExpected = joined;
+  _cnvHanyuPinyinToTextBookStyleByTable(joinedExpected);
+  auto bestOf = [](auto&& body) {
+    auto best = std::chrono::steady_clock::duration::max();
+    for (int round = 0; round < 5; round++) {
+      auto start = std::chrono::steady_clock::now();
+      body();
+      best = std::min(best, std::chrono::steady_clock::now() - start);
+    }
+    return best;
+  };
+  auto tableElapsed = bestOf([&] {
+    std::string converted = joined;
+    _cnvHanyuPinyinToTextBookStyleByTable(converted);
+  });
+  auto singlePassElapsed = bestOf([&] {
+    ASSERT_EQ(cnvHanyuPinyinToTextBookStyle(joined), joinedExpected);
+  });
+  std::cout << " -> [Tekkon] Joined textbook-style rendering: "
+            << singlePassElapsed.count() << " ns (single pass) vs "
+            << tableElapsed.count() << " ns (table loop)." << std::endl;
+  EXPECT_LT(singlePassElapsed, tableElapsed);
+
+  // 在段落分界處分批寫入的結果應與一次寫入相同。
+  std::string result;
+  cnvHanyuPinyinToTextBookStyle("起(qi3)", result);
+  cnvHanyuPinyinToTextBookStyle("居(ju1)", result);
+  ASSERT_EQ(result, "起(qǐ)居(jū)");
+}
+
 // =========== PINYIN TYPINNG HANDLING TESTS ===========
 
 TEST(TekkonTests_Intermediate, HanyuinyinKeyReceivingAndCompositions) {
@@ -543,6 +1369,221 @@ TEST(TekkonTests_Intermediate, WadeGilesPinyinKeyReceivingAndCompositions) {
   ASSERT_TRUE(toneMarkerIndicator);
 }
 
+TEST(TekkonTests_Intermediate, CorpusConverterRoundTrip) {
+  using TekkonConvert::Converter;
+  using TekkonConvert::schemeNamed;
+  Converter toHanyu(*schemeNamed("zhuyin"), *schemeNamed("hanyu"));
+  Converter fromHanyu(*schemeNamed("hanyu"), *schemeNamed("zhuyin"));
+  std::string zhuyin = "ㄓㄨㄥㄍㄨㄛˊ，ㄒㄧㄢ ㄕㄥ˙ㄋㄧˇㄏㄠˇ！\nㄅㄚ\n";
+  std::string pinyin;
+  ASSERT_EQ(toHanyu.convert(zhuyin, pinyin), 7u);
+  // 陰平與無聲調皆標作 1，音節之間不會黏連。
+  ASSERT_EQ(pinyin, "zhong1guo2，xian1 sheng5ni3hao3！\nba1\n");
+  std::string restored;
+  ASSERT_EQ(fromHanyu.convert(pinyin, restored), 7u);
+  ASSERT_EQ(restored, zhuyin);
+  std::string wadeGiles;
+  Converter(*schemeNamed("hanyu"), *schemeNamed("wadegiles"))
+      .convert("zhong1guo2", wadeGiles);
+  ASSERT_EQ(wadeGiles, "chung1kuo2");
+
+  // 漢語拼音的所有音節配上各種聲調，經由各拼音方案轉換之後都要能原樣轉回來。
+  std::string corpus;
+  std::mt19937 generator(20221016);
+  for (const StringPair& pair : pinyinReadingTable(ofHanyuPinyin)) {
+    corpus += pair.value;
+    uint8_t tone = generator() % 5 + 1;
+    corpus += tone == 1 ? std::string(" ")
+                        : char32ToString(allowedIntonations[tone - 1]);
+  }
+  for (const char* name :
+       {"hanyu", "secondary", "yale", "hualuo", "universal", "wadegiles"}) {
+    std::string converted;
+    std::string roundTrip;
+    Converter(*schemeNamed("zhuyin"), *schemeNamed(name))
+        .convert(corpus, converted);
+    Converter(*schemeNamed(name), *schemeNamed("zhuyin"))
+        .convert(converted, roundTrip);
+    ASSERT_EQ(roundTrip, corpus) << name;
+  }
+}
+
+// 舊版的 PinyinTrie::search：沿 nodes 走到 key 的節點，再遞迴收集其子樹的
+// 所有詞條。用作 CompactPinyinTrie 的對照組。
+static std::vector<std::string> legacyTrieSearch(const PinyinTrie& trie,
+                                                 const std::string& key) {
+  const PinyinTrie::TNode* currentNode = &trie.nodes.at(0);
+  for (char c : key) {
+    auto it = currentNode->children.find(std::string(1, c));
+    if (it == currentNode->children.end() || !trie.nodes.count(it->second)) {
+      return {};
+    }
+    currentNode = &trie.nodes.at(it->second);
+  }
+  std::vector<std::string> result;
+  auto collect = [&](auto& self, const PinyinTrie::TNode& node) -> void {
+    result.insert(result.end(), node.entries.begin(), node.entries.end());
+    for (const auto& pair : node.children) {
+      auto child = trie.nodes.find(pair.second);
+      if (child != trie.nodes.end()) self(self, child->second);
+    }
+  };
+  collect(collect, *currentNode);
+  return result;
+}
+
+TEST(TekkonTests_Intermediate, CompactPinyinTrieParityAndBenchmark) {
+  std::vector<MandarinParser> parsers = {
+      ofHanyuPinyin,     ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+      ofUniversalPinyin, ofWadeGilesPinyin, ofDachen};
+  std::mt19937 generator(20221016);
+  for (MandarinParser parser : parsers) {
+    size_t bytesBefore = allocatedBytes.load();
+    PinyinTrie legacy(parser);
+    size_t legacyBytes = allocatedBytes.load() - bytesBefore;
+    bytesBefore = allocatedBytes.load();
+    CompactPinyinTrie compact(parser);
+    size_t compactBytes = allocatedBytes.load() - bytesBefore;
+
+    // 所有讀音的所有前綴，搜尋結果都要與 PinyinTrie 完全一致。
+    std::vector<std::string> queries = {""};
+    for (const auto& pair : *pinyinReadingMap(ofHanyuPinyin)) {
+      for (size_t i = 1; i <= pair.first.size(); i++)
+        queries.push_back(pair.first.substr(0, i));
+    }
+    if (const auto* table = pinyinReadingMap(parser)) {
+      for (const auto& pair : *table) {
+        for (size_t i = 1; i <= pair.first.size(); i++)
+          queries.push_back(pair.first.substr(0, i));
+      }
+    }
+    for (const auto& query : queries) {
+      ASSERT_EQ(compact.search(query), legacyTrieSearch(legacy, query))
+          << query;
+      ASSERT_EQ(legacy.search(query), compact.search(query)) << query;
+    }
+
+    // 隨機的簡拼字串的 chop 與 deduct 結果也要一致。
+    std::string alphabet = "abcdefghijklmnopqrstuvwxyz'1";
+    for (int round = 0; round < 300; round++) {
+      std::string complex;
+      size_t length = generator() % 16;
+      for (size_t i = 0; i < length; i++)
+        complex += alphabet[generator() % alphabet.size()];
+      auto chopped = compact.chop(complex);
+      ASSERT_EQ(chopped, legacy.chop(complex)) << complex;
+      std::vector<std::string> expected = chopped;
+      if (parser >= 100) {
+        for (size_t i = 0; i < chopped.size(); i++) {
+          expected[i] = _mergeZhuyinCandidates(
+              chopped[i], legacyTrieSearch(legacy, chopped[i]), '&', true);
+        }
+      }
+      ASSERT_EQ(compact.deductChoppedPinyinToZhuyin(chopped), expected);
+      ASSERT_EQ(legacy.deductChoppedPinyinToZhuyin(chopped), expected);
+    }
+
+    auto timeSearches = [&](auto search) {
+      auto start = std::chrono::steady_clock::now();
+      size_t found = 0;
+      for (int round = 0; round < 5; round++) {
+        for (const auto& query : queries) found += search(query).size();
+      }
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      EXPECT_GT(found + 1, 0u);
+      return std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+          .count();
+    };
+    auto legacyMicroseconds = timeSearches([&](const std::string& query) {
+      return legacyTrieSearch(legacy, query);
+    });
+    auto compactMicroseconds = timeSearches(
+        [&](const std::string& query) { return compact.search(query); });
+    std::cout << " -> [Tekkon] Parser " << static_cast<int>(parser)
+              << ": PinyinTrie " << legacy.nodes.size() << " nodes, "
+              << legacyBytes << " bytes allocated, " << legacyMicroseconds
+              << " us; CompactPinyinTrie " << compact.nodeCount()
+              << " nodes, " << compactBytes << " bytes allocated ("
+              << compact.memoryFootprint() << " retained), "
+              << compactMicroseconds << " us." << std::endl;
+  }
+}
+
+TEST(TekkonTests_Intermediate, PinyinTrieSearchEntries) {
+  for (MandarinParser parser :
+       {ofHanyuPinyin, ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+        ofUniversalPinyin, ofWadeGilesPinyin, ofDachen}) {
+    PinyinTrie legacy(parser);
+    const CompactPinyinTrie& compact = CompactPinyinTrie::shared(parser);
+    std::vector<std::string> queries = {"", "zz", "'"};
+    for (char c = 'a'; c <= 'z'; c++) queries.emplace_back(1, c);
+    for (const auto& pair : *pinyinReadingMap(ofHanyuPinyin)) {
+      queries.push_back(pair.first.substr(0, 2));
+      queries.push_back(pair.first);
+    }
+
+    // 結果（含順序）須與 PinyinTrie::search 相同，且詞條自帶的讀音正確。
+    for (const auto& query : queries) {
+      std::vector<std::string> texts;
+      for (const auto& entry : legacy.searchEntries(query)) {
+        texts.emplace_back(legacy.text(entry));
+        ASSERT_EQ(entry.reading, PackedReading::fromString(texts.back()));
+      }
+      ASSERT_EQ(texts, legacyTrieSearch(legacy, query)) << query;
+    }
+
+    // 查詢本身不配置記憶體。
+    size_t found = 0;
+    size_t allocationsBefore = allocationCount.load();
+    for (const auto& query : queries) {
+      found += compact.searchEntries(query).size();
+    }
+    ASSERT_EQ(allocationCount.load(), allocationsBefore);
+    if (parser != ofDachen) {
+      ASSERT_GT(found, 0u);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (char c = 'a'; c <= 'z'; c++) {
+      found += legacyTrieSearch(legacy, {c}).size();
+    }
+    auto legacyElapsed = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (char c = 'a'; c <= 'z'; c++) {
+      found += compact.searchEntries({&c, 1}).size();
+    }
+    auto spanElapsed = std::chrono::steady_clock::now() - start;
+    std::cout << " -> [Tekkon] Parser " << static_cast<int>(parser)
+              << ": single-letter search " << legacyElapsed.count()
+              << " ns (PinyinTrie) vs " << spanElapsed.count()
+              << " ns (searchEntries)." << std::endl;
+  }
+}
+
+// 以 insert() 修改過的字首樹改走 nodes，插入的映射須查得到；
+// 未修改的字首樹則與共用的 CompactPinyinTrie 一致。
+TEST(TekkonTests_Intermediate, PinyinTrieInsertedEntries) {
+  PinyinTrie pristine(ofHanyuPinyin);
+  ASSERT_FALSE(pristine.isModified());
+  ASSERT_EQ(pristine.allPossibleReadings.front().size(), 6u);
+  ASSERT_EQ(pristine.search("zh"), legacyTrieSearch(pristine, "zh"));
+
+  PinyinTrie custom(ofHanyuPinyin);
+  custom.insert("zhh", "ㄓ");
+  custom.insert("qx", "ㄑ");
+  ASSERT_TRUE(custom.isModified());
+  for (const std::string query : {"", "zh", "zhh", "q", "qx", "zz"}) {
+    ASSERT_EQ(custom.search(query), legacyTrieSearch(custom, query)) << query;
+  }
+  ASSERT_EQ(custom.search("qx"), std::vector<std::string>{"ㄑ"});
+  ASSERT_TRUE(pristine.search("qx").empty());
+  ASSERT_EQ(custom.deductChoppedPinyinToZhuyin({"qx", "b"}),
+            (std::vector<std::string>{"ㄑ", "ㄅ"}));
+  ASSERT_EQ(pristine.deductChoppedPinyinToZhuyin({"qx", "b"}),
+            (std::vector<std::string>{"qx", "ㄅ"}));
+  ASSERT_EQ(custom.allPossibleReadings, pristine.allPossibleReadings);
+}
+
 // =========== PHONABET TYPINNG HANDLING TESTS (ADVANCED) ===========
 
 TEST(TekkonTests_Advanced, QwertyDachenKeys) {
@@ -136,4 +136,48 @@ TEST(TekkonTests_Arrangements, DynamicKeyLayouts) {
   }
 }
 
+// 以既有的 handleXXX 函式處理擊鍵的 Composer，用作狀態轉移表的對照組。
+struct HandlerDrivenComposer : public Composer {
+  HandlerDrivenComposer(MandarinParser parser, bool correction)
+      : Composer("", parser, correction) {}
+  void receiveKeyThroughHandlers(char key) {
+    receiveKeyFromPhonabet(translate(std::string(1, key)));
+  }
+};
+
+// Test dynamic keyboard arrangements against their transition tables
+TEST(TekkonTests_Arrangements, DynamicLayoutTransitionTables) {
+  std::vector<std::string> lines =
+      splitString(TekkonTestData::testTable4DynamicLayouts, '\n');
+  std::vector<MandarinParser> dynamicParsers = {ofDachen26, ofETen26, ofHsu,
+                                                ofStarlight, ofAlvinLiu};
+  int failureCount = 0;
+  for (size_t parserIdx = 0; parserIdx < dynamicParsers.size(); parserIdx++) {
+    MandarinParser parser = dynamicParsers[parserIdx];
+    for (bool correction : {false, true}) {
+      for (size_t lineIdx = 1; lineIdx < lines.size(); lineIdx++) {
+        std::vector<std::string> cells = splitString(lines[lineIdx], ' ');
+        if (cells.size() < 6) continue;
+        std::string typing = replaceUnderscores(cells[parserIdx + 1]);
+        if (typing.empty() || typing[0] == '`') continue;
+        // 逐鍵比對狀態轉移表與 handleXXX 函式的結果。
+        Composer composer("", parser, correction);
+        HandlerDrivenComposer reference(parser, correction);
+        for (char key : typing) {
+          composer.receiveKey(key);
+          reference.receiveKeyThroughHandlers(key);
+          if (composer.value() != reference.value()) {
+            std::cout << "MISMATCH (" << static_cast<int>(parser) << "): \""
+                      << typing << "\" -> \"" << composer.value()
+                      << "\" != \"" << reference.value() << "\"" << std::endl;
+            failureCount++;
+            break;
+          }
+        }
+      }
+    }
+  }
+  ASSERT_EQ(failureCount, 0);
+}
+
 }  // namespace Tekkon
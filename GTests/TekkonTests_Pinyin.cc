@@ -2,10 +2,22 @@
 // ====================
 // This code is released under the SPDX-License-Identifier: `LGPL-3.0-or-later`.
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include "../Sources/Tekkon/include/Tekkon.hh"
+#include "../Sources/Tekkon/include/TekkonCompiledImage.hh"
 #include "gtest/gtest.h"
 
 namespace Tekkon {
@@ -42,6 +54,182 @@ TEST(TekkonTests_Pinyin, PinyinTrieChopFunction) {
   // Should contain "zhong" or parts of it, and "guo" or parts of it
 }
 
+// The former chop(): scans every reading for each candidate prefix.
+static std::vector<std::string> legacyChopByScanning(
+    const std::vector<std::string>& readings, const std::string& complex) {
+  std::vector<std::string> result;
+  size_t position = 0;
+  while (position < complex.size()) {
+    size_t scopeSize = std::min(readings[0].size(), complex.size() - position);
+    for (; scopeSize >= 1; scopeSize--) {
+      std::string blob = complex.substr(position, scopeSize);
+      bool matched = std::any_of(
+          readings.begin(), readings.end(),
+          [&](const std::string& reading) { return reading.find(blob) == 0; });
+      if (matched) break;
+    }
+    if (scopeSize == 0) scopeSize = 1;
+    result.push_back(complex.substr(position, scopeSize));
+    position += scopeSize;
+  }
+  return result;
+}
+
+// Test chop() walking the trie, including the string_view overload
+TEST(TekkonTests_Pinyin, PinyinTrieChopThroughTrieWalk) {
+  PinyinTrie trie(ofHanyuPinyin);
+  std::vector<std::string> expected = {"sh", "j", "da", "z"};
+  ASSERT_EQ(trie.chop("shjdaz"), expected);
+
+  std::string complex = "shjdaz";
+  std::vector<std::string_view> slices;
+  trie.chop(complex, slices);
+  ASSERT_EQ(slices.size(), expected.size());
+  const char* cursor = complex.data();
+  for (size_t i = 0; i < slices.size(); i++) {
+    ASSERT_EQ(std::string(slices[i]), expected[i]);
+    ASSERT_EQ(slices[i].data(), cursor);  // Slices point into the input.
+    cursor += slices[i].size();
+  }
+  trie.chop(std::string_view(), slices);
+  ASSERT_TRUE(slices.empty());
+
+  std::mt19937 generator(20221016);
+  std::uniform_int_distribution<int> lengthDist(0, 24);
+  std::string alphabet = "abcdefghijklmnopqrstuvwxyz1234 ";
+  std::uniform_int_distribution<size_t> charDist(0, alphabet.size() - 1);
+  for (MandarinParser parser :
+       {ofHanyuPinyin, ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+        ofUniversalPinyin, ofWadeGilesPinyin, ofDachen}) {
+    PinyinTrie parserTrie(parser);
+    std::vector<std::string> readings = parserTrie.allPossibleReadings;
+    for (int round = 0; round < 500; round++) {
+      std::string input;
+      int length = lengthDist(generator);
+      for (int i = 0; i < length; i++) input += alphabet[charDist(generator)];
+      ASSERT_EQ(parserTrie.chop(input), legacyChopByScanning(readings, input))
+          << "parser: " << parser << ", input: " << input;
+    }
+  }
+}
+
+// Test the compile-time perfect hash behind receiveSequence(isRomaji: true)
+TEST(TekkonTests_Pinyin, PinyinSyllablePerfectHash) {
+  static_assert(pinyinSyllableHash(ofHanyuPinyin).find("zhuang")->reading ==
+                PackedReading::fromString("ㄓㄨㄤ"));
+  static_assert(pinyinSyllableHash(ofHanyuPinyin).find("zhuangx") == nullptr);
+  static_assert(pinyinSyllableHash(ofDachen).empty());
+  ASSERT_EQ(pinyinSyllableHash(ofDachen).find("a"), nullptr);
+
+  for (MandarinParser parser :
+       {ofHanyuPinyin, ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+        ofUniversalPinyin, ofWadeGilesPinyin}) {
+    StringPairTable table = pinyinReadingTable(parser);
+    SyllableHashView hash = pinyinSyllableHash(parser);
+    for (const StringPair& pair : table) {
+      const SyllableHashView::Slot* slot = hash.find(pair.key);
+      ASSERT_NE(slot, nullptr) << pair.key;
+      ASSERT_EQ(slot->reading, PackedReading::fromString(pair.value));
+      // Neighbouring strings that are not syllables must miss.
+      std::string key(pair.key);
+      for (std::string probe : {key + "q", key.substr(1), std::string()}) {
+        ASSERT_EQ(hash.find(probe) != nullptr, table.contains(probe)) << probe;
+      }
+    }
+
+    // Same results as feeding the phonabets in one by one.
+    for (bool correction : {false, true}) {
+      for (bool ordering : {false, true}) {
+        for (const StringPair& pair : table) {
+          Composer legacy("", parser, correction);
+          legacy.enforceCSVTOrdering = ordering;
+          legacy.clear();
+          for (const std::string& phonabet :
+               splitByCodepoint(std::string(pair.value))) {
+            legacy.receiveKeyFromPhonabet(phonabet);
+          }
+          Composer composer("", parser, correction);
+          composer.enforceCSVTOrdering = ordering;
+          ASSERT_EQ(composer.receiveSequence(std::string(pair.key), true),
+                    legacy.value())
+              << pair.key;
+          ASSERT_EQ(composer.romajiBuffer, legacy.romajiBuffer) << pair.key;
+        }
+      }
+    }
+  }
+}
+
+// The former pinyin branch of receiveKey(): re-parses the whole buffer.
+static void legacyReceivePinyinKey(Composer& composer,
+                                   const std::string& input) {
+  if (auto tone = _arayuruPinyinIntonationTable.view().find(input)) {
+    composer.intonation = Phonabet(std::string(*tone));
+    return;
+  }
+  composer._refreshRomajiBufferIfNeeded();
+  size_t maxCount = (composer.parser == ofWadeGilesPinyin) ? 7 : 6;
+  std::string buffer = composer.romajiBuffer;
+  if (buffer.length() > maxCount - 1) buffer.erase(0, 1);
+  buffer += input;
+  composer.receiveSequence(buffer, true);
+  composer.romajiBuffer = buffer;
+  composer._needsRomajiUpdate = false;
+}
+
+// Test the incremental trie cursor behind pinyin keystrokes
+TEST(TekkonTests_Pinyin, PinyinKeystrokeCursorParity) {
+  std::mt19937 generator(20221016);
+  std::string alphabet = "abcdefghijklmnopqrstuvwxyz12345";
+  std::uniform_int_distribution<size_t> charDist(0, alphabet.size() - 1);
+  std::vector<MandarinParser> parsers = {
+      ofHanyuPinyin,  ofSecondaryPinyin, ofYalePinyin,
+      ofHualuoPinyin, ofUniversalPinyin, ofWadeGilesPinyin};
+  for (MandarinParser parser : parsers) {
+    for (bool correction : {false, true}) {
+      Composer composer("", parser, correction);
+      Composer legacy("", parser, correction);
+      for (int round = 0; round < 3000; round++) {
+        int action = generator() % 20;
+        if (action < 3) {
+          composer.doBackSpace();
+          legacy.doBackSpace();
+        } else if (action == 3) {
+          // Rewrites the buffer wholesale, so the cursor has to resync.
+          std::string romaji = legacy.romajiBuffer.substr(0, 2) + "i";
+          composer.replacePinyinBuffer(romaji);
+          legacy.replacePinyinBuffer(romaji);
+        } else if (action == 4) {
+          composer.setPackedReading(PackedReading::fromString("ㄓㄨㄤ"));
+          legacy.setPackedReading(PackedReading::fromString("ㄓㄨㄤ"));
+        } else if (action == 5 && round % 7 == 0) {
+          MandarinParser next = parsers[generator() % parsers.size()];
+          composer.ensureParser(next);
+          legacy.ensureParser(next);
+        } else {
+          std::string input(1, alphabet[charDist(generator)]);
+          ASSERT_TRUE(composer.receiveKey(input));
+          legacyReceivePinyinKey(legacy, input);
+        }
+        ASSERT_EQ(composer.value(), legacy.value()) << "round: " << round;
+        ASSERT_EQ(composer.getComposition(true), legacy.getComposition(true))
+            << "round: " << round;
+        ASSERT_EQ(composer.romajiBuffer, legacy.romajiBuffer)
+            << "round: " << round;
+      }
+    }
+  }
+
+  // Walking back and forth over one syllable.
+  Composer composer("", ofHanyuPinyin);
+  for (char c : std::string("zhuang")) composer.receiveKey(std::string(1, c));
+  ASSERT_EQ(composer.value(), "ㄓㄨㄤ");
+  composer.doBackSpace();
+  composer.doBackSpace();
+  composer.receiveKey("n");
+  ASSERT_EQ(composer.value(), "ㄓㄨㄢ");
+}
+
 // Test deductChoppedPinyinToZhuyin functionality
 TEST(TekkonTests_Pinyin, DeductChoppedPinyinToZhuyin) {
   PinyinTrie trie(ofHanyuPinyin);
@@ -122,4 +310,476 @@ TEST(TekkonTests_Pinyin, PinyinAutoChopResult) {
   ASSERT_FALSE(composer.isPronounceable());
 }
 
+// Test pinyinAutoChopResult against the former composer-copying algorithm
+TEST(TekkonTests_Pinyin, PinyinAutoChopResultParity) {
+  std::mt19937 generator(20221016);
+  std::uniform_int_distribution<int> lengthDist(0, 3);
+  std::string alphabet = "abcdefghijklmnopqrstuvwxyz";
+  std::uniform_int_distribution<size_t> charDist(0, alphabet.size() - 1);
+  int choppedCount = 0;
+  for (MandarinParser parser :
+       {ofHanyuPinyin, ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+        ofUniversalPinyin, ofWadeGilesPinyin}) {
+    for (bool correction : {false, true}) {
+      std::map<std::string, std::string>& readingMap =
+          *pinyinReadingMap(parser);
+      std::vector<std::string> readings = PinyinTrie(parser).allPossibleReadings;
+      // Every reading in the table must compose into something pronounceable,
+      // so that a table lookup can stand in for a validation composer.
+      for (const auto& pair : readingMap) {
+        Composer validator("", parser, correction);
+        validator.receiveSequence(pair.first, true);
+        ASSERT_TRUE(validator.isPronounceable()) << pair.first;
+      }
+      for (int round = 0; round < 400; round++) {
+        // Half of the buffers start with a complete reading.
+        std::string buffer;
+        if (round % 2) buffer = readings[generator() % readings.size()];
+        int length = lengthDist(generator);
+        for (int i = 0; i < length; i++) buffer += alphabet[charDist(generator)];
+        std::string input(1, alphabet[charDist(generator)]);
+        Composer composer("", parser, correction);
+        composer.replacePinyinBuffer(buffer);
+        composer.romajiBuffer = buffer;
+
+        std::optional<Composer::PinyinAutoChopResult> expected;
+        std::string appended = buffer + input;
+        Composer validator("", parser, correction);
+        validator.receiveSequence(appended, true);
+        if (!validator.isPronounceable()) {
+          auto chopped = legacyChopByScanning(readings, appended);
+          if (chopped.size() >= 2) {
+            Composer::PinyinAutoChopResult legacy;
+            bool complete = true;
+            for (size_t i = 0; i + 1 < chopped.size() && complete; i++) {
+              auto it = readingMap.find(chopped[i]);
+              complete = it != readingMap.end();
+              if (complete) legacy.committedReadings.push_back(it->second);
+            }
+            legacy.remainingRomaji = chopped.back();
+            if (complete) expected = legacy;
+          }
+        }
+
+        auto actual = composer.pinyinAutoChopResult(input);
+        ASSERT_EQ(actual.has_value(), expected.has_value())
+            << "parser: " << parser << ", appended: " << appended;
+        if (!actual.has_value()) continue;
+        choppedCount++;
+        ASSERT_EQ(actual->committedReadings, expected->committedReadings);
+        ASSERT_EQ(actual->remainingRomaji, expected->remainingRomaji);
+      }
+    }
+  }
+  ASSERT_GT(choppedCount, 0);
+}
+
+// 共用的 PinyinTrie 實例在多執行緒下只會發佈一份，
+// 清除快取也不會讓既有參照失效；只以 handle 持有的舊實例則會被釋放。
+TEST(TekkonTests_Pinyin, PinyinTrieSharedRegistry) {
+  constexpr MandarinParser parsers[] = {ofHanyuPinyin, ofYalePinyin,
+                                        ofWadeGilesPinyin, ofDachen};
+  constexpr size_t threadCount = 8;
+  std::vector<std::vector<PinyinTrie*>> seen(threadCount);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < threadCount; t++) {
+    threads.emplace_back([&, t] {
+      for (MandarinParser parser : parsers) {
+        seen[t].push_back(&PinyinTrie::shared(parser));
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  for (size_t t = 1; t < threadCount; t++) ASSERT_EQ(seen[t], seen[0]);
+  ASSERT_EQ(seen[0][0]->parser, ofHanyuPinyin);
+  ASSERT_EQ(seen[0][2]->parser, ofWadeGilesPinyin);
+
+  // 清除之後取得的是新實例，舊的參照仍可照常使用。
+  PinyinTrie& before = PinyinTrie::shared(ofHanyuPinyin);
+  std::vector<std::string> expected = before.search("zhu");
+  ASSERT_FALSE(expected.empty());
+  threads.clear();
+  for (size_t t = 0; t < threadCount; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 50; i++) {
+        if (t == 0 && i % 10 == 0) PinyinTrie::clearSharedCache();
+        PinyinTrie& trie = PinyinTrie::shared(ofHanyuPinyin);
+        EXPECT_EQ(trie.parser, ofHanyuPinyin);
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  ASSERT_EQ(before.search("zhu"), expected);
+  PinyinTrie::clearSharedCache();
+  PinyinTrie& after = PinyinTrie::shared(ofHanyuPinyin);
+  ASSERT_NE(&after, &before);
+  ASSERT_EQ(&after, &PinyinTrie::shared(ofHanyuPinyin));
+  ASSERT_EQ(after.search("zhu"), expected);
+
+  // 只經由 handle 取得的實例，在清除快取且 handle 全數放掉之後即被釋放。
+  PinyinTrie::clearSharedCache();
+  std::shared_ptr<PinyinTrie> handle = PinyinTrie::sharedHandle(ofYalePinyin);
+  std::weak_ptr<PinyinTrie> watcher = handle;
+  ASSERT_EQ(PinyinTrie::sharedHandle(ofYalePinyin), handle);
+  PinyinTrie::clearSharedCache();
+  ASSERT_NE(PinyinTrie::sharedHandle(ofYalePinyin), handle);
+  ASSERT_FALSE(handle->search("yang").empty());
+  ASSERT_FALSE(watcher.expired());
+  handle.reset();
+  ASSERT_TRUE(watcher.expired());
+  // 經由 shared() 交出過參照的實例則會被釘住。
+  std::weak_ptr<PinyinTrie> pinned = PinyinTrie::sharedHandle(ofYalePinyin);
+  ASSERT_EQ(&PinyinTrie::shared(ofYalePinyin), pinned.lock().get());
+  PinyinTrie::clearSharedCache();
+  ASSERT_FALSE(pinned.expired());
+
+  // 不在列舉範圍內的排列也能取得（走上鎖的慢速路徑）。
+  auto unlisted = static_cast<MandarinParser>(42);
+  ASSERT_EQ(&PinyinTrie::shared(unlisted), &PinyinTrie::shared(unlisted));
+  ASSERT_EQ(&CompactPinyinTrie::shared(ofHanyuPinyin),
+            &CompactPinyinTrie::shared(ofHanyuPinyin));
+}
+
+// 編譯檔經由 mmap 載入之後，查詢結果須與現場建構的字首樹完全一致；
+// 損毀或版本不符的檔案則一律拒絕。
+TEST(TekkonTests_Pinyin, CompiledPinyinTrieMapping) {
+  std::string path = testing::TempDir() + "tekkon_compiled_trie.bin";
+  std::mt19937 generator(20240521);
+  for (MandarinParser parser :
+       {ofHanyuPinyin, ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+        ofUniversalPinyin, ofWadeGilesPinyin, ofDachen}) {
+    const CompactPinyinTrie& built = CompactPinyinTrie::shared(parser);
+    ASSERT_TRUE(PinyinTrie::shared(parser).saveCompiled(path));
+    std::unique_ptr<CompactPinyinTrie> mapped = PinyinTrie::mapCompiled(path);
+    ASSERT_NE(mapped, nullptr);
+    ASSERT_TRUE(mapped->isMapped());
+    ASSERT_FALSE(built.isMapped());
+    ASSERT_EQ(mapped->parser, parser);
+    ASSERT_EQ(mapped->compiledImage(), built.compiledImage());
+    ASSERT_EQ(mapped->memoryFootprint(), 0u);
+
+    StringPairTable table = pinyinReadingTable(parser);
+    if (table.empty()) table = pinyinReadingTable(ofHanyuPinyin);
+    for (const StringPair& pair : table) {
+      for (size_t i = 0; i <= pair.key.size(); i++) {
+        std::string query(pair.key.substr(0, i));
+        ASSERT_EQ(mapped->search(query), built.search(query)) << query;
+      }
+      if (parser == ofDachen) continue;
+      PackedReading reading = PackedReading::fromString(pair.value);
+      ASSERT_EQ(mapped->spellingOf(reading), pair.key);
+      ASSERT_EQ(mapped->spellingOf(reading.with(U'ˇ')), pair.key);
+    }
+    std::string alphabet = "abcdefghijklmnopqrstuvwxyz'";
+    for (int round = 0; round < 200; round++) {
+      std::string complex;
+      for (size_t i = generator() % 16; i > 0; i--)
+        complex += alphabet[generator() % alphabet.size()];
+      ASSERT_EQ(mapped->chop(complex), built.chop(complex)) << complex;
+    }
+  }
+  ASSERT_TRUE(CompactPinyinTrie::shared(ofDachen).spellingOf(
+      PackedReading::fromString("ㄅㄚ")).empty());
+
+  // 損毀的檔案：截斷、版本號不符、節點指向自己。
+  std::string image(CompactPinyinTrie::shared(ofHanyuPinyin).compiledImage());
+  auto mapBytes = [&](const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    return CompactPinyinTrie::mapCompiled(path);
+  };
+  ASSERT_NE(mapBytes(image), nullptr);
+  ASSERT_EQ(mapBytes(image.substr(0, image.size() - 4)), nullptr);
+  ASSERT_EQ(mapBytes(""), nullptr);
+  std::string corrupted = image;
+  corrupted[offsetof(CompactPinyinTrie::CompiledHeader, version)]++;
+  ASSERT_EQ(mapBytes(corrupted), nullptr);
+  corrupted = image;
+  CompactPinyinTrie::CompiledHeader header;
+  std::memcpy(&header, image.data(), sizeof(header));
+  CompactPinyinTrie::Node node;
+  size_t nodeOffset = header.nodeOffset + sizeof(node);
+  std::memcpy(&node, image.data() + nodeOffset, sizeof(node));
+  node.firstChild = 1;
+  node.childCount = 1;
+  std::memcpy(&corrupted[nodeOffset], &node, sizeof(node));
+  ASSERT_EQ(mapBytes(corrupted), nullptr);
+  ASSERT_EQ(CompactPinyinTrie::mapCompiled(path + ".missing"), nullptr);
+
+  // 多個執行緒同時寫入同一路徑：各自使用不同的暫存檔，結果必定完整。
+  std::vector<std::thread> writers;
+  for (MandarinParser parser : {ofHanyuPinyin, ofHanyuPinyin, ofYalePinyin,
+                                ofYalePinyin}) {
+    writers.emplace_back([&path, parser] {
+      for (int i = 0; i < 20; i++) {
+        EXPECT_TRUE(CompactPinyinTrie::shared(parser).saveCompiled(path));
+      }
+    });
+  }
+  for (std::thread& writer : writers) writer.join();
+  std::unique_ptr<CompactPinyinTrie> survivor =
+      CompactPinyinTrie::mapCompiled(path);
+  ASSERT_NE(survivor, nullptr);
+  ASSERT_EQ(survivor->compiledImage(),
+            CompactPinyinTrie::shared(survivor->parser).compiledImage());
+  std::remove(path.c_str());
+
+  // 共用實例已存在時，installShared 不會取代它。
+  CompactPinyinTrie::shared(ofHanyuPinyin);
+  ASSERT_FALSE(
+      CompactPinyinTrie::installShared(std::make_unique<CompactPinyinTrie>(
+          ofHanyuPinyin)));
+  ASSERT_FALSE(CompactPinyinTrie::installShared(nullptr));
+}
+
+// 結構化的 deductChoppedPinyinToZhuyin 須與字串版本給出相同的候選。
+TEST(TekkonTests_Pinyin, DeductChoppedPinyinToZhuyinStructured) {
+  std::mt19937 generator(20240602);
+  std::string alphabet = "abcdefghijklmnopqrstuvwxyz'";
+  std::vector<std::string_view> chopped;
+  std::vector<CompactPinyinTrie::SliceCandidates> structured;
+  size_t reducedCount = 0;
+  for (MandarinParser parser :
+       {ofHanyuPinyin, ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+        ofUniversalPinyin, ofWadeGilesPinyin, ofDachen}) {
+    PinyinTrie trie(parser);
+    for (int round = 0; round < 300; round++) {
+      std::string complex;
+      for (size_t i = generator() % 12 + 1; i > 0; i--)
+        complex += alphabet[generator() % alphabet.size()];
+      trie.chop(complex, chopped);
+      trie.deductChoppedPinyinToZhuyin(chopped, structured);
+      std::vector<std::string> choppedStrings(chopped.begin(), chopped.end());
+      auto deducted = trie.deductChoppedPinyinToZhuyin(choppedStrings);
+      ASSERT_EQ(structured.size(), chopped.size());
+      for (size_t i = 0; i < chopped.size(); i++) {
+        const auto& candidates = structured[i];
+        ASSERT_EQ(candidates.slice, chopped[i]);
+        std::vector<std::string> texts;
+        std::set<std::string> unique;
+        uint32_t mask = 0;
+        for (const auto& entry : candidates.readings) {
+          texts.emplace_back(trie.text(entry));
+          unique.insert(texts.back());
+          mask |= CompactPinyinTrie::consonantBit(entry.reading);
+        }
+        ASSERT_EQ(texts, trie.search(choppedStrings[i]));
+        ASSERT_EQ(candidates.consonantMask, mask);
+        if (!candidates.matched() || parser == ofDachen) {
+          ASSERT_EQ(deducted[i], choppedStrings[i]);
+          continue;
+        }
+        // 字串版本只留下各個聲母時，須與聲母摘要一致。
+        bool consonantsOnly = unique.size() > 3 && !deducted[i].empty();
+        for (const auto& part : splitByCodepoint(deducted[i])) {
+          if (part == "&") continue;
+          PackedReading reading = PackedReading::fromString(part);
+          consonantsOnly &= reading.consonantIndex() &&
+                            reading.without(PhoneType::consonant).isEmpty();
+        }
+        if (!consonantsOnly) continue;
+        ASSERT_FALSE(mask & CompactPinyinTrie::withoutConsonantBit);
+        std::vector<std::string> consonants;
+        for (size_t bit = 0; bit < allowedConsonants.size(); bit++) {
+          if (mask & (uint32_t{1} << bit))
+            consonants.push_back(char32ToString(allowedConsonants[bit]));
+        }
+        std::sort(consonants.begin(), consonants.end());
+        std::string joined;
+        for (const auto& consonant : consonants) {
+          if (!joined.empty()) joined += '&';
+          joined += consonant;
+        }
+        ASSERT_EQ(deducted[i], joined) << choppedStrings[i];
+        reducedCount++;
+      }
+    }
+  }
+  ASSERT_GT(reducedCount, 0u);
+
+  // 沿用結果陣列的容量，不重新配置。
+  const CompactPinyinTrie& compact = CompactPinyinTrie::shared(ofHanyuPinyin);
+  std::string complex = "shjdazxianfangan1";
+  compact.chop(complex, chopped);
+  compact.deductChoppedPinyinToZhuyin(chopped, structured);
+  const auto* storage = structured.data();
+  compact.deductChoppedPinyinToZhuyin(chopped, structured);
+  ASSERT_EQ(structured.data(), storage);
+  ASSERT_TRUE(structured[0].consonantMask &
+              CompactPinyinTrie::consonantBit(PackedReading().with(U'ㄕ')));
+  ASSERT_FALSE(structured[0].consonantMask &
+               CompactPinyinTrie::consonantBit(PackedReading().with(U'ㄙ')));
+  ASSERT_FALSE(structured.back().matched());
+}
+
+// ChopSession 逐字元追加、退格的切割結果須與整串重切的結果相同。
+TEST(TekkonTests_Pinyin, ChopSessionIncremental) {
+  std::mt19937 generator(20240611);
+  std::string alphabet = "abcdefghijklmnopqrstuvwxyz'1";
+  std::vector<std::string_view> expected;
+  std::vector<std::string_view> actual;
+  for (MandarinParser parser :
+       {ofHanyuPinyin, ofSecondaryPinyin, ofYalePinyin, ofHualuoPinyin,
+        ofUniversalPinyin, ofWadeGilesPinyin, ofDachen}) {
+    const CompactPinyinTrie& trie = CompactPinyinTrie::shared(parser);
+    ChopSession session(parser);
+    for (int step = 0; step < 3000; step++) {
+      if (generator() % 4 == 0) {
+        bool wasEmpty = session.empty();
+        ASSERT_EQ(session.backspace(), !wasEmpty);
+      } else {
+        session.append(alphabet[generator() % alphabet.size()]);
+      }
+      if (generator() % 50 == 0) session.clear();
+      trie.chop(session.buffer(), expected);
+      session.segments(actual);
+      ASSERT_EQ(actual, expected) << session.buffer();
+      ASSERT_EQ(session.lastSegment(),
+                expected.empty() ? std::string_view() : expected.back());
+    }
+  }
+  ChopSession session(ofHanyuPinyin);
+  ASSERT_FALSE(session.backspace());
+  session.assign("shjdaz");
+  session.segments(actual);
+  ASSERT_EQ(actual, (std::vector<std::string_view>{"sh", "j", "da", "z"}));
+  session.append("han");
+  ASSERT_EQ(session.lastSegment(), "zhan");
+  ASSERT_EQ(session.trie().node(session.frontier()).reading,
+            PackedReading::fromString("ㄓㄢ"));
+  session.backspace();
+  ASSERT_EQ(session.lastSegment(), "zha");
+
+  // 每拍的耗時與緩衝區長度無關：在短緩衝區與很長的緩衝區後面
+  // 各做同樣次數的追加與退格，兩者的耗時應在同一個量級。
+  auto timeAppends = [&](size_t prefixLength) {
+    session.clear();
+    for (size_t i = 0; i < prefixLength; i++) session.append("shjdaz"[i % 6]);
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 100; round++) {
+      for (int i = 0; i < 64; i++) session.append("zhuang"[i % 6]);
+      for (int i = 0; i < 64; i++) session.backspace();
+    }
+    return std::chrono::steady_clock::now() - start;
+  };
+  auto shortElapsed = timeAppends(8);
+  auto longElapsed = timeAppends(100000);
+  std::cout << " -> [Tekkon] ChopSession: 12800 edits after 8 chars took "
+            << shortElapsed.count() << " ns, after 100000 chars took "
+            << longElapsed.count() << " ns." << std::endl;
+}
+
+// 切割網格須收錄所有可走的片段，k-best 須與窮舉所有路徑的結果一致。
+TEST(TekkonTests_Pinyin, ChopLatticeKBest) {
+  PinyinTrie trie(ofHanyuPinyin);
+  std::vector<std::string_view> segments;
+
+  ChopLattice xian = trie.buildLattice("xian");
+  auto paths = xian.bestPaths(2);
+  ASSERT_EQ(paths.size(), 2u);
+  xian.segments(paths[0], segments);
+  ASSERT_EQ(segments, (std::vector<std::string_view>{"xian"}));
+  xian.segments(paths[1], segments);
+  ASSERT_EQ(segments, (std::vector<std::string_view>{"xi", "an"}));
+  ASSERT_EQ(xian.edges()[paths[1].edges[0]].reading,
+            PackedReading::fromString("ㄒㄧ"));
+
+  std::set<std::vector<std::string_view>> fangan;
+  ChopLattice fanganLattice = trie.buildLattice("fangan");
+  for (const auto& path : fanganLattice.bestPaths(2)) {
+    fanganLattice.segments(path, segments);
+    fangan.insert(segments);
+  }
+  ASSERT_EQ(fangan, (std::set<std::vector<std::string_view>>{
+                        {"fan", "gan"}, {"fang", "an"}}));
+
+  // 自訂權重：只接受完整讀音（與無法辨識的字元）。
+  auto syllablesOnly = [](const ChopLattice::Edge& edge) {
+    return edge.isSyllable() || edge.isUnknown()
+               ? 1.0
+               : std::numeric_limits<double>::infinity();
+  };
+  auto syllablePaths = xian.bestPaths(10, syllablesOnly);
+  ASSERT_GE(syllablePaths.size(), 2u);
+  for (const auto& path : syllablePaths) {
+    for (uint32_t e : path.edges) ASSERT_TRUE(xian.edges()[e].isSyllable());
+  }
+  // 「shjdaz」的開頭沒有完整讀音，排除前綴之後就無路可走。
+  ASSERT_TRUE(trie.buildLattice("shjdaz").bestPaths(3, syllablesOnly).empty());
+
+  std::mt19937 generator(20240620);
+  std::string alphabet = "abcdefghijklmnopqrstuvwxyz";
+  for (MandarinParser parser : {ofHanyuPinyin, ofWadeGilesPinyin, ofDachen}) {
+    const CompactPinyinTrie& compact = CompactPinyinTrie::shared(parser);
+    PinyinTrie reference(parser == ofDachen ? ofHanyuPinyin : parser);
+    for (int round = 0; round < 200; round++) {
+      std::string input;
+      for (size_t i = generator() % 9; i > 0; i--)
+        input += alphabet[generator() % alphabet.size()];
+      ChopLattice lattice(compact, input);
+
+      // 邊：所有在字首樹上查得到的片段（非拼音排列的字首樹與漢語拼音的相同），
+      // 外加走不動的位置上的單字元邊。
+      std::vector<std::pair<uint32_t, uint32_t>> expectedEdges;
+      for (size_t begin = 0; begin < input.size(); begin++) {
+        size_t before = expectedEdges.size();
+        for (size_t end = begin + 1; end <= input.size(); end++) {
+          if (reference.search(input.substr(begin, end - begin)).empty())
+            break;
+          expectedEdges.emplace_back(begin, end);
+        }
+        if (expectedEdges.size() == before) {
+          expectedEdges.emplace_back(begin, begin + 1);
+        }
+      }
+      std::vector<std::pair<uint32_t, uint32_t>> actualEdges;
+      for (const auto& edge : lattice.edges()) {
+        actualEdges.emplace_back(edge.begin, edge.end);
+        ASSERT_EQ(edge.reading, edge.node ? compact.node(edge.node).reading
+                                          : PackedReading());
+      }
+      ASSERT_EQ(actualEdges, expectedEdges) << input;
+
+      // 窮舉所有路徑的成本，與 k-best 的結果比對。
+      std::vector<double> allCosts;
+      auto enumerate = [&](auto& self, size_t position, double cost) -> void {
+        if (position == input.size()) {
+          allCosts.push_back(cost);
+          return;
+        }
+        for (const auto& edge : lattice.edgesFrom(position)) {
+          self(self, edge.end, cost + ChopLattice::defaultWeight(edge));
+        }
+      };
+      enumerate(enumerate, 0, 0);
+      std::sort(allCosts.begin(), allCosts.end());
+      size_t k = generator() % 6 + 1;
+      paths = lattice.bestPaths(k);
+      ASSERT_EQ(paths.size(), std::min(k, allCosts.size())) << input;
+      for (size_t i = 0; i < paths.size(); i++) {
+        ASSERT_DOUBLE_EQ(paths[i].cost, allCosts[i]) << input;
+        double cost = 0;
+        size_t position = 0;
+        for (uint32_t e : paths[i].edges) {
+          ASSERT_EQ(lattice.edges()[e].begin, position);
+          position = lattice.edges()[e].end;
+          cost += ChopLattice::defaultWeight(lattice.edges()[e]);
+        }
+        ASSERT_EQ(position, input.size());
+        ASSERT_DOUBLE_EQ(cost, paths[i].cost);
+      }
+      // chop() 的結果必定是網格上的一條路徑。
+      std::vector<std::string_view> chopped;
+      compact.chop(input, chopped);
+      size_t position = 0;
+      for (std::string_view slice : chopped) {
+        bool found = false;
+        for (const auto& edge : lattice.edgesFrom(position))
+          found |= edge.end == position + slice.size();
+        ASSERT_TRUE(found) << input;
+        position += slice.size();
+      }
+    }
+  }
+}
+
 }  // namespace Tekkon
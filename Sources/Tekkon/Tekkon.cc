@@ -3,6 +3,7 @@
 // This code is released under the SPDX-License-Identifier: `LGPL-3.0-or-later`.
 
 #include "./include/Tekkon.hh"
+#include "./include/TekkonCompiledImage.hh"
 
 namespace Tekkon {};
 
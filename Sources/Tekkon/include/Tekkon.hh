@@ -27,12 +27,19 @@
 #define TEKKON_HH_
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <regex>
 #include <set>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -78,13 +85,23 @@ inline static void replaceOccurrences(std::string& data, std::string toSearch,
 }
 
 template <typename Type>
-static bool contains(std::vector<Type> theVector, const Type& theElement) {
+static bool contains(const std::vector<Type>& theVector,
+                     const Type& theElement) {
   if (std::find(theVector.begin(), theVector.end(), theElement) !=
       theVector.end())
     return true;
   return false;
 }
 
+template <typename Type, size_t N>
+constexpr bool contains(const std::array<Type, N>& theArray,
+                        const Type& theElement) {
+  for (const Type& element : theArray) {
+    if (element == theElement) return true;
+  }
+  return false;
+}
+
 constexpr unsigned int hashify(const char* str, int h = 0) {
   return !str[h] ? 5381 : (hashify(str, h + 1) * 33) ^ str[h];
 }
@@ -105,9 +122,22 @@ std::vector<T>& operator+=(std::vector<T>& x, std::vector<T>& y) {
   return x;
 }
 
+/// 於編譯期將多個 std::array 首尾相接。
+template <typename T, size_t... Sizes>
+constexpr std::array<T, (Sizes + ...)> joinArrays(
+    const std::array<T, Sizes>&... arrays) {
+  std::array<T, (Sizes + ...)> result{};
+  size_t index = 0;
+  auto append = [&](const auto& array) {
+    for (const T& element : array) result[index++] = element;
+  };
+  (append(arrays), ...);
+  return result;
+}
+
 // 以下函式取自 boost 內部實作。
 // 授權條款：https://www.boost.org/users/license.html
-inline static unsigned utf8ByteCount(unsigned theChar) {
+constexpr unsigned utf8ByteCount(unsigned theChar) {
   // 若最高有效位元為零的位置在第 8-N 位，則此 UTF-8 序列有 N 個位元組：
   unsigned mask = 0x80u;
   unsigned result = 0;
@@ -139,6 +169,218 @@ inline static bool stringInclusion(std::string able, std::string baker) {
                          : (able.find(baker, 0) != std::string::npos);
 }
 
+/// 不持有資料的唯讀陣列視圖（C++17 沒有 std::span）。
+template <typename T>
+class ArrayView {
+ public:
+  constexpr ArrayView() = default;
+  constexpr ArrayView(const T* begin, const T* end)
+      : _begin(begin), _end(end) {}
+
+  constexpr const T* begin() const { return _begin; }
+  constexpr const T* end() const { return _end; }
+  constexpr size_t size() const { return static_cast<size_t>(_end - _begin); }
+  constexpr bool empty() const { return _begin == _end; }
+  constexpr const T& operator[](size_t i) const { return _begin[i]; }
+
+ private:
+  const T* _begin = nullptr;
+  const T* _end = nullptr;
+};
+
+// MARK: - Compile-time String Tables
+
+/// 以 C++20 編譯時，要求下述對照表在編譯期完成初期化。
+#if __cplusplus >= 202002L
+#define TEKKON_CONSTINIT constinit
+#else
+#define TEKKON_CONSTINIT
+#endif
+
+/// 編譯期對照表的條目，鍵與值皆指向靜態儲存區內的字串常量。
+struct StringPair {
+  std::string_view key;
+  std::string_view value;
+};
+
+/// 編譯期對照表的唯讀視圖。
+///
+/// 條目按原始順序存放；另附一份「按鍵的位元組順序排好的條目序號」，
+/// 以便二分查詢。該順序與 std::map<std::string, ...> 的迭代順序一致。
+class StringPairTable {
+ public:
+  constexpr StringPairTable() = default;
+  constexpr StringPairTable(const StringPair* pairs, const uint16_t* order,
+                            size_t count)
+      : _pairs(pairs), _order(order), _count(count) {}
+
+  constexpr const StringPair* begin() const { return _pairs; }
+  constexpr const StringPair* end() const { return _pairs + _count; }
+  constexpr size_t size() const { return _count; }
+  constexpr bool empty() const { return _count == 0; }
+
+  /// 按鍵的位元組順序取得第 i 個條目。
+  constexpr const StringPair& sortedAt(size_t i) const {
+    return _pairs[_order[i]];
+  }
+
+  /// 查詢給定的鍵所對應的值；查無結果時回傳空值。
+  constexpr std::optional<std::string_view> find(std::string_view key) const {
+    size_t low = 0;
+    size_t high = _count;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (sortedAt(middle).key < key) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    if (low < _count && sortedAt(low).key == key) return sortedAt(low).value;
+    return std::nullopt;
+  }
+
+  /// 檢查給定的鍵是否存在於表內。
+  constexpr bool contains(std::string_view key) const {
+    return find(key).has_value();
+  }
+
+  /// 生成舊版 API 所使用的 std::map 辭典。
+  std::map<std::string, std::string> toMap() const {
+    std::map<std::string, std::string> result;
+    for (const StringPair& pair : *this) {
+      result.emplace(std::string(pair.key), std::string(pair.value));
+    }
+    return result;
+  }
+
+  /// 生成舊版 API 所使用的「二元字串陣列」之陣列，保留原始順序。
+  std::vector<std::vector<std::string>> toRows() const {
+    std::vector<std::vector<std::string>> result;
+    result.reserve(_count);
+    for (const StringPair& pair : *this) {
+      result.push_back({std::string(pair.key), std::string(pair.value)});
+    }
+    return result;
+  }
+
+ private:
+  const StringPair* _pairs = nullptr;
+  const uint16_t* _order = nullptr;
+  size_t _count = 0;
+};
+
+/// 在編譯期替給定的條目陣列排好查詢順序的對照表。
+/// 鍵不可重複（與 std::map 的初期化列表不同，重複的鍵不會被默默略過）。
+template <size_t N>
+class StringTable {
+ public:
+  constexpr explicit StringTable(const StringPair (&pairs)[N])
+      : _pairs(pairs), _order() {
+    // 條目僅數百筆，且只在編譯期排一次，故直接用插入排序。
+    for (size_t i = 0; i < N; i++) {
+      size_t j = i;
+      while (j > 0 && pairs[i].key < pairs[_order[j - 1]].key) {
+        _order[j] = _order[j - 1];
+        j--;
+      }
+      _order[j] = static_cast<uint16_t>(i);
+    }
+  }
+
+  constexpr StringPairTable view() const {
+    return StringPairTable(_pairs, _order.data(), N);
+  }
+
+  /// 檢查是否沒有重複的鍵。
+  constexpr bool hasUniqueKeys() const {
+    for (size_t i = 1; i < N; i++) {
+      if (_pairs[_order[i - 1]].key == _pairs[_order[i]].key) return false;
+    }
+    return true;
+  }
+
+ private:
+  const StringPair* _pairs;
+  std::array<uint16_t, N> _order;
+};
+
+/// 按需生成的舊版資料結構（std::map 或 std::vector）。
+///
+/// 本身可以在編譯期完成初期化，程式啟動時不做任何堆積配置；
+/// 僅在首次被舊版 API 存取時才生成內容，之後一直沿用同一份（不會釋放）。
+/// 多個執行緒同時首次存取的話，只有一份生成結果會被採用。
+template <typename T>
+class LazyTable {
+ public:
+  constexpr explicit LazyTable(T (*builder)()) : _builder(builder) {}
+  LazyTable(const LazyTable&) = delete;
+  LazyTable& operator=(const LazyTable&) = delete;
+
+  /// 取得生成好的資料結構。
+  T& get() const {
+    T* instance = _instance.load(std::memory_order_acquire);
+    if (instance) return *instance;
+    T* built = new T(_builder());
+    if (_instance.compare_exchange_strong(instance, built,
+                                          std::memory_order_acq_rel)) {
+      return *built;
+    }
+    delete built;
+    return *instance;
+  }
+
+  /// 該資料結構是否已經生成過。
+  bool isBuilt() const {
+    return _instance.load(std::memory_order_acquire) != nullptr;
+  }
+
+  operator T&() const { return get(); }
+  T* operator->() const { return &get(); }
+  template <typename Key>
+  decltype(auto) operator[](Key&& key) const {
+    return get()[std::forward<Key>(key)];
+  }
+  template <typename Key>
+  decltype(auto) count(const Key& key) const {
+    return get().count(key);
+  }
+  template <typename Key>
+  decltype(auto) find(const Key& key) const {
+    return get().find(key);
+  }
+  template <typename Key>
+  decltype(auto) at(const Key& key) const {
+    return get().at(key);
+  }
+  template <typename Key>
+  decltype(auto) lower_bound(const Key& key) const {
+    return get().lower_bound(key);
+  }
+  template <typename Key>
+  decltype(auto) upper_bound(const Key& key) const {
+    return get().upper_bound(key);
+  }
+  template <typename Key>
+  decltype(auto) equal_range(const Key& key) const {
+    return get().equal_range(key);
+  }
+  decltype(auto) begin() const { return get().begin(); }
+  decltype(auto) end() const { return get().end(); }
+  decltype(auto) cbegin() const { return get().cbegin(); }
+  decltype(auto) cend() const { return get().cend(); }
+  decltype(auto) rbegin() const { return get().rbegin(); }
+  decltype(auto) rend() const { return get().rend(); }
+  decltype(auto) front() const { return get().front(); }
+  decltype(auto) back() const { return get().back(); }
+  size_t size() const { return get().size(); }
+  bool empty() const { return get().empty(); }
+
+ private:
+  T (*_builder)();
+  mutable std::atomic<T*> _instance{nullptr};
+};
+
 // MARK: - Static Constants and Basic Enums
 
 /// 定義注音符號的種類
@@ -172,28 +414,29 @@ enum MandarinParser : int {
 };
 
 /// 引擎僅接受這些記號作為聲母
-inline static std::vector<char32_t> allowedConsonants = {
+inline static constexpr std::array<char32_t, 21> allowedConsonants = {
     U'ㄅ', U'ㄆ', U'ㄇ', U'ㄈ', U'ㄉ', U'ㄊ', U'ㄋ', U'ㄌ', U'ㄍ', U'ㄎ', U'ㄏ',
     U'ㄐ', U'ㄑ', U'ㄒ', U'ㄓ', U'ㄔ', U'ㄕ', U'ㄖ', U'ㄗ', U'ㄘ', U'ㄙ'};
 
 /// 引擎僅接受這些記號作為介母
-inline static std::vector<char32_t> allowedSemivowels = {U'ㄧ', U'ㄨ', U'ㄩ'};
+inline static constexpr std::array<char32_t, 3> allowedSemivowels = {
+    U'ㄧ', U'ㄨ', U'ㄩ'};
 
 /// 引擎僅接受這些記號作為韻母
-inline static std::vector<char32_t> allowedVowels = {
+inline static constexpr std::array<char32_t, 13> allowedVowels = {
     U'ㄚ', U'ㄛ', U'ㄜ', U'ㄝ', U'ㄞ', U'ㄟ', U'ㄠ',
     U'ㄡ', U'ㄢ', U'ㄣ', U'ㄤ', U'ㄥ', U'ㄦ'};
 
 /// 引擎僅接受這些記號作為聲調
-inline static std::vector<char32_t> allowedIntonations = {U' ', U'ˊ', U'ˇ',
-                                                          U'ˋ', U'˙'};
+inline static constexpr std::array<char32_t, 5> allowedIntonations = {
+    U' ', U'ˊ', U'ˇ', U'ˋ', U'˙'};
 
 /// 引擎僅接受這些記號作為注音（聲介韻調四個集合加起來）
-inline static std::vector<char32_t> allowedPhonabets =
-    allowedConsonants + allowedSemivowels + allowedVowels + allowedIntonations;
+inline static constexpr auto allowedPhonabets = joinArrays(
+    allowedConsonants, allowedSemivowels, allowedVowels, allowedIntonations);
 
 /// 原始轉換對照表資料貯存專用佇列（數字標調格式）
-inline static std::vector<std::vector<std::string>> arrPhonaToHanyuPinyin =
+inline static constexpr StringPair _phonaToHanyuPinyinPairs[] =
     {  // 排序很重要。先處理最長的，再處理短的。不然會出亂子。
         {" ", "1"},           {"ˊ", "2"},           {"ˇ", "3"},
         {"ˋ", "4"},           {"˙", "5"},
@@ -348,89 +591,110 @@ inline static std::vector<std::vector<std::string>> arrPhonaToHanyuPinyin =
         {"ㄣ", "en"},         {"ㄤ", "ang"},        {"ㄥ", "eng"},
         {"ㄦ", "er"},         {"ㄧ", "yi"},         {"ㄨ", "wu"},
         {"ㄩ", "yu"}};
+inline static constexpr StringTable _phonaToHanyuPinyinTable{
+    _phonaToHanyuPinyinPairs};
+static_assert(_phonaToHanyuPinyinTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::vector 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::vector<std::vector<std::string>>>
+    arrPhonaToHanyuPinyin{
+        [] { return _phonaToHanyuPinyinTable.view().toRows(); }};
 
 /// 漢語拼音韻母轉換對照表資料貯存專用佇列
-inline static std::vector<std::vector<std::string>>
-    arrHanyuPinyinTextbookStyleConversionTable =
-        {  // 排序很重要。先處理最長的，再處理短的。不然會出亂子。
-            {"iang1", "iāng"}, {"iang2", "iáng"}, {"iang3", "iǎng"},
-            {"iang4", "iàng"}, {"iong1", "iōng"}, {"iong2", "ióng"},
-            {"iong3", "iǒng"}, {"iong4", "iòng"}, {"uang1", "uāng"},
-            {"uang2", "uáng"}, {"uang3", "uǎng"}, {"uang4", "uàng"},
-            {"uang5", "uang"},
-
-            {"ang1", "āng"},   {"ang2", "áng"},   {"ang3", "ǎng"},
-            {"ang4", "àng"},   {"ang5", "ang"},   {"eng1", "ēng"},
-            {"eng2", "éng"},   {"eng3", "ěng"},   {"eng4", "èng"},
-            {"ian1", "iān"},   {"ian2", "ián"},   {"ian3", "iǎn"},
-            {"ian4", "iàn"},   {"iao1", "iāo"},   {"iao2", "iáo"},
-            {"iao3", "iǎo"},   {"iao4", "iào"},   {"ing1", "īng"},
-            {"ing2", "íng"},   {"ing3", "ǐng"},   {"ing4", "ìng"},
-            {"ong1", "ōng"},   {"ong2", "óng"},   {"ong3", "ǒng"},
-            {"ong4", "òng"},   {"uai1", "uāi"},   {"uai2", "uái"},
-            {"uai3", "uǎi"},   {"uai4", "uài"},   {"uan1", "uān"},
-            {"uan2", "uán"},   {"uan3", "uǎn"},   {"uan4", "uàn"},
-            {"van2", "üán"},   {"van3", "üǎn"},
-
-            {"ai1", "āi"},     {"ai2", "ái"},     {"ai3", "ǎi"},
-            {"ai4", "ài"},     {"ai5", "ai"},     {"an1", "ān"},
-            {"an2", "án"},     {"an3", "ǎn"},     {"an4", "àn"},
-            {"ao1", "āo"},     {"ao2", "áo"},     {"ao3", "ǎo"},
-            {"ao4", "ào"},     {"ao5", "ao"},     {"eh2", "ế"},
-            {"eh3", "êˇ"},     {"eh4", "ề"},      {"eh5", "ê"},
-            {"ei1", "ēi"},     {"ei2", "éi"},     {"ei3", "ěi"},
-            {"ei4", "èi"},     {"ei5", "ei"},     {"en1", "ēn"},
-            {"en2", "én"},     {"en3", "ěn"},     {"en4", "èn"},
-            {"en5", "en"},     {"er1", "ēr"},     {"er2", "ér"},
-            {"er3", "ěr"},     {"er4", "èr"},     {"er5", "er"},
-            {"ia1", "iā"},     {"ia2", "iá"},     {"ia3", "iǎ"},
-            {"ia4", "ià"},     {"ie1", "iē"},     {"ie2", "ié"},
-            {"ie3", "iě"},     {"ie4", "iè"},     {"ie5", "ie"},
-            {"in1", "īn"},     {"in2", "ín"},     {"in3", "ǐn"},
-            {"in4", "ìn"},     {"iu1", "iū"},     {"iu2", "iú"},
-            {"iu3", "iǔ"},     {"iu4", "iù"},     {"ou1", "ōu"},
-            {"ou2", "óu"},     {"ou3", "ǒu"},     {"ou4", "òu"},
-            {"ou5", "ou"},     {"ua1", "uā"},     {"ua2", "uá"},
-            {"ua3", "uǎ"},     {"ua4", "uà"},     {"ue1", "uē"},
-            {"ue2", "ué"},     {"ue3", "uě"},     {"ue4", "uè"},
-            {"ui1", "uī"},     {"ui2", "uí"},     {"ui3", "uǐ"},
-            {"ui4", "uì"},     {"un1", "ūn"},     {"un2", "ún"},
-            {"un3", "ǔn"},     {"un4", "ùn"},     {"uo1", "uō"},
-            {"uo2", "uó"},     {"uo3", "uǒ"},     {"uo4", "uò"},
-            {"uo5", "uo"},     {"ve1", "üē"},     {"ve3", "üě"},
-            {"ve4", "üè"},
-
-            {"a1", "ā"},       {"a2", "á"},       {"a3", "ǎ"},
-            {"a4", "à"},       {"a5", "a"},       {"e1", "ē"},
-            {"e2", "é"},       {"e3", "ě"},       {"e4", "è"},
-            {"e5", "e"},       {"i1", "ī"},       {"i2", "í"},
-            {"i3", "ǐ"},       {"i4", "ì"},       {"i5", "i"},
-            {"o1", "ō"},       {"o2", "ó"},       {"o3", "ǒ"},
-            {"o4", "ò"},       {"o5", "o"},       {"u1", "ū"},
-            {"u2", "ú"},       {"u3", "ǔ"},       {"u4", "ù"},
-            {"v1", "ǖ"},       {"v2", "ǘ"},       {"v3", "ǚ"},
-            {"v4", "ǜ"}};
+inline static constexpr StringPair _hanyuPinyinTextbookStylePairs[] =
+    {  // 排序很重要。先處理最長的，再處理短的。不然會出亂子。
+        {"iang1", "iāng"}, {"iang2", "iáng"}, {"iang3", "iǎng"},
+        {"iang4", "iàng"}, {"iong1", "iōng"}, {"iong2", "ióng"},
+        {"iong3", "iǒng"}, {"iong4", "iòng"}, {"uang1", "uāng"},
+        {"uang2", "uáng"}, {"uang3", "uǎng"}, {"uang4", "uàng"},
+        {"uang5", "uang"},
+
+        {"ang1", "āng"},   {"ang2", "áng"},   {"ang3", "ǎng"},
+        {"ang4", "àng"},   {"ang5", "ang"},   {"eng1", "ēng"},
+        {"eng2", "éng"},   {"eng3", "ěng"},   {"eng4", "èng"},
+        {"ian1", "iān"},   {"ian2", "ián"},   {"ian3", "iǎn"},
+        {"ian4", "iàn"},   {"iao1", "iāo"},   {"iao2", "iáo"},
+        {"iao3", "iǎo"},   {"iao4", "iào"},   {"ing1", "īng"},
+        {"ing2", "íng"},   {"ing3", "ǐng"},   {"ing4", "ìng"},
+        {"ong1", "ōng"},   {"ong2", "óng"},   {"ong3", "ǒng"},
+        {"ong4", "òng"},   {"uai1", "uāi"},   {"uai2", "uái"},
+        {"uai3", "uǎi"},   {"uai4", "uài"},   {"uan1", "uān"},
+        {"uan2", "uán"},   {"uan3", "uǎn"},   {"uan4", "uàn"},
+        {"van2", "üán"},   {"van3", "üǎn"},
+
+        {"ai1", "āi"},     {"ai2", "ái"},     {"ai3", "ǎi"},
+        {"ai4", "ài"},     {"ai5", "ai"},     {"an1", "ān"},
+        {"an2", "án"},     {"an3", "ǎn"},     {"an4", "àn"},
+        {"ao1", "āo"},     {"ao2", "áo"},     {"ao3", "ǎo"},
+        {"ao4", "ào"},     {"ao5", "ao"},     {"eh2", "ế"},
+        {"eh3", "êˇ"},     {"eh4", "ề"},      {"eh5", "ê"},
+        {"ei1", "ēi"},     {"ei2", "éi"},     {"ei3", "ěi"},
+        {"ei4", "èi"},     {"ei5", "ei"},     {"en1", "ēn"},
+        {"en2", "én"},     {"en3", "ěn"},     {"en4", "èn"},
+        {"en5", "en"},     {"er1", "ēr"},     {"er2", "ér"},
+        {"er3", "ěr"},     {"er4", "èr"},     {"er5", "er"},
+        {"ia1", "iā"},     {"ia2", "iá"},     {"ia3", "iǎ"},
+        {"ia4", "ià"},     {"ie1", "iē"},     {"ie2", "ié"},
+        {"ie3", "iě"},     {"ie4", "iè"},     {"ie5", "ie"},
+        {"in1", "īn"},     {"in2", "ín"},     {"in3", "ǐn"},
+        {"in4", "ìn"},     {"iu1", "iū"},     {"iu2", "iú"},
+        {"iu3", "iǔ"},     {"iu4", "iù"},     {"ou1", "ōu"},
+        {"ou2", "óu"},     {"ou3", "ǒu"},     {"ou4", "òu"},
+        {"ou5", "ou"},     {"ua1", "uā"},     {"ua2", "uá"},
+        {"ua3", "uǎ"},     {"ua4", "uà"},     {"ue1", "uē"},
+        {"ue2", "ué"},     {"ue3", "uě"},     {"ue4", "uè"},
+        {"ui1", "uī"},     {"ui2", "uí"},     {"ui3", "uǐ"},
+        {"ui4", "uì"},     {"un1", "ūn"},     {"un2", "ún"},
+        {"un3", "ǔn"},     {"un4", "ùn"},     {"uo1", "uō"},
+        {"uo2", "uó"},     {"uo3", "uǒ"},     {"uo4", "uò"},
+        {"uo5", "uo"},     {"ve1", "üē"},     {"ve3", "üě"},
+        {"ve4", "üè"},
+
+        {"a1", "ā"},       {"a2", "á"},       {"a3", "ǎ"},
+        {"a4", "à"},       {"a5", "a"},       {"e1", "ē"},
+        {"e2", "é"},       {"e3", "ě"},       {"e4", "è"},
+        {"e5", "e"},       {"i1", "ī"},       {"i2", "í"},
+        {"i3", "ǐ"},       {"i4", "ì"},       {"i5", "i"},
+        {"o1", "ō"},       {"o2", "ó"},       {"o3", "ǒ"},
+        {"o4", "ò"},       {"o5", "o"},       {"u1", "ū"},
+        {"u2", "ú"},       {"u3", "ǔ"},       {"u4", "ù"},
+        {"v1", "ǖ"},       {"v2", "ǘ"},       {"v3", "ǚ"},
+        {"v4", "ǜ"}};
+inline static constexpr StringTable _hanyuPinyinTextbookStyleTable{
+    _hanyuPinyinTextbookStylePairs};
+static_assert(_hanyuPinyinTextbookStyleTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::vector 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::vector<std::vector<std::string>>>
+    arrHanyuPinyinTextbookStyleConversionTable{
+        [] { return _hanyuPinyinTextbookStyleTable.view().toRows(); }};
 
 // MARK: - Maps for Keyboard-to-Pinyin parsers
 
 /// 任何形式的拼音排列都會用到的陣列（韋氏拼音與趙元任國語羅馬字除外），
 /// 用 Strings 反而省事一些。
 /// 這裡同時兼容大千注音的調號數字，所以也將 6、7 號數字鍵放在允許範圍內。
-inline static std::string mapArayuruPinyin =
+inline static constexpr std::string_view mapArayuruPinyin =
     "abcdefghijklmnopqrstuvwxyz1234567 ";
 
 /// 任何形式的拼音排列都會用到的陣列（韋氏拼音與趙元任國語羅馬字除外），
 /// 用 Strings 反而省事一些。
 /// 這裡同時兼容大千注音的調號數字，所以也將 6、7 號數字鍵放在允許範圍內。
-inline static std::string mapWadeGilesPinyinKeys = mapArayuruPinyin + "'";
+inline static constexpr std::string_view mapWadeGilesPinyinKeys =
+    "abcdefghijklmnopqrstuvwxyz1234567 '";
 
 /// 任何拼音都會用到的聲調鍵陣列
-inline static std::map<std::string, std::string> mapArayuruPinyinIntonation = {
+inline static constexpr StringPair _arayuruPinyinIntonationPairs[] = {
     {"1", " "}, {"2", "ˊ"}, {"3", "ˇ"}, {"4", "ˋ"},
     {"5", "˙"}, {"6", "ˊ"}, {"7", "˙"}, {" ", " "}};
+inline static constexpr StringTable _arayuruPinyinIntonationTable{
+    _arayuruPinyinIntonationPairs};
+static_assert(_arayuruPinyinIntonationTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::map 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapArayuruPinyinIntonation{
+        [] { return _arayuruPinyinIntonationTable.view().toMap(); }};
 
 /// 漢語拼音排列專用處理陣列
-inline static std::map<std::string, std::string> mapHanyuPinyin = {
+inline static constexpr StringPair _hanyuPinyinPairs[] = {
     {"chuang", "ㄔㄨㄤ"}, {"shuang", "ㄕㄨㄤ"}, {"zhuang", "ㄓㄨㄤ"},
     {"chang", "ㄔㄤ"},    {"cheng", "ㄔㄥ"},    {"chong", "ㄔㄨㄥ"},
     {"chuai", "ㄔㄨㄞ"},  {"chuan", "ㄔㄨㄢ"},  {"guang", "ㄍㄨㄤ"},
@@ -574,9 +838,14 @@ inline static std::map<std::string, std::string> mapHanyuPinyin = {
     {"ze", "ㄗㄜ"},       {"zi", "ㄗ"},         {"zu", "ㄗㄨ"},
     {"a", "ㄚ"},          {"e", "ㄜ"},          {"o", "ㄛ"},
     {"q", "ㄑ"}};
+inline static constexpr StringTable _hanyuPinyinTable{_hanyuPinyinPairs};
+static_assert(_hanyuPinyinTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::map 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapHanyuPinyin{[] { return _hanyuPinyinTable.view().toMap(); }};
 
 /// 國音二式排列專用處理陣列
-inline static std::map<std::string, std::string> mapSecondaryPinyin = {
+inline static constexpr StringPair _secondaryPinyinPairs[] = {
     {"chuang", "ㄔㄨㄤ"}, {"shuang", "ㄕㄨㄤ"}, {"chiang", "ㄑㄧㄤ"},
     {"chiung", "ㄑㄩㄥ"}, {"chiuan", "ㄑㄩㄢ"}, {"shiang", "ㄒㄧㄤ"},
     {"shiung", "ㄒㄩㄥ"}, {"shiuan", "ㄒㄩㄢ"}, {"biang", "ㄅㄧㄤ"},
@@ -718,9 +987,15 @@ inline static std::map<std::string, std::string> mapSecondaryPinyin = {
     {"wa", "ㄨㄚ"},       {"wo", "ㄨㄛ"},       {"yu", "ㄩ"},
     {"ch", "ㄑ"},         {"yi", "ㄧ"},         {"r", "ㄖ"},
     {"a", "ㄚ"},          {"o", "ㄛ"},          {"e", "ㄜ"}};
+inline static constexpr StringTable _secondaryPinyinTable{
+    _secondaryPinyinPairs};
+static_assert(_secondaryPinyinTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::map 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapSecondaryPinyin{[] { return _secondaryPinyinTable.view().toMap(); }};
 
 /// 耶魯拼音排列專用處理陣列
-inline static std::map<std::string, std::string> mapYalePinyin = {
+inline static constexpr StringPair _yalePinyinPairs[] = {
     {"chwang", "ㄔㄨㄤ"}, {"shwang", "ㄕㄨㄤ"}, {"chyang", "ㄑㄧㄤ"},
     {"chyung", "ㄑㄩㄥ"}, {"chywan", "ㄑㄩㄢ"}, {"byang", "ㄅㄧㄤ"},
     {"dwang", "ㄉㄨㄤ"},  {"jwang", "ㄓㄨㄤ"},  {"syang", "ㄒㄧㄤ"},
@@ -862,9 +1137,14 @@ inline static std::map<std::string, std::string> mapYalePinyin = {
     {"wa", "ㄨㄚ"},       {"wo", "ㄨㄛ"},       {"yu", "ㄩ"},
     {"ch", "ㄑ"},         {"yi", "ㄧ"},         {"r", "ㄖ"},
     {"a", "ㄚ"},          {"o", "ㄛ"},          {"e", "ㄜ"}};
+inline static constexpr StringTable _yalePinyinTable{_yalePinyinPairs};
+static_assert(_yalePinyinTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::map 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapYalePinyin{[] { return _yalePinyinTable.view().toMap(); }};
 
 /// 華羅拼音排列專用處理陣列
-inline static std::map<std::string, std::string> mapHualuoPinyin = {
+inline static constexpr StringPair _hualuoPinyinPairs[] = {
     {"shuang", "ㄕㄨㄤ"}, {"jhuang", "ㄓㄨㄤ"}, {"chyueh", "ㄑㄩㄝ"},
     {"chyuan", "ㄑㄩㄢ"}, {"chyong", "ㄑㄩㄥ"}, {"chiang", "ㄑㄧㄤ"},
     {"chuang", "ㄔㄨㄤ"}, {"biang", "ㄅㄧㄤ"},  {"duang", "ㄉㄨㄤ"},
@@ -1006,9 +1286,14 @@ inline static std::map<std::string, std::string> mapHualuoPinyin = {
     {"bo", "ㄅㄛ"},       {"bi", "ㄅㄧ"},       {"ba", "ㄅㄚ"},
     {"ao", "ㄠ"},         {"an", "ㄢ"},         {"ai", "ㄞ"},
     {"o", "ㄛ"},          {"e", "ㄜ"},          {"a", "ㄚ"}};
+inline static constexpr StringTable _hualuoPinyinTable{_hualuoPinyinPairs};
+static_assert(_hualuoPinyinTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::map 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapHualuoPinyin{[] { return _hualuoPinyinTable.view().toMap(); }};
 
 /// 通用拼音排列專用處理陣列
-inline static std::map<std::string, std::string> mapUniversalPinyin = {
+inline static constexpr StringPair _universalPinyinPairs[] = {
     {"shuang", "ㄕㄨㄤ"}, {"jhuang", "ㄓㄨㄤ"}, {"chuang", "ㄔㄨㄤ"},
     {"biang", "ㄅㄧㄤ"},  {"duang", "ㄉㄨㄤ"},  {"cyuan", "ㄑㄩㄢ"},
     {"cyong", "ㄑㄩㄥ"},  {"ciang", "ㄑㄧㄤ"},  {"kyang", "ㄎㄧㄤ"},
@@ -1150,9 +1435,15 @@ inline static std::map<std::string, std::string> mapUniversalPinyin = {
     {"bi", "ㄅㄧ"},       {"ba", "ㄅㄚ"},       {"ao", "ㄠ"},
     {"an", "ㄢ"},         {"ai", "ㄞ"},         {"c", "ㄑ"},
     {"o", "ㄛ"},          {"e", "ㄜ"},          {"a", "ㄚ"}};
+inline static constexpr StringTable _universalPinyinTable{
+    _universalPinyinPairs};
+static_assert(_universalPinyinTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::map 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapUniversalPinyin{[] { return _universalPinyinTable.view().toMap(); }};
 
 /// 韋氏拼音排列專用處理陣列
-inline static std::map<std::string, std::string> mapWadeGilesPinyin = {
+inline static constexpr StringPair _wadeGilesPinyinPairs[] = {
     {"a", "ㄚ"},           {"ai", "ㄞ"},         {"an", "ㄢ"},
     {"ang", "ㄤ"},         {"ao", "ㄠ"},         {"cha", "ㄓㄚ"},
     {"chai", "ㄓㄞ"},      {"chan", "ㄓㄢ"},     {"chang", "ㄓㄤ"},
@@ -1290,156 +1581,310 @@ inline static std::map<std::string, std::string> mapWadeGilesPinyin = {
     {"ying", "ㄧㄥ"},      {"yu", "ㄧㄡ"},       {"yung", "ㄩㄥ"},
     {"yv", "ㄩ"},          {"yvan", "ㄩㄢ"},     {"yveh", "ㄩㄝ"},
     {"yvn", "ㄩㄣ"}};
+inline static constexpr StringTable _wadeGilesPinyinTable{
+    _wadeGilesPinyinPairs};
+static_assert(_wadeGilesPinyinTable.hasUniqueKeys());
+/// 同上，供舊版 API 使用的 std::map 版本，首次存取時才會生成。
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapWadeGilesPinyin{[] { return _wadeGilesPinyinTable.view().toMap(); }};
 
 // MARK: - Maps for Keyboard-to-Phonabet parsers
 
+/// 單個 ASCII 按鍵到單個注音符號的對應。
+struct KeyPhonabetPair {
+  char key;
+  char32_t phonabet;
+};
+
+/// 以按鍵對應陣列生成舊版 API 所使用的 std::map 辭典。
+template <size_t N>
+inline static std::map<std::string, std::string> buildKeyMap(
+    const KeyPhonabetPair (&pairs)[N]) {
+  std::map<std::string, std::string> result;
+  for (const auto& pair : pairs) {
+    result[charToString(pair.key)] = char32ToString(pair.phonabet);
+  }
+  return result;
+}
+
+/// 以按鍵對應陣列於編譯期生成 128 格的 ASCII 查詢表。
+/// 沒有對應的按鍵會被填為 0。
+template <size_t N>
+constexpr std::array<char32_t, 128> buildAsciiKeyTable(
+    const KeyPhonabetPair (&pairs)[N]) {
+  std::array<char32_t, 128> result{};
+  for (const auto& pair : pairs) {
+    result[static_cast<unsigned char>(pair.key) & 0x7F] = pair.phonabet;
+  }
+  return result;
+}
+
 /// 標準大千排列專用處理陣列。
 ///
 /// 唯音輸入法 macOS 版使用了 Ukelele 佈局來完成對
 /// 諸如倚天傳統等其它注音鍵盤排列的支援。如果要將鐵
 /// 恨模組拿給別的平台的輸入法使用的話，恐怕需要針對
 /// 這些注音鍵盤排列各自新增專用陣列才可以。
-inline static std::map<std::string, std::string> mapQwertyDachen = {
-    {"0", "ㄢ"}, {"1", "ㄅ"}, {"2", "ㄉ"}, {"3", "ˇ"},  {"4", "ˋ"},
-    {"5", "ㄓ"}, {"6", "ˊ"},  {"7", "˙"},  {"8", "ㄚ"}, {"9", "ㄞ"},
-    {"-", "ㄦ"}, {",", "ㄝ"}, {".", "ㄡ"}, {"/", "ㄥ"}, {";", "ㄤ"},
-    {"a", "ㄇ"}, {"b", "ㄖ"}, {"c", "ㄏ"}, {"d", "ㄎ"}, {"e", "ㄍ"},
-    {"f", "ㄑ"}, {"g", "ㄕ"}, {"h", "ㄘ"}, {"i", "ㄛ"}, {"j", "ㄨ"},
-    {"k", "ㄜ"}, {"l", "ㄠ"}, {"m", "ㄩ"}, {"n", "ㄙ"}, {"o", "ㄟ"},
-    {"p", "ㄣ"}, {"q", "ㄆ"}, {"r", "ㄐ"}, {"s", "ㄋ"}, {"t", "ㄔ"},
-    {"u", "ㄧ"}, {"v", "ㄒ"}, {"w", "ㄊ"}, {"x", "ㄌ"}, {"y", "ㄗ"},
-    {"z", "ㄈ"}, {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysQwertyDachen[] = {
+    {'0', U'ㄢ'}, {'1', U'ㄅ'}, {'2', U'ㄉ'}, {'3', U'ˇ'},
+    {'4', U'ˋ'}, {'5', U'ㄓ'}, {'6', U'ˊ'}, {'7', U'˙'},
+    {'8', U'ㄚ'}, {'9', U'ㄞ'}, {'-', U'ㄦ'}, {',', U'ㄝ'},
+    {'.', U'ㄡ'}, {'/', U'ㄥ'}, {';', U'ㄤ'}, {'a', U'ㄇ'},
+    {'b', U'ㄖ'}, {'c', U'ㄏ'}, {'d', U'ㄎ'}, {'e', U'ㄍ'},
+    {'f', U'ㄑ'}, {'g', U'ㄕ'}, {'h', U'ㄘ'}, {'i', U'ㄛ'},
+    {'j', U'ㄨ'}, {'k', U'ㄜ'}, {'l', U'ㄠ'}, {'m', U'ㄩ'},
+    {'n', U'ㄙ'}, {'o', U'ㄟ'}, {'p', U'ㄣ'}, {'q', U'ㄆ'},
+    {'r', U'ㄐ'}, {'s', U'ㄋ'}, {'t', U'ㄔ'}, {'u', U'ㄧ'},
+    {'v', U'ㄒ'}, {'w', U'ㄊ'}, {'x', U'ㄌ'}, {'y', U'ㄗ'},
+    {'z', U'ㄈ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapQwertyDachen{[] { return buildKeyMap(_keysQwertyDachen); }};
 
 /// 酷音大千二十六鍵排列專用處理陣列，但未包含全部的處理內容。
 ///
 /// 在這裡將二十六個字母寫全，也只是為了方便做 validity check。
 /// 這裡提前對複音按鍵做處理，然後再用程式判斷介母類型、
 /// 據此判斷是否需要做複音切換。
-inline static std::map<std::string, std::string> mapDachenCP26StaticKeys = {
-    {"a", "ㄇ"}, {"b", "ㄖ"}, {"c", "ㄏ"}, {"d", "ㄎ"}, {"e", "ㄍ"},
-    {"f", "ㄑ"}, {"g", "ㄕ"}, {"h", "ㄘ"}, {"i", "ㄞ"}, {"j", "ㄨ"},
-    {"k", "ㄜ"}, {"l", "ㄤ"}, {"m", "ㄩ"}, {"n", "ㄙ"}, {"o", "ㄢ"},
-    {"p", "ㄦ"}, {"q", "ㄅ"}, {"r", "ㄐ"}, {"s", "ㄋ"}, {"t", "ㄓ"},
-    {"u", "ㄧ"}, {"v", "ㄒ"}, {"w", "ㄉ"}, {"x", "ㄌ"}, {"y", "ㄗ"},
-    {"z", "ㄈ"}, {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysDachenCP26Static[] = {
+    {'a', U'ㄇ'}, {'b', U'ㄖ'}, {'c', U'ㄏ'}, {'d', U'ㄎ'},
+    {'e', U'ㄍ'}, {'f', U'ㄑ'}, {'g', U'ㄕ'}, {'h', U'ㄘ'},
+    {'i', U'ㄞ'}, {'j', U'ㄨ'}, {'k', U'ㄜ'}, {'l', U'ㄤ'},
+    {'m', U'ㄩ'}, {'n', U'ㄙ'}, {'o', U'ㄢ'}, {'p', U'ㄦ'},
+    {'q', U'ㄅ'}, {'r', U'ㄐ'}, {'s', U'ㄋ'}, {'t', U'ㄓ'},
+    {'u', U'ㄧ'}, {'v', U'ㄒ'}, {'w', U'ㄉ'}, {'x', U'ㄌ'},
+    {'y', U'ㄗ'}, {'z', U'ㄈ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapDachenCP26StaticKeys{[] { return buildKeyMap(_keysDachenCP26Static); }};
 
 /// 許氏排列專用處理陣列，但未包含全部的映射內容。
 ///
 /// 在這裡將二十六個字母寫全，也只是為了方便做 validity check。
 /// 這裡提前對複音按鍵做處理，然後再用程式判斷介母類型、
 /// 據此判斷是否需要做複音切換。
-inline static std::map<std::string, std::string> mapHsuStaticKeys = {
-    {"a", "ㄘ"}, {"b", "ㄅ"}, {"c", "ㄕ"}, {"d", "ㄉ"}, {"e", "ㄧ"},
-    {"f", "ㄈ"}, {"g", "ㄍ"}, {"h", "ㄏ"}, {"i", "ㄞ"}, {"j", "ㄐ"},
-    {"k", "ㄎ"}, {"l", "ㄌ"}, {"m", "ㄇ"}, {"n", "ㄋ"}, {"o", "ㄡ"},
-    {"p", "ㄆ"}, {"r", "ㄖ"}, {"s", "ㄙ"}, {"t", "ㄊ"}, {"u", "ㄩ"},
-    {"v", "ㄔ"}, {"w", "ㄠ"}, {"x", "ㄨ"}, {"y", "ㄚ"}, {"z", "ㄗ"},
-    {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysHsuStatic[] = {
+    {'a', U'ㄘ'}, {'b', U'ㄅ'}, {'c', U'ㄕ'}, {'d', U'ㄉ'},
+    {'e', U'ㄧ'}, {'f', U'ㄈ'}, {'g', U'ㄍ'}, {'h', U'ㄏ'},
+    {'i', U'ㄞ'}, {'j', U'ㄐ'}, {'k', U'ㄎ'}, {'l', U'ㄌ'},
+    {'m', U'ㄇ'}, {'n', U'ㄋ'}, {'o', U'ㄡ'}, {'p', U'ㄆ'},
+    {'r', U'ㄖ'}, {'s', U'ㄙ'}, {'t', U'ㄊ'}, {'u', U'ㄩ'},
+    {'v', U'ㄔ'}, {'w', U'ㄠ'}, {'x', U'ㄨ'}, {'y', U'ㄚ'},
+    {'z', U'ㄗ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapHsuStaticKeys{[] { return buildKeyMap(_keysHsuStatic); }};
 
 /// 星光排列專用處理陣列，但未包含全部的映射內容。
 ///
 /// 在這裡將二十六個字母寫全，也只是為了方便做 validity check。
 /// 這裡提前對複音按鍵做處理，然後再用程式判斷介母類型、
 /// 據此判斷是否需要做複音切換。
-inline static std::map<std::string, std::string> mapStarlightStaticKeys = {
-    {"a", "ㄚ"}, {"b", "ㄅ"}, {"c", "ㄘ"}, {"d", "ㄉ"}, {"e", "ㄜ"},
-    {"f", "ㄈ"}, {"g", "ㄍ"}, {"h", "ㄏ"}, {"i", "ㄧ"}, {"j", "ㄓ"},
-    {"k", "ㄎ"}, {"l", "ㄌ"}, {"m", "ㄇ"}, {"n", "ㄋ"}, {"o", "ㄛ"},
-    {"p", "ㄆ"}, {"q", "ㄔ"}, {"r", "ㄖ"}, {"s", "ㄙ"}, {"t", "ㄊ"},
-    {"u", "ㄨ"}, {"v", "ㄩ"}, {"w", "ㄡ"}, {"x", "ㄕ"}, {"y", "ㄞ"},
-    {"z", "ㄗ"}, {" ", " "},  {"1", " "},  {"2", "ˊ"},  {"3", "ˇ"},
-    {"4", "ˋ"},  {"5", "˙"},  {"6", " "},  {"7", "ˊ"},  {"8", "ˇ"},
-    {"9", "ˋ"},  {"0", "˙"}};
+inline static constexpr KeyPhonabetPair _keysStarlightStatic[] = {
+    {'a', U'ㄚ'}, {'b', U'ㄅ'}, {'c', U'ㄘ'}, {'d', U'ㄉ'},
+    {'e', U'ㄜ'}, {'f', U'ㄈ'}, {'g', U'ㄍ'}, {'h', U'ㄏ'},
+    {'i', U'ㄧ'}, {'j', U'ㄓ'}, {'k', U'ㄎ'}, {'l', U'ㄌ'},
+    {'m', U'ㄇ'}, {'n', U'ㄋ'}, {'o', U'ㄛ'}, {'p', U'ㄆ'},
+    {'q', U'ㄔ'}, {'r', U'ㄖ'}, {'s', U'ㄙ'}, {'t', U'ㄊ'},
+    {'u', U'ㄨ'}, {'v', U'ㄩ'}, {'w', U'ㄡ'}, {'x', U'ㄕ'},
+    {'y', U'ㄞ'}, {'z', U'ㄗ'}, {' ', U' '}, {'1', U' '},
+    {'2', U'ˊ'}, {'3', U'ˇ'}, {'4', U'ˋ'}, {'5', U'˙'},
+    {'6', U' '}, {'7', U'ˊ'}, {'8', U'ˇ'}, {'9', U'ˋ'},
+    {'0', U'˙'}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapStarlightStaticKeys{[] { return buildKeyMap(_keysStarlightStatic); }};
 
 /// 倚天忘形排列預處理專用陣列，但未包含全部的映射內容。
 ///
 /// 在這裡將二十六個字母寫全，也只是為了方便做 validity check。
 /// 這裡提前對複音按鍵做處理，然後再用程式判斷介母類型、
 /// 據此判斷是否需要做複音切換。
-inline static std::map<std::string, std::string> mapETen26StaticKeys = {
-    {"a", "ㄚ"}, {"b", "ㄅ"}, {"c", "ㄕ"}, {"d", "ㄉ"}, {"e", "ㄧ"},
-    {"f", "ㄈ"}, {"g", "ㄓ"}, {"h", "ㄏ"}, {"i", "ㄞ"}, {"j", "ㄖ"},
-    {"k", "ㄎ"}, {"l", "ㄌ"}, {"m", "ㄇ"}, {"n", "ㄋ"}, {"o", "ㄛ"},
-    {"p", "ㄆ"}, {"q", "ㄗ"}, {"r", "ㄜ"}, {"s", "ㄙ"}, {"t", "ㄊ"},
-    {"u", "ㄩ"}, {"v", "ㄍ"}, {"w", "ㄘ"}, {"x", "ㄨ"}, {"y", "ㄔ"},
-    {"z", "ㄠ"}, {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysETen26Static[] = {
+    {'a', U'ㄚ'}, {'b', U'ㄅ'}, {'c', U'ㄕ'}, {'d', U'ㄉ'},
+    {'e', U'ㄧ'}, {'f', U'ㄈ'}, {'g', U'ㄓ'}, {'h', U'ㄏ'},
+    {'i', U'ㄞ'}, {'j', U'ㄖ'}, {'k', U'ㄎ'}, {'l', U'ㄌ'},
+    {'m', U'ㄇ'}, {'n', U'ㄋ'}, {'o', U'ㄛ'}, {'p', U'ㄆ'},
+    {'q', U'ㄗ'}, {'r', U'ㄜ'}, {'s', U'ㄙ'}, {'t', U'ㄊ'},
+    {'u', U'ㄩ'}, {'v', U'ㄍ'}, {'w', U'ㄘ'}, {'x', U'ㄨ'},
+    {'y', U'ㄔ'}, {'z', U'ㄠ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapETen26StaticKeys{[] { return buildKeyMap(_keysETen26Static); }};
 
 /// 劉氏擬音注音排列預處理專用陣列，但未包含全部的映射內容。
 ///
 /// 在這裡將二十六個字母寫全，也只是為了方便做 validity check。
 /// 這裡提前對複音按鍵做處理，然後再用程式判斷介母類型、
 /// 據此判斷是否需要做複音切換。
-inline static std::map<std::string, std::string> mapAlvinLiuStaticKeys = {
-    {"q", "ㄑ"}, {"w", "ㄠ"}, {"e", "ㄜ"}, {"r", "ㄖ"}, {"t", "ㄊ"},
-    {"y", "ㄩ"}, {"u", "ㄨ"}, {"i", "ㄧ"}, {"o", "ㄛ"}, {"p", "ㄆ"},
-    {"a", "ㄚ"}, {"s", "ㄙ"}, {"d", "ㄉ"}, {"f", "ㄈ"}, {"g", "ㄍ"},
-    {"h", "ㄏ"}, {"j", "ㄐ"}, {"k", "ㄎ"}, {"l", "ㄦ"}, {"z", "ㄗ"},
-    {"x", "ㄒ"}, {"c", "ㄘ"}, {"v", "ㄡ"}, {"b", "ㄅ"}, {"n", "ㄋ"},
-    {"m", "ㄇ"}, {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysAlvinLiuStatic[] = {
+    {'q', U'ㄑ'}, {'w', U'ㄠ'}, {'e', U'ㄜ'}, {'r', U'ㄖ'},
+    {'t', U'ㄊ'}, {'y', U'ㄩ'}, {'u', U'ㄨ'}, {'i', U'ㄧ'},
+    {'o', U'ㄛ'}, {'p', U'ㄆ'}, {'a', U'ㄚ'}, {'s', U'ㄙ'},
+    {'d', U'ㄉ'}, {'f', U'ㄈ'}, {'g', U'ㄍ'}, {'h', U'ㄏ'},
+    {'j', U'ㄐ'}, {'k', U'ㄎ'}, {'l', U'ㄦ'}, {'z', U'ㄗ'},
+    {'x', U'ㄒ'}, {'c', U'ㄘ'}, {'v', U'ㄡ'}, {'b', U'ㄅ'},
+    {'n', U'ㄋ'}, {'m', U'ㄇ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapAlvinLiuStaticKeys{[] { return buildKeyMap(_keysAlvinLiuStatic); }};
 
 /// 倚天傳統排列專用處理陣列。
-inline static std::map<std::string, std::string> mapQwertyETenTraditional = {
-    {"'", "ㄘ"}, {",", "ㄓ"}, {"-", "ㄥ"}, {".", "ㄔ"}, {"/", "ㄕ"},
-    {"0", "ㄤ"}, {"1", "˙"},  {"2", "ˊ"},  {"3", "ˇ"},  {"4", "ˋ"},
-    {"7", "ㄑ"}, {"8", "ㄢ"}, {"9", "ㄣ"}, {";", "ㄗ"}, {"=", "ㄦ"},
-    {"a", "ㄚ"}, {"b", "ㄅ"}, {"c", "ㄒ"}, {"d", "ㄉ"}, {"e", "ㄧ"},
-    {"f", "ㄈ"}, {"g", "ㄐ"}, {"h", "ㄏ"}, {"i", "ㄞ"}, {"j", "ㄖ"},
-    {"k", "ㄎ"}, {"l", "ㄌ"}, {"m", "ㄇ"}, {"n", "ㄋ"}, {"o", "ㄛ"},
-    {"p", "ㄆ"}, {"q", "ㄟ"}, {"r", "ㄜ"}, {"s", "ㄙ"}, {"t", "ㄊ"},
-    {"u", "ㄩ"}, {"v", "ㄍ"}, {"w", "ㄝ"}, {"x", "ㄨ"}, {"y", "ㄡ"},
-    {"z", "ㄠ"}, {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysQwertyETenTraditional[] = {
+    {'\'', U'ㄘ'}, {',', U'ㄓ'}, {'-', U'ㄥ'}, {'.', U'ㄔ'},
+    {'/', U'ㄕ'}, {'0', U'ㄤ'}, {'1', U'˙'}, {'2', U'ˊ'},
+    {'3', U'ˇ'}, {'4', U'ˋ'}, {'7', U'ㄑ'}, {'8', U'ㄢ'},
+    {'9', U'ㄣ'}, {';', U'ㄗ'}, {'=', U'ㄦ'}, {'a', U'ㄚ'},
+    {'b', U'ㄅ'}, {'c', U'ㄒ'}, {'d', U'ㄉ'}, {'e', U'ㄧ'},
+    {'f', U'ㄈ'}, {'g', U'ㄐ'}, {'h', U'ㄏ'}, {'i', U'ㄞ'},
+    {'j', U'ㄖ'}, {'k', U'ㄎ'}, {'l', U'ㄌ'}, {'m', U'ㄇ'},
+    {'n', U'ㄋ'}, {'o', U'ㄛ'}, {'p', U'ㄆ'}, {'q', U'ㄟ'},
+    {'r', U'ㄜ'}, {'s', U'ㄙ'}, {'t', U'ㄊ'}, {'u', U'ㄩ'},
+    {'v', U'ㄍ'}, {'w', U'ㄝ'}, {'x', U'ㄨ'}, {'y', U'ㄡ'},
+    {'z', U'ㄠ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapQwertyETenTraditional{
+        [] { return buildKeyMap(_keysQwertyETenTraditional); }};
 
 /// IBM排列專用處理陣列。
-inline static std::map<std::string, std::string> mapQwertyIBM = {
-    {",", "ˇ"},  {"-", "ㄏ"}, {".", "ˋ"},  {"/", "˙"},  {"0", "ㄎ"},
-    {"1", "ㄅ"}, {"2", "ㄆ"}, {"3", "ㄇ"}, {"4", "ㄈ"}, {"5", "ㄉ"},
-    {"6", "ㄊ"}, {"7", "ㄋ"}, {"8", "ㄌ"}, {"9", "ㄍ"}, {";", "ㄠ"},
-    {"a", "ㄧ"}, {"b", "ㄥ"}, {"c", "ㄣ"}, {"d", "ㄩ"}, {"e", "ㄒ"},
-    {"f", "ㄚ"}, {"g", "ㄛ"}, {"h", "ㄜ"}, {"i", "ㄗ"}, {"j", "ㄝ"},
-    {"k", "ㄞ"}, {"l", "ㄟ"}, {"m", "ˊ"},  {"n", "ㄦ"}, {"o", "ㄘ"},
-    {"p", "ㄙ"}, {"q", "ㄐ"}, {"r", "ㄓ"}, {"s", "ㄨ"}, {"t", "ㄔ"},
-    {"u", "ㄖ"}, {"v", "ㄤ"}, {"w", "ㄑ"}, {"x", "ㄢ"}, {"y", "ㄕ"},
-    {"z", "ㄡ"}, {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysQwertyIBM[] = {
+    {',', U'ˇ'}, {'-', U'ㄏ'}, {'.', U'ˋ'}, {'/', U'˙'},
+    {'0', U'ㄎ'}, {'1', U'ㄅ'}, {'2', U'ㄆ'}, {'3', U'ㄇ'},
+    {'4', U'ㄈ'}, {'5', U'ㄉ'}, {'6', U'ㄊ'}, {'7', U'ㄋ'},
+    {'8', U'ㄌ'}, {'9', U'ㄍ'}, {';', U'ㄠ'}, {'a', U'ㄧ'},
+    {'b', U'ㄥ'}, {'c', U'ㄣ'}, {'d', U'ㄩ'}, {'e', U'ㄒ'},
+    {'f', U'ㄚ'}, {'g', U'ㄛ'}, {'h', U'ㄜ'}, {'i', U'ㄗ'},
+    {'j', U'ㄝ'}, {'k', U'ㄞ'}, {'l', U'ㄟ'}, {'m', U'ˊ'},
+    {'n', U'ㄦ'}, {'o', U'ㄘ'}, {'p', U'ㄙ'}, {'q', U'ㄐ'},
+    {'r', U'ㄓ'}, {'s', U'ㄨ'}, {'t', U'ㄔ'}, {'u', U'ㄖ'},
+    {'v', U'ㄤ'}, {'w', U'ㄑ'}, {'x', U'ㄢ'}, {'y', U'ㄕ'},
+    {'z', U'ㄡ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapQwertyIBM{[] { return buildKeyMap(_keysQwertyIBM); }};
 
 /// 精業排列專用處理陣列。
-inline static std::map<std::string, std::string> mapSeigyou = {
-    {"a", "ˇ"},  {"b", "ㄒ"}, {"c", "ㄌ"}, {"d", "ㄋ"}, {"e", "ㄊ"},
-    {"f", "ㄎ"}, {"g", "ㄑ"}, {"h", "ㄕ"}, {"i", "ㄛ"}, {"j", "ㄘ"},
-    {"k", "ㄜ"}, {"l", "ㄠ"}, {"m", "ㄙ"}, {"n", "ㄖ"}, {"o", "ㄟ"},
-    {"p", "ㄣ"}, {"q", "ˊ"},  {"r", "ㄍ"}, {"s", "ㄇ"}, {"t", "ㄐ"},
-    {"u", "ㄗ"}, {"v", "ㄏ"}, {"w", "ㄆ"}, {"x", "ㄈ"}, {"y", "ㄔ"},
-    {"z", "ˋ"},  {"1", "˙"},  {"2", "ㄅ"}, {"3", "ㄉ"}, {"6", "ㄓ"},
-    {"8", "ㄚ"}, {"9", "ㄞ"}, {"0", "ㄢ"}, {"-", "ㄧ"}, {";", "ㄤ"},
-    {",", "ㄝ"}, {".", "ㄡ"}, {"/", "ㄥ"}, {"'", "ㄩ"}, {"{", "ㄨ"},
-    {"=", "ㄦ"}, {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysSeigyou[] = {
+    {'a', U'ˇ'}, {'b', U'ㄒ'}, {'c', U'ㄌ'}, {'d', U'ㄋ'},
+    {'e', U'ㄊ'}, {'f', U'ㄎ'}, {'g', U'ㄑ'}, {'h', U'ㄕ'},
+    {'i', U'ㄛ'}, {'j', U'ㄘ'}, {'k', U'ㄜ'}, {'l', U'ㄠ'},
+    {'m', U'ㄙ'}, {'n', U'ㄖ'}, {'o', U'ㄟ'}, {'p', U'ㄣ'},
+    {'q', U'ˊ'}, {'r', U'ㄍ'}, {'s', U'ㄇ'}, {'t', U'ㄐ'},
+    {'u', U'ㄗ'}, {'v', U'ㄏ'}, {'w', U'ㄆ'}, {'x', U'ㄈ'},
+    {'y', U'ㄔ'}, {'z', U'ˋ'}, {'1', U'˙'}, {'2', U'ㄅ'},
+    {'3', U'ㄉ'}, {'6', U'ㄓ'}, {'8', U'ㄚ'}, {'9', U'ㄞ'},
+    {'0', U'ㄢ'}, {'-', U'ㄧ'}, {';', U'ㄤ'}, {',', U'ㄝ'},
+    {'.', U'ㄡ'}, {'/', U'ㄥ'}, {'\'', U'ㄩ'}, {'{', U'ㄨ'},
+    {'=', U'ㄦ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapSeigyou{[] { return buildKeyMap(_keysSeigyou); }};
 
 /// 偽精業排列專用處理陣列。
-inline static std::map<std::string, std::string> mapFakeSeigyou = {
-    {"a", "ˇ"},  {"b", "ㄒ"}, {"c", "ㄌ"}, {"d", "ㄋ"}, {"e", "ㄊ"},
-    {"f", "ㄎ"}, {"g", "ㄑ"}, {"h", "ㄕ"}, {"i", "ㄛ"}, {"j", "ㄘ"},
-    {"k", "ㄜ"}, {"l", "ㄠ"}, {"m", "ㄙ"}, {"n", "ㄖ"}, {"o", "ㄟ"},
-    {"p", "ㄣ"}, {"q", "ˊ"},  {"r", "ㄍ"}, {"s", "ㄇ"}, {"t", "ㄐ"},
-    {"u", "ㄗ"}, {"v", "ㄏ"}, {"w", "ㄆ"}, {"x", "ㄈ"}, {"y", "ㄔ"},
-    {"z", "ˋ"},  {"1", "˙"},  {"2", "ㄅ"}, {"3", "ㄉ"}, {"6", "ㄓ"},
-    {"8", "ㄚ"}, {"9", "ㄞ"}, {"0", "ㄢ"}, {"4", "ㄧ"}, {";", "ㄤ"},
-    {",", "ㄝ"}, {".", "ㄡ"}, {"/", "ㄥ"}, {"7", "ㄩ"}, {"5", "ㄨ"},
-    {"-", "ㄦ"}, {" ", " "}};
+inline static constexpr KeyPhonabetPair _keysFakeSeigyou[] = {
+    {'a', U'ˇ'}, {'b', U'ㄒ'}, {'c', U'ㄌ'}, {'d', U'ㄋ'},
+    {'e', U'ㄊ'}, {'f', U'ㄎ'}, {'g', U'ㄑ'}, {'h', U'ㄕ'},
+    {'i', U'ㄛ'}, {'j', U'ㄘ'}, {'k', U'ㄜ'}, {'l', U'ㄠ'},
+    {'m', U'ㄙ'}, {'n', U'ㄖ'}, {'o', U'ㄟ'}, {'p', U'ㄣ'},
+    {'q', U'ˊ'}, {'r', U'ㄍ'}, {'s', U'ㄇ'}, {'t', U'ㄐ'},
+    {'u', U'ㄗ'}, {'v', U'ㄏ'}, {'w', U'ㄆ'}, {'x', U'ㄈ'},
+    {'y', U'ㄔ'}, {'z', U'ˋ'}, {'1', U'˙'}, {'2', U'ㄅ'},
+    {'3', U'ㄉ'}, {'6', U'ㄓ'}, {'8', U'ㄚ'}, {'9', U'ㄞ'},
+    {'0', U'ㄢ'}, {'4', U'ㄧ'}, {';', U'ㄤ'}, {',', U'ㄝ'},
+    {'.', U'ㄡ'}, {'/', U'ㄥ'}, {'7', U'ㄩ'}, {'5', U'ㄨ'},
+    {'-', U'ㄦ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapFakeSeigyou{[] { return buildKeyMap(_keysFakeSeigyou); }};
 
 /// 神通排列專用處理陣列。
-inline static std::map<std::string, std::string> mapQwertyMiTAC = {
-    {",", "ㄓ"}, {"-", "ㄦ"}, {".", "ㄔ"}, {"/", "ㄕ"}, {"0", "ㄥ"},
-    {"1", "˙"},  {"2", "ˊ"},  {"3", "ˇ"},  {"4", "ˋ"},  {"5", "ㄞ"},
-    {"6", "ㄠ"}, {"7", "ㄢ"}, {"8", "ㄣ"}, {"9", "ㄤ"}, {";", "ㄝ"},
-    {"a", "ㄚ"}, {"b", "ㄅ"}, {"c", "ㄘ"}, {"d", "ㄉ"}, {"e", "ㄜ"},
-    {"f", "ㄈ"}, {"g", "ㄍ"}, {"h", "ㄏ"}, {"i", "ㄟ"}, {"j", "ㄐ"},
-    {"k", "ㄎ"}, {"l", "ㄌ"}, {"m", "ㄇ"}, {"n", "ㄋ"}, {"o", "ㄛ"},
-    {"p", "ㄆ"}, {"q", "ㄑ"}, {"r", "ㄖ"}, {"s", "ㄙ"}, {"t", "ㄊ"},
-    {"u", "ㄡ"}, {"v", "ㄩ"}, {"w", "ㄨ"}, {"x", "ㄒ"}, {"y", "ㄧ"},
-    {"z", "ㄗ"}, {" ", " "},
-};
+inline static constexpr KeyPhonabetPair _keysQwertyMiTAC[] = {
+    {',', U'ㄓ'}, {'-', U'ㄦ'}, {'.', U'ㄔ'}, {'/', U'ㄕ'},
+    {'0', U'ㄥ'}, {'1', U'˙'}, {'2', U'ˊ'}, {'3', U'ˇ'},
+    {'4', U'ˋ'}, {'5', U'ㄞ'}, {'6', U'ㄠ'}, {'7', U'ㄢ'},
+    {'8', U'ㄣ'}, {'9', U'ㄤ'}, {';', U'ㄝ'}, {'a', U'ㄚ'},
+    {'b', U'ㄅ'}, {'c', U'ㄘ'}, {'d', U'ㄉ'}, {'e', U'ㄜ'},
+    {'f', U'ㄈ'}, {'g', U'ㄍ'}, {'h', U'ㄏ'}, {'i', U'ㄟ'},
+    {'j', U'ㄐ'}, {'k', U'ㄎ'}, {'l', U'ㄌ'}, {'m', U'ㄇ'},
+    {'n', U'ㄋ'}, {'o', U'ㄛ'}, {'p', U'ㄆ'}, {'q', U'ㄑ'},
+    {'r', U'ㄖ'}, {'s', U'ㄙ'}, {'t', U'ㄊ'}, {'u', U'ㄡ'},
+    {'v', U'ㄩ'}, {'w', U'ㄨ'}, {'x', U'ㄒ'}, {'y', U'ㄧ'},
+    {'z', U'ㄗ'}, {' ', U' '}};
+inline static TEKKON_CONSTINIT LazyTable<std::map<std::string, std::string>>
+    mapQwertyMiTAC{[] { return buildKeyMap(_keysQwertyMiTAC); }};
+
+// MARK: - Dense ASCII Lookup Tables for Keyboard-to-Phonabet parsers
+
+/// 以下這些查詢表與上述 std::map 辭典同源，但以 ASCII 字碼為索引，
+/// 查詢時無須建立任何暫時字串。
+inline static constexpr auto _asciiQwertyDachen =
+    buildAsciiKeyTable(_keysQwertyDachen);
+inline static constexpr auto _asciiDachenCP26Static =
+    buildAsciiKeyTable(_keysDachenCP26Static);
+inline static constexpr auto _asciiHsuStatic =
+    buildAsciiKeyTable(_keysHsuStatic);
+inline static constexpr auto _asciiStarlightStatic =
+    buildAsciiKeyTable(_keysStarlightStatic);
+inline static constexpr auto _asciiETen26Static =
+    buildAsciiKeyTable(_keysETen26Static);
+inline static constexpr auto _asciiAlvinLiuStatic =
+    buildAsciiKeyTable(_keysAlvinLiuStatic);
+inline static constexpr auto _asciiQwertyETenTraditional =
+    buildAsciiKeyTable(_keysQwertyETenTraditional);
+inline static constexpr auto _asciiQwertyIBM =
+    buildAsciiKeyTable(_keysQwertyIBM);
+inline static constexpr auto _asciiSeigyou = buildAsciiKeyTable(_keysSeigyou);
+inline static constexpr auto _asciiFakeSeigyou =
+    buildAsciiKeyTable(_keysFakeSeigyou);
+inline static constexpr auto _asciiQwertyMiTAC =
+    buildAsciiKeyTable(_keysQwertyMiTAC);
+
+/// 取得指定注音排列的 ASCII 查詢表。
+///
+/// 對於動態注音排列而言，該表只包含其靜態按鍵部分。
+/// 拼音排列沒有查詢表，此時會回傳空指標。
+/// @param parser 注音排列。
+constexpr const std::array<char32_t, 128>* asciiKeyTable(
+    MandarinParser parser) {
+  switch (parser) {
+    case ofDachen:
+      return &_asciiQwertyDachen;
+    case ofDachen26:
+      return &_asciiDachenCP26Static;
+    case ofETen:
+      return &_asciiQwertyETenTraditional;
+    case ofETen26:
+      return &_asciiETen26Static;
+    case ofHsu:
+      return &_asciiHsuStatic;
+    case ofIBM:
+      return &_asciiQwertyIBM;
+    case ofMiTAC:
+      return &_asciiQwertyMiTAC;
+    case ofSeigyou:
+      return &_asciiSeigyou;
+    case ofFakeSeigyou:
+      return &_asciiFakeSeigyou;
+    case ofStarlight:
+      return &_asciiStarlightStatic;
+    case ofAlvinLiu:
+      return &_asciiAlvinLiuStatic;
+    default:
+      return nullptr;
+  }
+}
+
+/// 以 ASCII 查詢表翻譯單個按鍵，沒有對應時回傳 0。
+/// @param parser 注音排列。
+/// @param key 按鍵字元。
+constexpr char32_t lookupAsciiKey(MandarinParser parser, char key) {
+  const std::array<char32_t, 128>* table = asciiKeyTable(parser);
+  if (!table || static_cast<unsigned char>(key) >= 128) return 0;
+  return (*table)[static_cast<unsigned char>(key)];
+}
+
+/// 取得給定按鍵在指定注音排列的靜態按鍵部分所對應的注音；沒有對應時回傳空字串。
+/// @param parser 注音排列。
+/// @param key 按鍵字串，僅接受單個字元。
+inline static std::string staticKeyPhonabet(MandarinParser parser,
+                                            const std::string& key) {
+  if (key.size() != 1) return "";
+  return char32ToString(lookupAsciiKey(parser, key[0]));
+}
 
 /// 用以判定拼音鍵盤佈局的集合
-inline static std::vector<MandarinParser> arrPinyinParsers = {
+inline static constexpr std::array<MandarinParser, 6> arrPinyinParsers = {
     ofHanyuPinyin,  ofSecondaryPinyin, ofYalePinyin,
     ofHualuoPinyin, ofUniversalPinyin, ofWadeGilesPinyin};
 
@@ -1447,64 +1892,325 @@ inline static std::vector<MandarinParser> arrPinyinParsers = {
 
 // MARK: - Pre-built lookup for O(N) single-pass conversion.
 
-/// 從 arrPhonaToHanyuPinyin 預建的字串→拼音對照表。
-/// 因為原陣列已按長度降冪排列（多字元在前），建表後 longest-match-first
-/// 的語意由查表順序保證。
-inline static const std::map<std::string, std::string> _phonaToPinyinLUT = [] {
-  std::map<std::string, std::string> lut;
-  for (const auto& pair : arrPhonaToHanyuPinyin) {
-    if (pair.size() >= 2) {
-      lut[pair[0]] = pair[1];
+/// 從 arrPhonaToHanyuPinyin 預建的注音→拼音字首樹。
+///
+/// 各節點以「注音符號序號」直接索引子節點：ㄅ 至 ㄩ 依 Unicode 順序為 0-36，
+/// 其後依序是「 」「ˊ」「ˇ」「ˋ」「˙」。查詢時就地辨識 UTF-8 位元組，
+/// 無須切割字串；沿字首樹走到最深的有效節點，即為 longest-match-first。
+struct PhonaToPinyinTrie {
+  static constexpr size_t symbolCount = 42;
+
+  struct Node {
+    std::array<uint16_t, symbolCount> children{};
+    /// 該節點對應的拼音在 pinyinPool 當中的位置；不是任何鍵的結尾時長度為 0。
+    uint32_t pinyinOffset = 0;
+    uint16_t pinyinLength = 0;
+  };
+
+  std::vector<Node> nodes;
+  /// 所有拼音結果首尾相連存放於此。
+  std::string pinyinPool;
+
+  explicit PhonaToPinyinTrie(const StringPairTable& table) {
+    nodes.emplace_back();
+    for (const StringPair& pair : table) {
+      std::string_view key = pair.key;
+      uint16_t state = 0;
+      bool valid = !key.empty();
+      for (size_t i = 0; i < key.size() && valid;) {
+        size_t length = chunkLength(key.data() + i, key.size() - i);
+        int symbol = symbolOf(key.data() + i, length);
+        if (symbol < 0) {
+          valid = false;
+          break;
+        }
+        uint16_t& child = nodes[state].children[symbol];
+        if (!child) {
+          child = static_cast<uint16_t>(nodes.size());
+          nodes.emplace_back();
+        }
+        state = child;
+        i += length;
+      }
+      if (!valid) continue;
+      // 與舊版的 std::map 建表方式相同，重複的鍵以後者為準。
+      nodes[state].pinyinOffset = static_cast<uint32_t>(pinyinPool.size());
+      nodes[state].pinyinLength = static_cast<uint16_t>(pair.value.size());
+      pinyinPool += pair.value;
     }
   }
-  return lut;
-}();
 
-/// 已知最長的注音符號組合的字元長度（以 Unicode code point 計）。
-inline static const size_t _maxPhonaPatternLength = [] {
-  size_t maxVal = 3;
-  for (const auto& pair : arrPhonaToHanyuPinyin) {
-    if (pair.size() >= 1) {
-      size_t count = splitByCodepoint(pair[0]).size();
-      if (count > maxVal) maxVal = count;
+  /// 取得從 data 開始的單個 codepoint 的位元組長度。
+  ///
+  /// 與 splitByCodepoint 的切割方式相同，但不會超出字串結尾。
+  /// @param data 字串的當前位置。
+  /// @param remaining 剩餘的位元組數。
+  static size_t chunkLength(const char* data, size_t remaining) {
+    size_t length = utf8ByteCount(static_cast<unsigned char>(data[0]));
+    return std::min(length, remaining);
+  }
+
+  /// 取得單個 codepoint 的注音符號序號；不是注音符號的話則回傳 -1。
+  /// @param data 該 codepoint 的位元組。
+  /// @param length 該 codepoint 的位元組長度。
+  static int symbolOf(const char* data, size_t length) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    switch (length) {
+      case 1:
+        return bytes[0] == ' ' ? 37 : -1;
+      case 2:
+        if (bytes[0] != 0xCB) return -1;
+        switch (bytes[1]) {
+          case 0x8A:  // ˊ
+            return 38;
+          case 0x87:  // ˇ
+            return 39;
+          case 0x8B:  // ˋ
+            return 40;
+          case 0x99:  // ˙
+            return 41;
+          default:
+            return -1;
+        }
+      case 3:
+        // ㄅ（U+3105）至 ㄩ（U+3129）的 UTF-8 編碼皆為 E3 84 85-A9。
+        if (bytes[0] != 0xE3 || bytes[1] != 0x84) return -1;
+        if (bytes[2] < 0x85 || bytes[2] > 0xA9) return -1;
+        return bytes[2] - 0x85;
+      default:
+        return -1;
     }
   }
-  return maxVal;
-}();
+
+  /// 將注音轉為拼音，並將結果追加到 result 的末尾。
+  /// @param target 要轉換的注音。
+  /// @param result 用來接收結果的字串。
+  void convert(std::string_view target, std::string& result) const {
+    const char* data = target.data();
+    size_t size = target.size();
+    size_t i = 0;
+    while (i < size) {
+      const Node* matched = nullptr;
+      size_t matchedEnd = i;
+      uint16_t state = 0;
+      for (size_t j = i; j < size;) {
+        size_t length = chunkLength(data + j, size - j);
+        int symbol = symbolOf(data + j, length);
+        if (symbol < 0) break;
+        state = nodes[state].children[symbol];
+        if (!state) break;
+        j += length;
+        if (nodes[state].pinyinLength) {
+          matched = &nodes[state];
+          matchedEnd = j;
+        }
+      }
+      if (matched) {
+        result.append(pinyinPool, matched->pinyinOffset,
+                      matched->pinyinLength);
+        i = matchedEnd;
+      } else {
+        size_t length = chunkLength(data + i, size - i);
+        result.append(data + i, length);
+        i += length;
+      }
+    }
+  }
+};
+
+/// 以 arrPhonaToHanyuPinyin 預建的注音→拼音字首樹，首次使用時才會建立。
+inline static const PhonaToPinyinTrie& _phonaToPinyinTrie() {
+  static const PhonaToPinyinTrie instance(_phonaToHanyuPinyinTable.view());
+  return instance;
+}
+
+/// 注音轉拼音，要求陰平必須是空格。結果會追加到 result 的末尾。
+///
+/// 除了結果字串本身的增長以外，該函式不會配置任何記憶體。
+/// @param target 要轉換的注音。
+/// @param result 用來接收結果的字串。
+inline static void cnvPhonaToHanyuPinyin(std::string_view target,
+                                         std::string& result) {
+  _phonaToPinyinTrie().convert(target, result);
+}
 
 /// 注音轉拼音，要求陰平必須是空格。
 ///
 /// @param targetJoined 傳入的 String 對象物件。
 inline static std::string cnvPhonaToHanyuPinyin(std::string targetJoined = "") {
   if (targetJoined.empty()) return targetJoined;
-  auto codepoints = splitByCodepoint(targetJoined);
   std::string result;
   // pinyin output typically longer than zhuyin
   result.reserve(targetJoined.size() * 2);
+  cnvPhonaToHanyuPinyin(targetJoined, result);
+  return result;
+}
+
+// MARK: - Hanyu-Pinyin Textbook Style Rendering
+
+/// 從 arrHanyuPinyinTextbookStyleConversionTable 預建的「韻母＋聲調」對照表。
+///
+/// 該表的每個鍵都是「若干個小寫字母＋一個 1-5 的聲調數字」，所以只要在遇到
+/// 聲調數字時回頭比對前面的字母即可。各聲調的條目維持原表的先後順序，
+/// 故第一個比對成功的條目就是舊版逐條 replaceOccurrences 時會生效的那條。
+struct TextBookStyleTable {
+  struct Entry {
+    std::string letters;
+    std::string marked;
+    /// marked 是否以小寫字母結尾（如「ai1」的「āi」）。只有這種結果才可能
+    /// 與緊接其後的字母連成新的鍵、影響下一個聲調數字的比對。
+    bool endsWithLetter = false;
+  };
+
+  /// 依聲調（1-5）與最後一個字母分組的條目。
+  std::array<std::array<std::vector<Entry>, 26>, 5> entriesByToneAndFinal;
+  /// 原表若有不符合上述格式的條目，就只能逐條替換。
+  bool isUsable = true;
+
+  explicit TextBookStyleTable(const StringPairTable& table) {
+    for (const StringPair& pair : table) {
+      if (pair.key.size() < 2) {
+        isUsable = false;
+        continue;
+      }
+      std::string_view key = pair.key;
+      char tone = key.back();
+      std::string letters(key.substr(0, key.size() - 1));
+      bool lettersValid = std::all_of(letters.begin(), letters.end(),
+                                      [](char c) { return isLetter(c); });
+      if (tone < '1' || tone > '5' || !lettersValid) {
+        isUsable = false;
+        continue;
+      }
+      std::string marked(pair.value);
+      bool endsWithLetter = !marked.empty() && isLetter(marked.back());
+      entriesByToneAndFinal[tone - '1'][letters.back() - 'a'].push_back(
+          {std::move(letters), std::move(marked), endsWithLetter});
+    }
+  }
+
+  /// 聲調為 tone、且字母部分以 final 結尾的條目，維持原表的先後順序。
+  const std::vector<Entry>& candidates(char tone, char final) const {
+    return entriesByToneAndFinal[tone - '1'][final - 'a'];
+  }
+
+  static constexpr bool isLetter(char c) { return c >= 'a' && c <= 'z'; }
+  static constexpr bool isTone(char c) { return c >= '1' && c <= '5'; }
+};
+
+/// 以 arrHanyuPinyinTextbookStyleConversionTable 預建的「韻母＋聲調」對照表，
+/// 首次使用時才會建立。
+inline static const TextBookStyleTable& _textBookStyleTable() {
+  static const TextBookStyleTable instance(
+      _hanyuPinyinTextbookStyleTable.view());
+  return instance;
+}
+
+/// 逐條套用 arrHanyuPinyinTextbookStyleConversionTable 的舊版轉換方式。
+/// @param target 要轉換的內容，會被直接修改。
+inline static void _cnvHanyuPinyinToTextBookStyleByTable(std::string& target) {
+  for (const StringPair& pair : _hanyuPinyinTextbookStyleTable.view()) {
+    replaceOccurrences(target, std::string(pair.key), std::string(pair.value));
+  }
+}
+
+/// 漢語拼音數字標調式轉漢語拼音教科書格式，要求陰平必須是數字 1。
+/// 結果會追加到 result 的末尾，故可以分段處理很長的內容。
+///
+/// 轉換時只掃描一遍：對照表的鍵只由小寫字母與聲調數字構成，所以其餘字元都是
+/// 互不影響的分界。各段落內遇到聲調數字時，回頭比對前面的字母即可。
+///
+/// 舊版逐條替換時，前一個音節的結果若以字母結尾（如「āi」），就可能與其後的
+/// 字母連成較長的鍵（「ai1n2」會變成「āín」）。只有實際出現這種情形時，
+/// 才對該段落改用逐條替換，以確保結果與舊版一致。
+///
+/// @param target 要轉換的內容。
+/// @param result 用來接收結果的字串。
+inline static void cnvHanyuPinyinToTextBookStyle(std::string_view target,
+                                                 std::string& result) {
+  const TextBookStyleTable& table = _textBookStyleTable();
+  if (!table.isUsable) {
+    std::string strResult(target);
+    _cnvHanyuPinyinToTextBookStyleByTable(strResult);
+    result += strResult;
+    return;
+  }
   size_t i = 0;
-  size_t n = codepoints.size();
-  while (i < n) {
-    bool matched = false;
-    size_t remaining = n - i;
-    // Greedy longest-match first: try from max possible length down to 1.
-    size_t maxLen = std::min(_maxPhonaPatternLength, remaining);
-    for (size_t len = maxLen; len >= 1; len--) {
-      std::string key;
-      for (size_t k = i; k < i + len; k++) key += codepoints[k];
-      auto it = _phonaToPinyinLUT.find(key);
-      if (it != _phonaToPinyinLUT.end()) {
-        result += it->second;
-        i += len;
-        matched = true;
-        break;
-      }
-    }
-    if (!matched) {
-      result += codepoints[i];
+  while (i < target.size()) {
+    char c = target[i];
+    if (!TextBookStyleTable::isLetter(c) && !TextBookStyleTable::isTone(c)) {
+      result += c;
       i++;
+      continue;
+    }
+    // 逐一處理由小寫字母與聲調數字構成的段落。
+    size_t segmentStart = i;
+    size_t resultStart = result.size();
+    // 自上一個聲調數字（或段落開頭）以來的字母數。
+    size_t letters = 0;
+    bool previousEndsWithLetter = false;
+    bool needsFallback = false;
+    for (; i < target.size(); i++) {
+      char d = target[i];
+      if (TextBookStyleTable::isLetter(d)) {
+        result += d;
+        letters++;
+        continue;
+      }
+      if (!TextBookStyleTable::isTone(d)) break;
+      if (result.size() == resultStart ||
+          !TextBookStyleTable::isLetter(result.back())) {
+        result += d;
+        previousEndsWithLetter = false;
+        letters = 0;
+        continue;
+      }
+      const auto& entries = table.candidates(d, result.back());
+      // 前一個結果以字母結尾時，檢查是否有更長的鍵會跨進該結果裡。
+      if (previousEndsWithLetter) {
+        for (const auto& entry : entries) {
+          size_t length = entry.letters.size();
+          if (length > letters && length <= result.size() - resultStart &&
+              result.compare(result.size() - length, length, entry.letters) ==
+                  0) {
+            needsFallback = true;
+            break;
+          }
+        }
+        if (needsFallback) break;
+      }
+      const TextBookStyleTable::Entry* matched = nullptr;
+      for (const auto& entry : entries) {
+        size_t length = entry.letters.size();
+        if (length > letters) continue;
+        if (target.compare(i - length, length, entry.letters) != 0) continue;
+        matched = &entry;
+        break;
+      }
+      if (matched) {
+        result.resize(result.size() - matched->letters.size());
+        result += matched->marked;
+      } else {
+        result += d;
+      }
+      previousEndsWithLetter = matched && matched->endsWithLetter;
+      letters = 0;
+    }
+    if (needsFallback) {
+      size_t segmentEnd = i;
+      while (segmentEnd < target.size() &&
+             (TextBookStyleTable::isLetter(target[segmentEnd]) ||
+              TextBookStyleTable::isTone(target[segmentEnd]))) {
+        segmentEnd++;
+      }
+      std::string segment(
+          target.substr(segmentStart, segmentEnd - segmentStart));
+      _cnvHanyuPinyinToTextBookStyleByTable(segment);
+      result.resize(resultStart);
+      result += segment;
+      i = segmentEnd;
     }
   }
-  return result;
 }
 
 /// 漢語拼音數字標調式轉漢語拼音教科書格式，要求陰平必須是數字 1。
@@ -1512,11 +2218,9 @@ inline static std::string cnvPhonaToHanyuPinyin(std::string targetJoined = "") {
 /// @param targetJoined 傳入的 String 對象物件。
 inline static std::string cnvHanyuPinyinToTextBookStyle(
     std::string targetJoined) {
-  std::string strResult = std::move(targetJoined);
-  for (std::vector<std::string> i :
-       arrHanyuPinyinTextbookStyleConversionTable) {
-    replaceOccurrences(strResult, i[0], i[1]);
-  }
+  std::string strResult;
+  strResult.reserve(targetJoined.size() * 2);
+  cnvHanyuPinyinToTextBookStyle(targetJoined, strResult);
   return strResult;
 }
 
@@ -1547,6 +2251,246 @@ inline static std::string restoreToneOneInPhona(std::string target) {
   return result;
 }
 
+// MARK: - Hanyu-Pinyin to Phonabet Conversion Automaton
+
+/// 漢語拼音轉注音用的 Aho–Corasick 自動機，以 mapHanyuPinyin 的所有鍵建成。
+///
+/// 舊版的做法是將所有鍵按長度降冪排序後、逐一對整個字串做 replaceOccurrences，
+/// 所以較長的鍵永遠優先，同樣長度的鍵則以排序後的先後為準。這裡沿用同樣的排序
+/// 結果作為各鍵的優先序：先以單次線性掃描找出所有匹配，再按優先序決定哪些匹配
+/// 生效，故轉換結果與舊版逐位元組一致。
+struct HanyuPinyinAutomaton {
+  /// 自動機的節點。goto 函式已預先展開成完整的轉移表。
+  struct Node {
+    std::array<uint16_t, 26> next{};
+    /// 沿 fail 鏈往上、最近的一個本身即為某鍵結尾的節點；0 表示沒有。
+    uint16_t dictLink = 0;
+    /// 若該節點為某鍵的結尾，則為該鍵的優先序；否則為 -1。
+    int16_t keyIndex = -1;
+  };
+
+  std::vector<Node> nodes;
+  /// 按優先序排列的各鍵及其注音。
+  std::vector<std::string> keys, values;
+  /// 最長的鍵的長度。
+  size_t maxKeySize = 0;
+
+  explicit HanyuPinyinAutomaton(const StringPairTable& dictionary) {
+    // 與舊版相同，先按 std::map 的順序（即鍵的位元組順序）列出各鍵。
+    for (size_t i = 0; i < dictionary.size(); i++)
+      keys.emplace_back(dictionary.sortedAt(i).key);
+    // 這裡的排序方式必須與舊版完全相同，才能得到相同的優先序。
+    std::sort(keys.begin(), keys.end(),
+              [](const std::string& first, const std::string& second) {
+                return first.size() > second.size();
+              });
+    nodes.emplace_back();
+    for (size_t k = 0; k < keys.size(); k++) {
+      values.emplace_back(*dictionary.find(keys[k]));
+      maxKeySize = std::max(maxKeySize, keys[k].size());
+      uint16_t state = 0;
+      for (char c : keys[k]) {
+        uint16_t& child = nodes[state].next[c - 'a'];
+        if (!child) {
+          child = static_cast<uint16_t>(nodes.size());
+          nodes.emplace_back();
+        }
+        state = child;
+      }
+      nodes[state].keyIndex = static_cast<int16_t>(k);
+    }
+    // 以廣度優先的順序補齊 fail 轉移與 dictLink。
+    std::vector<uint16_t> fail(nodes.size(), 0);
+    std::vector<uint16_t> queue;
+    for (uint16_t child : nodes[0].next)
+      if (child) queue.push_back(child);
+    for (size_t head = 0; head < queue.size(); head++) {
+      uint16_t state = queue[head];
+      uint16_t failState = fail[state];
+      nodes[state].dictLink = nodes[failState].keyIndex >= 0
+                                  ? failState
+                                  : nodes[failState].dictLink;
+      for (size_t c = 0; c < 26; c++) {
+        uint16_t& child = nodes[state].next[c];
+        if (child) {
+          fail[child] = nodes[failState].next[c];
+          queue.push_back(child);
+        } else {
+          child = nodes[failState].next[c];
+        }
+      }
+    }
+  }
+
+  /// 找出 input 當中實際會被換成注音的拼音鍵，並由左至右逐一交給 emit。
+  ///
+  /// 匹配只會落在連續的小寫字母之內，故逐段處理：每段先以單次掃描列出所有
+  /// 匹配（依結尾位置排序），再判斷各匹配是否生效。舊版逐鍵套用的效果等同於
+  /// 「與其重疊、且優先序更高的匹配都沒有生效時，該匹配才生效」，而重疊的匹配
+  /// 必定落在前後各一個鍵長的範圍內，故可以直接遞迴判定，不必先排序。
+  ///
+  /// @param input 輸入字串。
+  /// @param emit 以 (起始位置, 鍵的優先序) 呼叫，起始位置由小到大。
+  template <typename Emit>
+  void resolve(std::string_view input, Emit&& emit) const {
+    struct Match {
+      uint32_t start;
+      uint32_t end;
+      int16_t keyIndex;
+      /// 0：尚未判定；1：生效；2：被更優先的匹配蓋掉。
+      uint8_t verdict;
+    };
+    // 絕大多數的字母段都放得進這裡；更長的段才改用 spilled。
+    std::array<Match, 64> inlineMatches;
+    std::vector<Match> spilled;
+    size_t count = 0;
+    auto push = [&](const Match& match) {
+      if (count < inlineMatches.size() && spilled.empty()) {
+        inlineMatches[count++] = match;
+        return;
+      }
+      if (spilled.empty()) {
+        spilled.assign(inlineMatches.begin(), inlineMatches.end());
+      }
+      spilled.push_back(match);
+      count++;
+    };
+    auto flush = [&] {
+      Match* matches = spilled.empty() ? inlineMatches.data() : spilled.data();
+      // 優先序：鍵的優先序較小者優先；同一個鍵則是較靠左者優先。
+      auto precedes = [](const Match& lhs, const Match& rhs) {
+        return lhs.keyIndex != rhs.keyIndex ? lhs.keyIndex < rhs.keyIndex
+                                            : lhs.start < rhs.start;
+      };
+      auto applies = [&](auto& self, size_t m) -> bool {
+        Match& match = matches[m];
+        if (match.verdict) return match.verdict == 1;
+        bool blocked = false;
+        for (size_t j = m; j-- > 0 && matches[j].end > match.start;) {
+          if (precedes(matches[j], match) && self(self, j)) blocked = true;
+          if (blocked) break;
+        }
+        for (size_t j = m + 1;
+             !blocked && j < count && matches[j].end < match.end + maxKeySize;
+             j++) {
+          if (matches[j].start < match.end && precedes(matches[j], match) &&
+              self(self, j)) {
+            blocked = true;
+          }
+        }
+        match.verdict = blocked ? 2 : 1;
+        return !blocked;
+      };
+      // 生效的匹配互不重疊，故依結尾排序即是依起始位置排序。
+      for (size_t m = 0; m < count; m++) {
+        if (applies(applies, m)) emit(matches[m].start, matches[m].keyIndex);
+      }
+      count = 0;
+      spilled.clear();
+    };
+    uint16_t state = 0;
+    for (size_t i = 0; i < input.size(); i++) {
+      char c = input[i];
+      if (c < 'a' || c > 'z') {
+        if (count) flush();
+        state = 0;
+        continue;
+      }
+      state = nodes[state].next[c - 'a'];
+      uint16_t node =
+          nodes[state].keyIndex >= 0 ? state : nodes[state].dictLink;
+      for (; node; node = nodes[node].dictLink) {
+        int16_t keyIndex = nodes[node].keyIndex;
+        auto end = static_cast<uint32_t>(i + 1);
+        push({end - static_cast<uint32_t>(keys[keyIndex].size()), end,
+              keyIndex, 0});
+      }
+    }
+    if (count) flush();
+  }
+};
+
+/// 以 mapHanyuPinyin 預建的漢語拼音轉注音自動機，首次使用時才會建立。
+inline static const HanyuPinyinAutomaton& _hanyuPinyinAutomaton() {
+  static const HanyuPinyinAutomaton instance(_hanyuPinyinTable.view());
+  return instance;
+}
+
+/// 各聲調鍵（皆為單個字元）按舊版的套用順序逐輪替換之後的結果。
+struct HanyuPinyinToneRendering {
+  /// 按舊版的套用順序排列的聲調鍵。
+  std::vector<std::string> keys;
+  /// 以聲調鍵的字元碼為索引；陰平以空字串為標記。
+  std::array<std::string, 128> rendered;
+  std::array<bool, 128> isToneKey{};
+
+  HanyuPinyinToneRendering() {
+    const StringPairTable table = _arayuruPinyinIntonationTable.view();
+    for (size_t i = 0; i < table.size(); i++)
+      keys.emplace_back(table.sortedAt(i).key);
+    std::sort(keys.begin(), keys.end(),
+              [](const std::string& first, const std::string& second) {
+                return first.size() > second.size();
+              });
+    for (size_t r = 0; r < keys.size(); r++) {
+      unsigned char code = static_cast<unsigned char>(keys[r][0]);
+      rendered[code] = _renderFrom(r, _toneOf(keys[r], ""));
+      isToneKey[code] = true;
+    }
+  }
+
+  /// 以 newToneOne 作為陰平標記時，陰平一項的結果。
+  ///
+  /// 其他各項都是聲調符號、不含任何數字，替換時不會再生出「1」，
+  /// 故只有陰平一項會受 newToneOne 影響。
+  std::string renderToneOne(const std::string& newToneOne) const {
+    for (size_t r = 0; r < keys.size(); r++) {
+      if (keys[r] == "1") return _renderFrom(r, newToneOne);
+    }
+    return newToneOne;
+  }
+
+ private:
+  static std::string _toneOf(const std::string& key,
+                             const std::string& newToneOne) {
+    if (key == "1") return newToneOne;
+    return std::string(*_arayuruPinyinIntonationTable.view().find(key));
+  }
+
+  /// 將第 r 個聲調鍵換成 rendered 之後，再依序套用其後各鍵的替換。
+  std::string _renderFrom(size_t r, std::string rendered) const {
+    for (size_t later = r + 1; later < keys.size(); later++) {
+      replaceOccurrences(rendered, keys[later], _toneOf(keys[later], ""));
+    }
+    return rendered;
+  }
+};
+
+/// 預設（陰平不加標記）的聲調鍵替換結果，首次使用時才會建立。
+inline static const HanyuPinyinToneRendering& _hanyuPinyinToneRendering() {
+  static const HanyuPinyinToneRendering instance;
+  return instance;
+}
+
+/// 判斷字串是否可以交給 cnvHanyuPinyinToPhona 轉換。
+///
+/// 含底線的話一律不可轉換。除此之外，與舊版的正規表達式
+/// 「.*[^A-Za-z0-9 \t-].*」判定結果一致：因為「.」不匹配換行符號（\n 與
+/// \r），所以僅在換行符號不超過一個時，才會因為不允許的字元而放棄轉換。
+/// @param target 要檢查的字串。
+inline static bool isConvertibleHanyuPinyin(const std::string& target) {
+  size_t lineBreaks = 0;
+  bool hasDisallowed = false;
+  for (char c : target) {
+    if (c == '_') return false;
+    if (c == '\n' || c == '\r') lineBreaks++;
+    bool allowed = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+                   (c >= '0' && c <= '9') || c == ' ' || c == '\t' || c == '-';
+    if (!allowed) hasDisallowed = true;
+  }
+  return !(hasDisallowed && lineBreaks <= 1);
+}
+
 /// 該函式用來將漢語拼音轉為注音。
 /// @param targetJoined 要轉換的漢語拼音內容，要求必須帶有 12345 數字標調。
 /// @param newToneOne 對陰平指定新的標記。預設情況下該標記為空字串。
@@ -1554,35 +2498,38 @@ inline static std::string restoreToneOneInPhona(std::string target) {
 inline static std::string cnvHanyuPinyinToPhona(std::string targetJoined = "",
                                                 std::string newToneOne = "") {
   // 允許的字元：英數 (A-Za-z0-9)、空白、Tab、連字號(-)。
-  std::regex str_reg(".*[^A-Za-z0-9 \\t-].*");
-  std::smatch matchResult;
   // 如果含底線或包含任何不在允許列表中的字元，則放棄轉換。
-  if (stringInclusion(targetJoined, "_") ||
-      std::regex_match(targetJoined, matchResult, str_reg))
-    return targetJoined;
-  std::string strResult = std::move(targetJoined);
-  std::vector<std::string> keyListHYPY;
-  for (auto const& i : mapHanyuPinyin) keyListHYPY.push_back(i.first);
-  std::sort(keyListHYPY.begin(), keyListHYPY.end(),
-            [](const std::string& first, const std::string& second) {
-              return first.size() > second.size();
-            });
-
-  std::vector<std::string> keyListIntonation;
-  for (auto const& i : mapArayuruPinyinIntonation)
-    keyListIntonation.push_back(i.first);
-  std::sort(keyListIntonation.begin(), keyListIntonation.end(),
-            [](const std::string& first, const std::string& second) {
-              return first.size() > second.size();
-            });
-
-  for (auto i : keyListHYPY) {
-    replaceOccurrences(strResult, i, mapHanyuPinyin[i]);
-  }
-  for (auto i : keyListIntonation) {
-    replaceOccurrences(strResult, i,
-                       i == "1" ? newToneOne : mapArayuruPinyinIntonation[i]);
-  }
+  if (!isConvertibleHanyuPinyin(targetJoined)) return targetJoined;
+
+  // 聲調鍵都是單個字元，各自經過後續各輪替換之後的結果已事先算好。
+  // 只有陰平那一項取決於 newToneOne，故僅在指定了其他標記時另外算一次。
+  const HanyuPinyinToneRendering& tones = _hanyuPinyinToneRendering();
+  std::string customToneOne;
+  bool hasCustomToneOne = !newToneOne.empty();
+  if (hasCustomToneOne) customToneOne = tones.renderToneOne(newToneOne);
+
+  const HanyuPinyinAutomaton& automaton = _hanyuPinyinAutomaton();
+  std::string strResult;
+  strResult.reserve(targetJoined.size() * 2);
+  auto appendVerbatim = [&](size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+      unsigned char code = static_cast<unsigned char>(targetJoined[i]);
+      if (code >= 128 || !tones.isToneKey[code]) {
+        strResult += targetJoined[i];
+      } else if (code == '1' && hasCustomToneOne) {
+        strResult += customToneOne;
+      } else {
+        strResult += tones.rendered[code];
+      }
+    }
+  };
+  size_t copied = 0;
+  automaton.resolve(targetJoined, [&](size_t start, int16_t keyIndex) {
+    appendVerbatim(copied, start);
+    strResult += automaton.values[keyIndex];
+    copied = start + automaton.keys[keyIndex].size();
+  });
+  appendVerbatim(copied, targetJoined.size());
   return strResult;
 }
 
@@ -1590,6 +2537,51 @@ inline static std::string cnvHanyuPinyinToPhona(std::string targetJoined = "",
 // ======================== REAL THINGS BEGIN HERE ========================
 // ========================================================================
 
+// MARK: - Phonabet Classification
+
+/// 注音符號的分類結果：所屬類型、以及在該類型當中的索引（從 1 開始）。
+struct PhonabetClass {
+  PhoneType type = null;
+  uint8_t index = 0;
+};
+
+/// 注音區塊（U+3105–U+312F）的起點與長度。
+inline static constexpr char32_t _bopomofoBlockBegin = 0x3105;
+inline static constexpr size_t _bopomofoBlockLength = 0x312F - 0x3105 + 1;
+
+/// 以注音區塊內的碼位偏移量為索引的分類表，於編譯期從 allowedConsonants、
+/// allowedSemivowels、allowedVowels 生成，索引即符號在該陣列內的位置加一。
+/// 區塊內不被引擎接受的符號（例如ㄪㄫㄬ）會被分類為 null。
+inline static constexpr auto _bopomofoClassTable = [] {
+  std::array<PhonabetClass, _bopomofoBlockLength> table{};
+  auto fill = [&table](const auto& scalars, PhoneType type) {
+    for (size_t i = 0; i < scalars.size(); i++) {
+      PhonabetClass& entry = table[scalars[i] - _bopomofoBlockBegin];
+      entry.type = type;
+      entry.index = static_cast<uint8_t>(i + 1);
+    }
+  };
+  fill(allowedConsonants, PhoneType::consonant);
+  fill(allowedSemivowels, PhoneType::semivowel);
+  fill(allowedVowels, PhoneType::vowel);
+  return table;
+}();
+
+/// 以 O(1) 的代價判定給定的 Unicode scalar 屬於哪一類注音符號。
+/// 整個過程不涉及任何記憶體配置。
+/// @param scalar 要判定的 Unicode scalar。
+constexpr PhonabetClass classifyPhonabet(char32_t scalar) {
+  if (scalar >= _bopomofoBlockBegin &&
+      scalar < _bopomofoBlockBegin + _bopomofoBlockLength)
+    return _bopomofoClassTable[scalar - _bopomofoBlockBegin];
+  // 聲調符號散落在注音區塊之外，僅五個，逐一比對即可。
+  for (size_t i = 0; i < allowedIntonations.size(); i++) {
+    if (allowedIntonations[i] == scalar)
+      return {PhoneType::intonation, static_cast<uint8_t>(i + 1)};
+  }
+  return {};
+}
+
 // MARK: - Phonabet Structure
 
 /// 注音符號型別。本身與字串差不多，但卻只能被設定成一個注音符號字元。
@@ -1613,32 +2605,30 @@ struct Phonabet {
   /// 取得 Unicode scalar 值
   char32_t scalar() { return scalarValue; }
 
+  /// 取得在所屬類型當中的索引（從 1 開始，0 表示空），即 PackedReading
+  /// 對應槽位的值。
+  uint8_t index() const { return indexValue; }
+
   ~Phonabet() { clear(); }
 
   /// 初期化，會根據傳入的 input 字串參數來自動判定自身的 PhoneType 類型屬性值。
   explicit Phonabet(std::string input = "") {
     if (!input.empty()) {
-      auto chars = splitByCodepoint(input);
-      if (!chars.empty()) {
-        // Convert first codepoint to char32_t
-        std::string firstChar = chars[0];
-        if (firstChar.size() > 0) {
-          // Simple UTF-8 to char32_t conversion
-          const unsigned char* bytes =
-              reinterpret_cast<const unsigned char*>(firstChar.c_str());
-          if ((bytes[0] & 0x80) == 0) {
-            scalarValue = bytes[0];
-          } else if ((bytes[0] & 0xE0) == 0xC0 && firstChar.size() >= 2) {
-            scalarValue = ((bytes[0] & 0x1F) << 6) | (bytes[1] & 0x3F);
-          } else if ((bytes[0] & 0xF0) == 0xE0 && firstChar.size() >= 3) {
-            scalarValue = ((bytes[0] & 0x0F) << 12) | ((bytes[1] & 0x3F) << 6) |
-                          (bytes[2] & 0x3F);
-          } else if ((bytes[0] & 0xF8) == 0xF0 && firstChar.size() >= 4) {
-            scalarValue = ((bytes[0] & 0x07) << 18) |
-                          ((bytes[1] & 0x3F) << 12) | ((bytes[2] & 0x3F) << 6) |
-                          (bytes[3] & 0x3F);
-          }
-        }
+      // 就地解碼第一個 codepoint，不做任何字串切割。
+      size_t firstCharSize = std::min<size_t>(
+          utf8ByteCount(static_cast<unsigned char>(input[0])), input.size());
+      const unsigned char* bytes =
+          reinterpret_cast<const unsigned char*>(input.data());
+      if ((bytes[0] & 0x80) == 0) {
+        scalarValue = bytes[0];
+      } else if ((bytes[0] & 0xE0) == 0xC0 && firstCharSize >= 2) {
+        scalarValue = ((bytes[0] & 0x1F) << 6) | (bytes[1] & 0x3F);
+      } else if ((bytes[0] & 0xF0) == 0xE0 && firstCharSize >= 3) {
+        scalarValue = ((bytes[0] & 0x0F) << 12) | ((bytes[1] & 0x3F) << 6) |
+                      (bytes[2] & 0x3F);
+      } else if ((bytes[0] & 0xF8) == 0xF0 && firstCharSize >= 4) {
+        scalarValue = ((bytes[0] & 0x07) << 18) | ((bytes[1] & 0x3F) << 12) |
+                      ((bytes[2] & 0x3F) << 6) | (bytes[3] & 0x3F);
       }
     }
     ensureType();
@@ -1647,9 +2637,7 @@ struct Phonabet {
   /// 初期化，會根據傳入的 Unicode scalar 來自動判定自身的 PhoneType
   /// 類型屬性值。
   explicit Phonabet(char32_t input) {
-    if (contains(allowedPhonabets, input)) {
-      scalarValue = input;
-    }
+    scalarValue = input;
     ensureType();
   }
 
@@ -1657,6 +2645,7 @@ struct Phonabet {
   void clear() {
     scalarValue = U'~';
     type = null;
+    indexValue = 0;
   };
 
   /// 自我變換資料值。
@@ -1679,41 +2668,2034 @@ struct Phonabet {
 
  protected:
   char32_t scalarValue = U'~';
+  uint8_t indexValue = 0;
 
-  /// 判定自身的 PhoneType 類型屬性值。
+  /// 判定自身的 PhoneType 類型屬性值與索引（查表，O(1)）。
   void ensureType() {
-    if (contains(allowedConsonants, scalarValue)) {
-      type = consonant;
-    } else if (contains(allowedSemivowels, scalarValue)) {
-      type = semivowel;
-    } else if (contains(allowedVowels, scalarValue)) {
-      type = vowel;
-    } else if (contains(allowedIntonations, scalarValue)) {
-      type = intonation;
-    } else {
-      type = null;
-      scalarValue = U'~';
-    }
+    PhonabetClass phoneClass = classifyPhonabet(scalarValue);
+    type = phoneClass.type;
+    indexValue = phoneClass.index;
+    if (type == null) scalarValue = U'~';
   }
 };
 
-// MARK: - Composer
+// MARK: - PackedReading
 
-class Composer {
+/// 將聲介韻調四個槽位壓縮到單個 uint16_t 的讀音表示。
+///
+/// 位元配置（由低至高）：
+/// - bit 0-4：聲母索引（1-21，0 表示空）
+/// - bit 5-6：介母索引（1-3，0 表示空）
+/// - bit 7-10：韻母索引（1-13，0 表示空）
+/// - bit 11-13：聲調索引（1-5，依序為「 」「ˊ」「ˇ」「ˋ」「˙」，0 表示空）
+///
+/// 各索引的順序與 allowedConsonants 等陣列的順序一致。
+/// 該型別可被任意複製與比較，適合拿來當作注拼槽的快照。
+struct PackedReading {
  public:
-  // 聲介韻調。寫這樣囉唆是為了直接在這裡初期化。
-  // 注意：這些為公開唯讀，不應直接修改。
-  // 使用 receiveKey()、receiveSequence() 或 clear() 來修改組字器狀態。
-  Phonabet consonant = Phonabet(), semivowel = Phonabet(), vowel = Phonabet(),
-           intonation = Phonabet();
+  uint16_t raw = 0;
 
-  /// 為拉丁字母專用的組音區。
-  /// 注意：此為公開唯讀，不應直接修改。
-  std::string romajiBuffer;
+  static constexpr uint16_t consonantMask = 0x001F;
+  static constexpr uint16_t semivowelMask = 0x0060;
+  static constexpr uint16_t vowelMask = 0x0780;
+  static constexpr uint16_t intonationMask = 0x3800;
 
-  /// 注音排列種類。預設情況下是大千排列（Windows / macOS 預設注音排列）。
-  /// 注意：此為公開唯讀。使用 ensureParser() 來變更解析器。
-  MandarinParser parser = ofDachen;
+  constexpr PackedReading() = default;
+  constexpr explicit PackedReading(uint16_t rawValue) : raw(rawValue) {}
+
+  /// 取得指定類型的注音符號在該類型當中的索引（從 1 開始）。
+  /// 若該符號不屬於該類型，則回傳 0。
+  static constexpr uint8_t indexOf(PhoneType type, char32_t scalar) {
+    PhonabetClass phoneClass = classifyPhonabet(scalar);
+    return phoneClass.type == type ? phoneClass.index : 0;
+  }
+
+  /// 取得指定類型當中給定索引（從 1 開始）所對應的注音符號。
+  /// 索引無效時回傳 0。
+  static constexpr char32_t scalarOf(PhoneType type, uint8_t index) {
+    if (index == 0 || index > tableLength(type)) return 0;
+    return scalarTable(type)[index - 1];
+  }
+
+  /// 取得注音符號所屬的類型。
+  static constexpr PhoneType typeOf(char32_t scalar) {
+    return classifyPhonabet(scalar).type;
+  }
+
+  constexpr uint8_t consonantIndex() const { return raw & consonantMask; }
+  constexpr uint8_t semivowelIndex() const {
+    return (raw & semivowelMask) >> 5;
+  }
+  constexpr uint8_t vowelIndex() const { return (raw & vowelMask) >> 7; }
+  constexpr uint8_t intonationIndex() const {
+    return (raw & intonationMask) >> 11;
+  }
+
+  /// 取得指定槽位的索引（從 1 開始，0 表示空）。
+  constexpr uint8_t indexAt(PhoneType type) const {
+    switch (type) {
+      case PhoneType::consonant:
+        return consonantIndex();
+      case PhoneType::semivowel:
+        return semivowelIndex();
+      case PhoneType::vowel:
+        return vowelIndex();
+      case PhoneType::intonation:
+        return intonationIndex();
+      default:
+        return 0;
+    }
+  }
+
+  /// 取得指定槽位的注音符號（Unicode scalar）；槽位為空時回傳 0。
+  constexpr char32_t scalarAt(PhoneType type) const {
+    return scalarOf(type, indexAt(type));
+  }
+
+  constexpr char32_t consonant() const {
+    return scalarAt(PhoneType::consonant);
+  }
+  constexpr char32_t semivowel() const {
+    return scalarAt(PhoneType::semivowel);
+  }
+  constexpr char32_t vowel() const { return scalarAt(PhoneType::vowel); }
+  constexpr char32_t intonation() const {
+    return scalarAt(PhoneType::intonation);
+  }
+
+  /// 將給定的注音符號寫入其所屬的槽位，回傳新的讀音。
+  /// 若給定的內容不是注音符號，則原樣回傳。
+  constexpr PackedReading with(char32_t phonabet) const {
+    PhonabetClass phoneClass = classifyPhonabet(phonabet);
+    if (phoneClass.type == null) return *this;
+    return withIndex(phoneClass.type, phoneClass.index);
+  }
+
+  /// 將指定槽位設為給定的索引（0 表示清空），回傳新的讀音。
+  constexpr PackedReading withIndex(PhoneType type, uint8_t index) const {
+    switch (type) {
+      case PhoneType::consonant:
+        return PackedReading(
+            static_cast<uint16_t>((raw & ~consonantMask) | index));
+      case PhoneType::semivowel:
+        return PackedReading(
+            static_cast<uint16_t>((raw & ~semivowelMask) | (index << 5)));
+      case PhoneType::vowel:
+        return PackedReading(
+            static_cast<uint16_t>((raw & ~vowelMask) | (index << 7)));
+      case PhoneType::intonation:
+        return PackedReading(
+            static_cast<uint16_t>((raw & ~intonationMask) | (index << 11)));
+      default:
+        return *this;
+    }
+  }
+
+  /// 清空指定槽位，回傳新的讀音。
+  constexpr PackedReading without(PhoneType type) const {
+    return withIndex(type, 0);
+  }
+
+  /// 讀音是否為空。
+  constexpr bool isEmpty() const { return raw == 0; }
+
+  /// 讀音是否可唸（聲介韻當中至少有一個非空）。
+  constexpr bool isPronounceable() const {
+    return (raw & (consonantMask | semivowelMask | vowelMask)) != 0;
+  }
+
+  /// 讀音序號的總數（含代表空讀音的 0）。
+  static constexpr uint16_t readingIDCount = 22 * 4 * 14 * 5;
+
+  /// 將讀音換算成緊湊的讀音序號，可拿來取代注音字串作為辭典的索引鍵。
+  ///
+  /// 序號是聲、介、韻、調各自的索引的混合進位制數值（依序為 22、4、14、5
+  /// 進位），各索引的順序即 allowedConsonants 等陣列的順序，故序號在各版本
+  /// 之間保持不變。陰平與無聲調視為相同（與 Composer::getComposition()
+  /// 的結果一致），空讀音的序號為 0。
+  constexpr uint16_t readingID() const {
+    uint8_t tone = intonationIndex();
+    return static_cast<uint16_t>(
+        ((consonantIndex() * 4 + semivowelIndex()) * 14 + vowelIndex()) * 5 +
+        (tone > 1 ? tone - 1 : 0));
+  }
+
+  /// 將讀音序號換算回讀音；陰平會被還原成無聲調。
+  static constexpr PackedReading fromReadingID(uint16_t id) {
+    if (id >= readingIDCount) return PackedReading();
+    uint8_t tone = id % 5;
+    return PackedReading()
+        .withIndex(PhoneType::intonation, tone ? tone + 1 : 0)
+        .withIndex(PhoneType::vowel, (id / 5) % 14)
+        .withIndex(PhoneType::semivowel, (id / 70) % 4)
+        .withIndex(PhoneType::consonant, id / 280);
+  }
+
+  /// 讀音（不計聲調）是否為實際存在的國語音節，例如「ㄓㄨㄤ」是、「ㄅㄩ」不是。
+  /// 查詢的代價是一次位元集合的存取。
+  constexpr bool isValidSyllable() const;
+
+  /// 統計有效的聲介韻（調）個數。
+  ///
+  /// @param withIntonation 是否統計聲調。
+  constexpr int count(bool withIntonation = false) const {
+    int result = (withIntonation && intonationIndex()) ? 1 : 0;
+    result += consonantIndex() ? 1 : 0;
+    result += semivowelIndex() ? 1 : 0;
+    result += vowelIndex() ? 1 : 0;
+    return result;
+  }
+
+  /// 用來檢測是否有調號的函式，預設情況下不判定聲調以外的內容的存無。
+  ///
+  /// @param withNothingElse 追加判定「槽內是否僅有調號」。
+  constexpr bool hasIntonation(bool withNothingElse = false) const {
+    if (!intonationIndex()) return false;
+    return !withNothingElse || !isPronounceable();
+  }
+
+  /// 取得字串表示的值（與 Composer::value() 格式一致，陰平為空格）。
+  std::string value() const {
+    std::string result;
+    result.reserve(12);
+    for (int i = PhoneType::consonant; i <= PhoneType::intonation; i++) {
+      char32_t scalar = scalarAt(static_cast<PhoneType>(i));
+      if (scalar) result += char32ToString(scalar);
+    }
+    return result;
+  }
+
+  /// 從注音字串（例如 Composer::value() 的結果）解析出讀音。
+  /// 不是注音符號的字元會被略過；同一槽位出現多次時，以後者為準。
+  static constexpr PackedReading fromString(std::string_view zhuyin) {
+    PackedReading result;
+    size_t i = 0;
+    while (i < zhuyin.size()) {
+      unsigned char lead = static_cast<unsigned char>(zhuyin[i]);
+      size_t count = utf8ByteCount(lead);
+      if (i + count > zhuyin.size()) break;
+      char32_t scalar = 0;
+      switch (count) {
+        case 1:
+          scalar = lead;
+          break;
+        case 2:
+          scalar = ((lead & 0x1F) << 6) | (zhuyin[i + 1] & 0x3F);
+          break;
+        case 3:
+          scalar = ((lead & 0x0F) << 12) | ((zhuyin[i + 1] & 0x3F) << 6) |
+                   (zhuyin[i + 2] & 0x3F);
+          break;
+        default:
+          scalar = ((lead & 0x07) << 18) | ((zhuyin[i + 1] & 0x3F) << 12) |
+                   ((zhuyin[i + 2] & 0x3F) << 6) | (zhuyin[i + 3] & 0x3F);
+          break;
+      }
+      result = result.with(scalar);
+      i += count;
+    }
+    return result;
+  }
+
+  constexpr bool operator==(const PackedReading& rhs) const {
+    return raw == rhs.raw;
+  }
+  constexpr bool operator!=(const PackedReading& rhs) const {
+    return raw != rhs.raw;
+  }
+  constexpr bool operator<(const PackedReading& rhs) const {
+    return raw < rhs.raw;
+  }
+
+ private:
+  static constexpr const char32_t* scalarTable(PhoneType type) {
+    switch (type) {
+      case PhoneType::consonant:
+        return allowedConsonants.data();
+      case PhoneType::semivowel:
+        return allowedSemivowels.data();
+      case PhoneType::vowel:
+        return allowedVowels.data();
+      case PhoneType::intonation:
+        return allowedIntonations.data();
+      default:
+        return nullptr;
+    }
+  }
+
+  static constexpr uint8_t tableLength(PhoneType type) {
+    switch (type) {
+      case PhoneType::consonant:
+        return allowedConsonants.size();
+      case PhoneType::semivowel:
+        return allowedSemivowels.size();
+      case PhoneType::vowel:
+        return allowedVowels.size();
+      case PhoneType::intonation:
+        return allowedIntonations.size();
+      default:
+        return 0;
+    }
+  }
+};
+
+// MARK: - Valid Syllables
+
+/// 所有實際存在的國語音節的位元集合，以讀音的聲介韻部分（不計聲調）為索引，
+/// 共 2048 個位元。於編譯期從各拼音對照表的注音一側生成：以漢語拼音為主，
+/// 另有少數音節（例如「ㄌㄩㄣ」）只見於威妥瑪拼音。
+inline static constexpr auto _validSyllableBits = [] {
+  constexpr uint16_t syllableMask = PackedReading::consonantMask |
+                                    PackedReading::semivowelMask |
+                                    PackedReading::vowelMask;
+  std::array<uint64_t, (syllableMask + 1) / 64> bits{};
+  for (StringPairTable table :
+       {_hanyuPinyinTable.view(), _secondaryPinyinTable.view(),
+        _yalePinyinTable.view(), _hualuoPinyinTable.view(),
+        _universalPinyinTable.view(), _wadeGilesPinyinTable.view()}) {
+    for (const StringPair& pair : table) {
+      uint16_t syllable = PackedReading::fromString(pair.value).raw;
+      bits[syllable / 64] |= uint64_t{1} << (syllable % 64);
+    }
+  }
+  return bits;
+}();
+
+constexpr bool PackedReading::isValidSyllable() const {
+  uint16_t syllable = raw & (consonantMask | semivowelMask | vowelMask);
+  return (_validSyllableBits[syllable / 64] >> (syllable % 64)) & 1;
+}
+
+// MARK: - Dynamic Layout Transition Tables
+
+/// 動態注音排列（酷音大千二十六、倚天二十六、許氏、星光、劉氏）的狀態轉移表。
+///
+/// 以「注拼槽狀態、按鍵」為索引，記錄「新的注拼槽狀態、該按鍵翻譯出的注音符號」。
+/// 注拼槽狀態是 PackedReading 各槽位索引換算成的緊湊序號（共 22×4×14×6 種），
+/// 按鍵則換算成該排列的按鍵序號：靜態按鍵各佔一格，其餘按鍵的處理結果都相同，
+/// 故共用第 0 格。
+///
+/// 各格會在首次被查詢時才交給 Composer 既有的 handleXXX 函式算出並記下，
+/// 之後同樣的擊鍵就只是一次陣列讀取。各格皆為 atomic，可以跨執行緒共用。
+class DynamicLayoutTransitionTable {
+ public:
+  static constexpr size_t stateCount = 22 * 4 * 14 * 6;
+
+  /// 用來查詢新的注拼槽狀態的結果格式：
+  /// - bit 0-15：新的注拼槽狀態（PackedReading 的 raw 值）
+  /// - bit 16-20：翻譯出的注音符號在其類型當中的索引
+  /// - bit 21-23：翻譯出的注音符號的類型（PhoneType）
+  /// - bit 31：該格是否已算出
+  static constexpr uint32_t computedFlag = 0x80000000;
+
+  /// @param keyTable 該排列的靜態按鍵 ASCII 查詢表。
+  explicit DynamicLayoutTransitionTable(
+      const std::array<char32_t, 128>& keyTable) {
+    _keySlots.fill(0);
+    _slotKeys.fill(0);
+    _slotCount = 1;
+    for (size_t code = 1; code < keyTable.size(); code++) {
+      if (keyTable[code]) {
+        _keySlots[code] = static_cast<uint8_t>(_slotCount);
+        _slotKeys[_slotCount++] = static_cast<char>(code);
+      } else if (!_slotKeys[0]) {
+        _slotKeys[0] = static_cast<char>(code);
+      }
+    }
+    _cells = std::vector<std::atomic<uint32_t>>(stateCount * _slotCount);
+  }
+
+  /// 將讀音換算成緊湊的狀態序號。
+  static constexpr uint16_t stateIndex(PackedReading reading) {
+    return static_cast<uint16_t>(
+        ((reading.consonantIndex() * 4 + reading.semivowelIndex()) * 14 +
+         reading.vowelIndex()) *
+            6 +
+        reading.intonationIndex());
+  }
+
+  /// 將緊湊的狀態序號換算回讀音。
+  static constexpr PackedReading readingAt(uint16_t index) {
+    return PackedReading()
+        .withIndex(PhoneType::intonation, index % 6)
+        .withIndex(PhoneType::vowel, (index / 6) % 14)
+        .withIndex(PhoneType::semivowel, (index / 84) % 4)
+        .withIndex(PhoneType::consonant, index / 336);
+  }
+
+  /// 將新的注拼槽狀態與翻譯出的注音符號編碼成表格的一格。
+  static constexpr uint32_t encode(PackedReading newState,
+                                   PhonabetClass emitted) {
+    return computedFlag | (static_cast<uint32_t>(emitted.type) << 21) |
+           (static_cast<uint32_t>(emitted.index) << 16) | newState.raw;
+  }
+
+  /// 從表格的一格取出新的注拼槽狀態。
+  static constexpr PackedReading newState(uint32_t cell) {
+    return PackedReading(static_cast<uint16_t>(cell & 0xFFFF));
+  }
+
+  /// 從表格的一格取出翻譯出的注音符號；沒有時回傳 0。
+  static constexpr char32_t emittedPhonabet(uint32_t cell) {
+    return PackedReading::scalarOf(static_cast<PhoneType>((cell >> 21) & 0x7),
+                                   (cell >> 16) & 0x1F);
+  }
+
+  /// 按鍵所對應的按鍵序號。
+  uint8_t slotOf(char key) const {
+    unsigned char code = static_cast<unsigned char>(key);
+    return code < 128 ? _keySlots[code] : 0;
+  }
+
+  /// 按鍵序號所對應的代表按鍵。
+  char keyAt(uint8_t slot) const { return _slotKeys[slot]; }
+
+  /// 按鍵序號的總數。
+  size_t slotCount() const { return _slotCount; }
+
+  /// 取得表格的一格。
+  std::atomic<uint32_t>& cell(uint16_t state, uint8_t slot) {
+    return _cells[state * _slotCount + slot];
+  }
+
+ private:
+  std::array<uint8_t, 128> _keySlots;
+  std::array<char, 128> _slotKeys;
+  size_t _slotCount;
+  std::vector<std::atomic<uint32_t>> _cells;
+};
+
+// MARK: - Phonabet Combination Correction
+
+/// 並擊糾正的參考實作，即 Composer::receiveKeyFromPhonabet() 原本的 switch。
+///
+/// 給定目前的注拼槽狀態與新來的注音符號，回傳「糾正後的注拼槽狀態、實際要寫入
+/// 的注音符號」，格式與 DynamicLayoutTransitionTable 的一格相同。
+/// 實際擊鍵時請查 _combinationCorrectionTable，這裡僅供生成與驗證該表。
+/// @param state 目前的注拼槽狀態。
+/// @param phonabet 新來的注音符號。
+constexpr uint32_t _correctCombinationReference(PackedReading state,
+                                                char32_t phonabet) {
+  char32_t thePhone = phonabet;
+  char32_t consonant = state.consonant();
+  char32_t semivowel = state.semivowel();
+  char32_t vowel = state.vowel();
+  bool labial = consonant == U'ㄅ' || consonant == U'ㄆ' ||
+                consonant == U'ㄇ' || consonant == U'ㄈ';
+  switch (phonabet) {
+    case U'ㄧ':
+    case U'ㄩ':
+      if (vowel == U'ㄜ') vowel = U'ㄝ';
+      break;
+    case U'ㄜ':
+      if (semivowel == U'ㄨ') semivowel = U'ㄩ';
+      if (semivowel == U'ㄧ' || semivowel == U'ㄩ') thePhone = U'ㄝ';
+      break;
+    case U'ㄝ':
+      if (semivowel == U'ㄨ') semivowel = U'ㄩ';
+      break;
+    case U'ㄛ':
+      if (semivowel == U'ㄩ') semivowel = U'ㄨ';
+      if (labial && semivowel == U'ㄨ') semivowel = 0;
+      break;
+    case U'ㄥ':
+      if (labial && semivowel == U'ㄨ') semivowel = 0;
+      break;
+    case U'ㄟ':
+      if ((consonant == U'ㄋ' || consonant == U'ㄌ') && semivowel == U'ㄨ')
+        semivowel = 0;
+      break;
+    case U'ㄨ':
+      if (labial && (vowel == U'ㄛ' || vowel == U'ㄥ')) vowel = 0;
+      if ((consonant == U'ㄋ' || consonant == U'ㄌ') && vowel == U'ㄟ')
+        vowel = 0;
+      if (vowel == U'ㄜ') vowel = U'ㄝ';
+      if (vowel == U'ㄝ') thePhone = U'ㄩ';
+      break;
+    case U'ㄅ':
+    case U'ㄆ':
+    case U'ㄇ':
+    case U'ㄈ':
+      if (semivowel == U'ㄨ' && (vowel == U'ㄛ' || vowel == U'ㄥ'))
+        semivowel = 0;
+      break;
+    default:
+      break;
+  }
+  PhoneType type = PackedReading::typeOf(thePhone);
+  if ((type == PhoneType::vowel || type == PhoneType::intonation) &&
+      (consonant == U'ㄓ' || consonant == U'ㄔ' || consonant == U'ㄕ' ||
+       consonant == U'ㄗ' || consonant == U'ㄘ' || consonant == U'ㄙ')) {
+    switch (semivowel) {
+      case U'ㄧ':
+        semivowel = 0;
+        break;
+      case U'ㄩ':
+        if (consonant == U'ㄓ' || consonant == U'ㄗ') consonant = U'ㄐ';
+        if (consonant == U'ㄔ' || consonant == U'ㄘ') consonant = U'ㄑ';
+        if (consonant == U'ㄕ' || consonant == U'ㄙ') consonant = U'ㄒ';
+        break;
+      default:
+        break;
+    }
+  }
+  PackedReading corrected =
+      PackedReading(state.raw & PackedReading::intonationMask)
+          .with(consonant)
+          .with(semivowel)
+          .with(vowel);
+  return DynamicLayoutTransitionTable::encode(corrected,
+                                              classifyPhonabet(thePhone));
+}
+
+/// 並擊糾正只在乎新來的注音符號屬於下列哪一欄：同一欄的符號糾正結果相同
+/// （寫入的符號除外，但只有ㄜ與ㄨ會被換掉，而它們各自獨佔一欄）。
+/// 不在任何一欄的符號（ㄅㄆㄇㄈ以外的聲母）不觸發任何糾正，回傳 -1。
+inline static constexpr char32_t _correctionColumnSamples[] = {
+    U'ㄧ', U'ㄩ', U'ㄜ', U'ㄝ', U'ㄛ', U'ㄥ',
+    U'ㄟ', U'ㄨ', U'ㄅ', U'ㄚ', U' '};
+
+constexpr int _correctionColumn(char32_t phonabet) {
+  switch (phonabet) {
+    case U'ㄧ':
+      return 0;
+    case U'ㄩ':
+      return 1;
+    case U'ㄜ':
+      return 2;
+    case U'ㄝ':
+      return 3;
+    case U'ㄛ':
+      return 4;
+    case U'ㄥ':
+      return 5;
+    case U'ㄟ':
+      return 6;
+    case U'ㄨ':
+      return 7;
+    case U'ㄅ':
+    case U'ㄆ':
+    case U'ㄇ':
+    case U'ㄈ':
+      return 8;
+    default:
+      break;
+  }
+  switch (PackedReading::typeOf(phonabet)) {
+    case PhoneType::vowel:
+      return 9;
+    case PhoneType::intonation:
+      return 10;
+    default:
+      return -1;
+  }
+}
+
+/// 並擊糾正不看聲調，故狀態只有聲介韻的 22×4×14 種。
+inline static constexpr size_t _correctionStateCount = 22 * 4 * 14;
+inline static constexpr size_t _correctionColumnCount =
+    std::size(_correctionColumnSamples);
+
+constexpr size_t _correctionStateIndex(PackedReading state) {
+  return (state.consonantIndex() * 4 + state.semivowelIndex()) * 14 +
+         state.vowelIndex();
+}
+
+/// 由參考實作於編譯期窮舉生成的並擊糾正表，以「狀態×欄」為索引。
+inline static constexpr auto _combinationCorrectionTable = [] {
+  std::array<uint32_t, _correctionStateCount * _correctionColumnCount> table{};
+  for (size_t index = 0; index < _correctionStateCount; index++) {
+    PackedReading state = PackedReading()
+                              .withIndex(PhoneType::vowel, index % 14)
+                              .withIndex(PhoneType::semivowel, index / 14 % 4)
+                              .withIndex(PhoneType::consonant, index / 56);
+    for (size_t column = 0; column < _correctionColumnCount; column++) {
+      table[index * _correctionColumnCount + column] =
+          _correctCombinationReference(state, _correctionColumnSamples[column]);
+    }
+  }
+  return table;
+}();
+
+/// 查表版的並擊糾正，結果與 _correctCombinationReference() 完全一致。
+/// @param state 目前的注拼槽狀態。
+/// @param phonabet 新來的注音符號。
+constexpr uint32_t _correctCombination(PackedReading state,
+                                       char32_t phonabet) {
+  int column = _correctionColumn(phonabet);
+  if (column < 0) {
+    return DynamicLayoutTransitionTable::encode(state,
+                                                classifyPhonabet(phonabet));
+  }
+  uint32_t cell =
+      _combinationCorrectionTable[_correctionStateIndex(state) *
+                                      _correctionColumnCount +
+                                  column];
+  // 表內的寫入符號是取樣符號，除ㄜ與ㄨ會被換掉之外，皆以實際符號為準。
+  if (DynamicLayoutTransitionTable::emittedPhonabet(cell) ==
+      _correctionColumnSamples[column]) {
+    cell = DynamicLayoutTransitionTable::encode(
+        DynamicLayoutTransitionTable::newState(cell),
+        classifyPhonabet(phonabet));
+  }
+  uint16_t intonation = state.raw & PackedReading::intonationMask;
+  return cell | intonation;
+}
+
+// MARK: - Perfect Hash for Romanization Syllables
+
+/// 拼音音節雜湊（FNV-1a 加上最後的攪拌），seed 不同則結果互不相關。
+constexpr uint32_t _syllableHash(std::string_view syllable, uint32_t seed) {
+  uint32_t hash = 0x811C9DC5u ^ (seed * 0x9E3779B9u);
+  for (char c : syllable) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x01000193u;
+  }
+  hash ^= hash >> 16;
+  hash *= 0x85EBCA6Bu;
+  hash ^= hash >> 13;
+  return hash;
+}
+
+/// 拼音音節的最小完美雜湊表的唯讀視圖。
+///
+/// 先以 seed 0 將音節分到各個桶，再以該桶的 seed 算出槽位；每個音節都有
+/// 自己專屬的槽位，故查詢時只需算兩次雜湊、比對一次字串。只有一個音節的
+/// 桶則直接記下槽位（最高位元為 1），免去第二次雜湊。
+class SyllableHashView {
+ public:
+  /// 槽位內容：該音節在原始對照表內的序號，以及其對應的讀音。
+  struct Slot {
+    uint16_t pairIndex = 0;
+    PackedReading reading;
+  };
+
+  /// seed 的最高位元：表示其餘位元即為槽位序號。
+  static constexpr uint16_t kDirectSlot = 0x8000;
+
+  constexpr SyllableHashView() = default;
+  constexpr SyllableHashView(const StringPair* pairs, const Slot* slots,
+                             size_t count, const uint16_t* seeds,
+                             size_t bucketCount)
+      : _pairs(pairs),
+        _slots(slots),
+        _count(count),
+        _seeds(seeds),
+        _bucketCount(bucketCount) {}
+
+  constexpr bool empty() const { return _count == 0; }
+
+  /// 查詢給定的音節；查無結果時回傳空指標。
+  constexpr const Slot* find(std::string_view syllable) const {
+    if (_count == 0) return nullptr;
+    uint16_t seed = _seeds[_syllableHash(syllable, 0) % _bucketCount];
+    const Slot& slot = (seed & kDirectSlot)
+                           ? _slots[seed & ~kDirectSlot]
+                           : _slots[_syllableHash(syllable, seed) % _count];
+    if (_pairs[slot.pairIndex].key != syllable) return nullptr;
+    return &slot;
+  }
+
+ private:
+  const StringPair* _pairs = nullptr;
+  const Slot* _slots = nullptr;
+  size_t _count = 0;
+  const uint16_t* _seeds = nullptr;
+  size_t _bucketCount = 0;
+};
+
+/// 在編譯期以「雜湊並位移」（hash and displace）的方式替給定的對照表
+/// 生成最小完美雜湊表：槽位數與音節數相同，每個槽位都恰好放一個音節。
+///
+/// 各桶按大小由大到小依序處理，逐一嘗試 seed，直到該桶的所有音節都能放進
+/// 尚未佔用、且彼此不同的槽位為止；只剩單一音節的桶則直接填進空槽位。
+/// 鍵重複的話無法生成，會導致編譯失敗。
+template <size_t N>
+class SyllableHashTable {
+ public:
+  /// 平均每桶一個音節；多數桶只有單一音節，可直接記下槽位。
+  static constexpr size_t bucketCount = N;
+  static_assert(N > 0 && N < SyllableHashView::kDirectSlot);
+
+  constexpr explicit SyllableHashTable(const StringPair (&pairs)[N])
+      : _pairs(pairs), _slots(), _seeds() {
+    // 先以計數排序將各音節按桶歸類。
+    std::array<uint16_t, bucketCount + 1> bucketStart{};
+    for (size_t i = 0; i < N; i++) {
+      bucketStart[_syllableHash(pairs[i].key, 0) % bucketCount + 1]++;
+    }
+    for (size_t b = 0; b < bucketCount; b++) {
+      bucketStart[b + 1] += bucketStart[b];
+    }
+    std::array<uint16_t, N> members{};
+    std::array<uint16_t, bucketCount> filled{};
+    for (size_t i = 0; i < N; i++) {
+      size_t bucket = _syllableHash(pairs[i].key, 0) % bucketCount;
+      members[bucketStart[bucket] + filled[bucket]++] =
+          static_cast<uint16_t>(i);
+    }
+    // 大桶優先：再以桶的大小做一次計數排序。
+    std::array<uint16_t, N + 2> sizeStart{};
+    for (size_t b = 0; b < bucketCount; b++) sizeStart[N - filled[b] + 1]++;
+    for (size_t k = 0; k <= N; k++) sizeStart[k + 1] += sizeStart[k];
+    std::array<uint16_t, bucketCount> order{};
+    for (size_t b = 0; b < bucketCount; b++) {
+      order[sizeStart[N - filled[b]]++] = static_cast<uint16_t>(b);
+    }
+    std::array<bool, N> taken{};
+    std::array<size_t, N> candidates{};
+    size_t nextFree = 0;
+    for (uint16_t bucket : order) {
+      size_t size = filled[bucket];
+      if (size == 0) break;
+      const uint16_t* bucketMembers = members.data() + bucketStart[bucket];
+      if (size == 1) {
+        while (taken[nextFree]) nextFree++;
+        taken[nextFree] = true;
+        _slots[nextFree].pairIndex = bucketMembers[0];
+        _slots[nextFree].reading =
+            PackedReading::fromString(pairs[bucketMembers[0]].value);
+        _seeds[bucket] =
+            static_cast<uint16_t>(SyllableHashView::kDirectSlot | nextFree);
+        continue;
+      }
+      for (uint32_t seed = 1;; seed++) {
+        if (seed >= SyllableHashView::kDirectSlot) {
+          throw "Failed to build a perfect hash.";
+        }
+        bool fits = true;
+        for (size_t m = 0; m < size && fits; m++) {
+          candidates[m] = _syllableHash(pairs[bucketMembers[m]].key, seed) % N;
+          fits = !taken[candidates[m]];
+          for (size_t k = 0; k < m && fits; k++) {
+            fits = candidates[k] != candidates[m];
+          }
+        }
+        if (!fits) continue;
+        for (size_t m = 0; m < size; m++) {
+          taken[candidates[m]] = true;
+          SyllableHashView::Slot& slot = _slots[candidates[m]];
+          slot.pairIndex = bucketMembers[m];
+          slot.reading =
+              PackedReading::fromString(pairs[bucketMembers[m]].value);
+        }
+        _seeds[bucket] = static_cast<uint16_t>(seed);
+        break;
+      }
+    }
+  }
+
+  constexpr SyllableHashView view() const {
+    return SyllableHashView(_pairs, _slots.data(), N, _seeds.data(),
+                            bucketCount);
+  }
+
+ private:
+  const StringPair* _pairs;
+  std::array<SyllableHashView::Slot, N> _slots;
+  std::array<uint16_t, bucketCount> _seeds;
+};
+
+inline static constexpr SyllableHashTable _hanyuPinyinHash{_hanyuPinyinPairs};
+inline static constexpr SyllableHashTable _secondaryPinyinHash{
+    _secondaryPinyinPairs};
+inline static constexpr SyllableHashTable _yalePinyinHash{_yalePinyinPairs};
+inline static constexpr SyllableHashTable _hualuoPinyinHash{
+    _hualuoPinyinPairs};
+inline static constexpr SyllableHashTable _universalPinyinHash{
+    _universalPinyinPairs};
+inline static constexpr SyllableHashTable _wadeGilesPinyinHash{
+    _wadeGilesPinyinPairs};
+
+/// 取得指定拼音排列的「音節→讀音」完美雜湊表；非拼音排列則回傳空表。
+/// @param parser 注音排列。
+constexpr SyllableHashView pinyinSyllableHash(MandarinParser parser) {
+  switch (parser) {
+    case ofHanyuPinyin:
+      return _hanyuPinyinHash.view();
+    case ofSecondaryPinyin:
+      return _secondaryPinyinHash.view();
+    case ofYalePinyin:
+      return _yalePinyinHash.view();
+    case ofHualuoPinyin:
+      return _hualuoPinyinHash.view();
+    case ofUniversalPinyin:
+      return _universalPinyinHash.view();
+    case ofWadeGilesPinyin:
+      return _wadeGilesPinyinHash.view();
+    default:
+      return SyllableHashView();
+  }
+}
+
+// MARK: - Reading IDs
+
+/// 將讀音序號轉成注音字串，格式與 Composer::getComposition() 一致。
+/// @param id 讀音序號，參見 PackedReading::readingID()。
+inline static std::string readingIDToZhuyin(uint16_t id) {
+  PackedReading reading = PackedReading::fromReadingID(id);
+  std::string result;
+  for (char32_t phonabet : {reading.consonant(), reading.semivowel(),
+                            reading.vowel(), reading.intonation()}) {
+    if (phonabet != 0) result += char32ToString(phonabet);
+  }
+  return result;
+}
+
+/// 將讀音序號轉成數字標調的漢語拼音，格式與 Composer::getComposition(true)
+/// 一致（但陰平不會標出「1」）。
+/// @param id 讀音序號，參見 PackedReading::readingID()。
+inline static std::string readingIDToHanyuPinyin(uint16_t id) {
+  return cnvPhonaToHanyuPinyin(readingIDToZhuyin(id));
+}
+
+/// 將注音字串轉成讀音序號；不是注音符號的字元會被略過。
+/// @param zhuyin 注音字串，陰平可寫可不寫。
+constexpr uint16_t readingIDFromZhuyin(std::string_view zhuyin) {
+  return PackedReading::fromString(zhuyin).readingID();
+}
+
+/// 將拼音音節轉成讀音序號；查無此音節時回傳 0。
+/// @param pinyin 拼音音節，結尾可以帶一個 1-5 的數字作為聲調。
+/// @param parser 拼音排列。
+constexpr uint16_t readingIDFromPinyin(std::string_view pinyin,
+                                       MandarinParser parser = ofHanyuPinyin) {
+  uint8_t tone = 0;
+  if (!pinyin.empty() && pinyin.back() >= '1' && pinyin.back() <= '5') {
+    tone = static_cast<uint8_t>(pinyin.back() - '0');
+    pinyin.remove_suffix(1);
+  }
+  const SyllableHashView::Slot* slot = pinyinSyllableHash(parser).find(pinyin);
+  if (slot == nullptr) return 0;
+  return slot->reading.withIndex(PhoneType::intonation, tone).readingID();
+}
+
+// MARK: - Shared Per-Parser Instances
+
+/// 將注音排列換算成從 0 起算的連續槽位編號；未知的排列回傳 -1。
+constexpr int _parserSlot(MandarinParser parser) {
+  if (parser >= ofDachen && parser <= ofAlvinLiu) return parser;
+  if (parser >= ofHanyuPinyin && parser <= ofWadeGilesPinyin) {
+    return parser - ofHanyuPinyin + ofAlvinLiu + 1;
+  }
+  return -1;
+}
+
+inline static constexpr int _parserSlotCount =
+    _parserSlot(ofWadeGilesPinyin) + 1;
+
+/// 每種注音排列各一份的共用實例登記表（T 須可由 MandarinParser 建構）。
+///
+/// 每種排列各佔一個原子槽位，指向一個不可變的 Holder；實例建立之後只需
+/// 一次 acquire 讀取即可取得，不必上鎖。實例本身以 std::shared_ptr 管理：
+/// 登記表持有一份強參照，handle() 交出去的 shared_ptr 各持一份。
+///
+/// retireAll() 會清空所有槽位並放掉登記表自己的強參照，之後的 get() 與
+/// handle() 會重新建立新的實例。被撤下的實例在最後一個 handle 放掉之後
+/// 即被釋放；只有 Holder（一個 weak_ptr 與一個裸指標）會留到程式結束，
+/// 以便讓仍在讀取槽位的執行緒安全地撲空重來。
+///
+/// get() 交出的是無法追蹤壽命的裸參照，故經由 get() 取得過的實例會被
+/// 「釘住」、永不釋放——這與舊版 retireAll() 的行為相同。
+template <typename T>
+class _SharedParserRegistry {
+ public:
+  static T& get(MandarinParser parser) {
+    int slot = _parserSlot(parser);
+    if (slot < 0) return *_pin(_unlistedHandle(parser));
+    while (true) {
+      Holder* holder = _acquire(slot, parser);
+      if (holder->pinned.load(std::memory_order_acquire)) {
+        return *holder->instance;
+      }
+      std::shared_ptr<T> strong = holder->weak.lock();
+      if (!strong) continue;  // 剛好被撤下且已釋放，重新取得。
+      holder->pinned.store(true, std::memory_order_release);
+      return *_pin(std::move(strong));
+    }
+  }
+
+  /// 取得共用實例的強參照；只要手上還持有它，實例就不會被 retireAll() 釋放。
+  static std::shared_ptr<T> handle(MandarinParser parser) {
+    int slot = _parserSlot(parser);
+    if (slot < 0) return _unlistedHandle(parser);
+    while (true) {
+      std::shared_ptr<T> strong = _acquire(slot, parser)->weak.lock();
+      if (strong) return strong;
+    }
+  }
+
+  /// 將預先建好的實例登記到對應的槽位。
+  /// @return 該槽位已有實例（或排列不在列舉範圍內）時回傳 false，
+  /// 此時 instance 的所有權仍歸呼叫端。
+  static bool publish(MandarinParser parser, T* instance) {
+    int slot = _parserSlot(parser);
+    if (slot < 0) return false;
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_slots[slot].load(std::memory_order_relaxed)) return false;
+    _install(slot, std::shared_ptr<T>(instance));
+    return true;
+  }
+
+  static void retireAll() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (int slot = 0; slot < _parserSlotCount; slot++) {
+      _slots[slot].store(nullptr, std::memory_order_release);
+      _owners()[slot].reset();
+    }
+    _unlisted().clear();
+  }
+
+ private:
+  /// 槽位指向的內容；發佈之後除了 pinned 以外皆不再變動。
+  struct Holder {
+    std::weak_ptr<T> weak;
+    T* instance;
+    std::atomic<bool> pinned{false};
+  };
+
+  static inline std::array<std::atomic<Holder*>, _parserSlotCount> _slots{};
+  static inline std::mutex _mutex;
+
+  static Holder* _acquire(int slot, MandarinParser parser) {
+    Holder* existing = _slots[slot].load(std::memory_order_acquire);
+    if (existing) return existing;
+    // 在鎖外建構；若有其他執行緒搶先發佈，這份會在解鎖之後捨棄。
+    std::shared_ptr<T> created(new T(parser));
+    std::lock_guard<std::mutex> lock(_mutex);
+    existing = _slots[slot].load(std::memory_order_relaxed);
+    return existing ? existing : _install(slot, std::move(created));
+  }
+
+  /// 呼叫端須持有 _mutex。
+  static Holder* _install(int slot, std::shared_ptr<T> instance) {
+    _holders().push_back(std::make_unique<Holder>());
+    Holder* holder = _holders().back().get();
+    holder->weak = instance;
+    holder->instance = instance.get();
+    _owners()[slot] = std::move(instance);
+    _slots[slot].store(holder, std::memory_order_release);
+    return holder;
+  }
+
+  static T* _pin(std::shared_ptr<T> instance) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    T* raw = instance.get();
+    _pinned().insert(std::move(instance));
+    return raw;
+  }
+
+  /// 不在 MandarinParser 列舉範圍內的排列走這條（需上鎖的）慢速路徑。
+  static std::shared_ptr<T> _unlistedHandle(MandarinParser parser) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::shared_ptr<T>& instance = _unlisted()[static_cast<int>(parser)];
+    if (!instance) instance.reset(new T(parser));
+    return instance;
+  }
+
+  // 以下皆於首次使用時才會建立，免得程式啟動時就要做動態初期化。
+
+  static std::array<std::shared_ptr<T>, _parserSlotCount>& _owners() {
+    static std::array<std::shared_ptr<T>, _parserSlotCount> instance;
+    return instance;
+  }
+
+  static std::map<int, std::shared_ptr<T>>& _unlisted() {
+    static std::map<int, std::shared_ptr<T>> instance;
+    return instance;
+  }
+
+  static std::vector<std::unique_ptr<Holder>>& _holders() {
+    static std::vector<std::unique_ptr<Holder>> instance;
+    return instance;
+  }
+
+  static std::set<std::shared_ptr<T>>& _pinned() {
+    static std::set<std::shared_ptr<T>> instance;
+    return instance;
+  }
+};
+
+// MARK: - CompactPinyinTrie
+
+/// 取得指定拼音排列的「拼音→注音」編譯期對照表；非拼音排列則回傳空表。
+/// @param parser 注音排列。
+constexpr StringPairTable pinyinReadingTable(MandarinParser parser) {
+  switch (parser) {
+    case ofHanyuPinyin:
+      return _hanyuPinyinTable.view();
+    case ofSecondaryPinyin:
+      return _secondaryPinyinTable.view();
+    case ofYalePinyin:
+      return _yalePinyinTable.view();
+    case ofHualuoPinyin:
+      return _hualuoPinyinTable.view();
+    case ofUniversalPinyin:
+      return _universalPinyinTable.view();
+    case ofWadeGilesPinyin:
+      return _wadeGilesPinyinTable.view();
+    default:
+      return StringPairTable();
+  }
+}
+
+/// 取得指定拼音排列的「拼音→注音」辭典；非拼音排列則回傳空指標。
+///
+/// 這是給舊版 API 用的：首次呼叫時才會生成對應的 std::map。
+/// 僅需查詢的話，請改用 pinyinReadingTable()。
+/// @param parser 注音排列。
+inline static std::map<std::string, std::string>* pinyinReadingMap(
+    MandarinParser parser) {
+  switch (parser) {
+    case ofHanyuPinyin:
+      return &mapHanyuPinyin.get();
+    case ofSecondaryPinyin:
+      return &mapSecondaryPinyin.get();
+    case ofYalePinyin:
+      return &mapYalePinyin.get();
+    case ofHualuoPinyin:
+      return &mapHualuoPinyin.get();
+    case ofUniversalPinyin:
+      return &mapUniversalPinyin.get();
+    case ofWadeGilesPinyin:
+      return &mapWadeGilesPinyin.get();
+    default:
+      return nullptr;
+  }
+}
+
+/// 將單個拼音切片搜到的所有注音整理成一個候選字串。
+///
+/// 給 PinyinTrie 與 CompactPinyinTrie 的 deductChoppedPinyinToZhuyin 共用。
+/// @param slice 拼音切片。
+/// @param fetched 該切片搜到的所有注音。
+/// @param chopCaseSeparator 多個候選之間的分隔符號。
+/// @param initialZhuyinOnly 是否只保留聲母部分。
+inline static std::string _mergeZhuyinCandidates(
+    const std::string& slice, const std::vector<std::string>& fetched,
+    char chopCaseSeparator, bool initialZhuyinOnly) {
+  switch (fetched.size()) {
+    case 0:
+      return slice;
+    case 1:
+      return fetched[0];
+    default:
+      break;
+  }
+  // 去重並排序
+  std::vector<std::string> uniqueFetched = fetched;
+  std::sort(uniqueFetched.begin(), uniqueFetched.end());
+  uniqueFetched.erase(std::unique(uniqueFetched.begin(), uniqueFetched.end()),
+                      uniqueFetched.end());
+
+  // 如果 initialZhuyinOnly 為 true，只保留聲母部分
+  if (initialZhuyinOnly) {
+    for (int i = 3; i >= 1; i--) {
+      if (uniqueFetched.size() <= static_cast<size_t>(i)) break;
+
+      std::set<std::string> prefixSet;
+      for (const auto& item : fetched) {
+        auto split = splitByCodepoint(item);
+        if (!split.empty() && split.size() >= static_cast<size_t>(i)) {
+          std::string prefix;
+          for (size_t j = 0; j < static_cast<size_t>(i) && j < split.size();
+               j++) {
+            prefix += split[j];
+          }
+          prefixSet.insert(prefix);
+        }
+      }
+      uniqueFetched.assign(prefixSet.begin(), prefixSet.end());
+      std::sort(uniqueFetched.begin(), uniqueFetched.end());
+    }
+  }
+
+  // 用分隔符連接
+  std::string joined;
+  for (size_t i = 0; i < uniqueFetched.size(); i++) {
+    if (i > 0) joined += chopCaseSeparator;
+    joined += uniqueFetched[i];
+  }
+  return joined;
+}
+
+/// PinyinTrie 的緊湊版本，所有節點與詞條都存放在同一塊連續的記憶體影像內。
+///
+/// 節點按廣度優先的順序編號，故同一節點的子節點在陣列當中彼此相鄰、
+/// 且按邊上的字元（uint8_t）由小到大排列，查詢子節點時只需比對這一小段。
+/// 詞條則按深度優先（前序）的順序排列，故任一節點底下的所有詞條都落在
+/// 一段連續的範圍內，搜尋前綴時不必遍歷子樹。
+/// 該類型建成之後不再變動，可以跨執行緒共用。
+///
+/// 影像內的各區段只以「相對於影像開頭的位移量」互相參照，故可以原樣寫入檔案
+/// （saveCompiled），再由其他行程直接映射回來使用（mapCompiled）：
+/// 查詢直接讀取映射的分頁，多個行程共用同一份分頁快取，
+/// 啟動時也不必重建字首樹。
+///
+/// 與 PinyinTrie 相同：非拼音排列的字首樹僅含漢語拼音的各個讀音、但不帶詞條，
+/// 故只能用於 chop()。
+class CompactPinyinTrie {
+ public:
+  /// 節點結構。根節點的序號是 0，故 0 不會是任何節點的子節點。
+  struct Node {
+    uint32_t firstChild = 0;
+    /// 該節點自身的詞條是 [firstEntry, firstEntry + entryCount)，
+    /// 連同所有後代的詞條則是 [firstEntry, subtreeEntryEnd)。
+    uint32_t firstEntry = 0;
+    uint32_t subtreeEntryEnd = 0;
+    /// 子樹內所有讀音的聲母摘要，格式同 SliceCandidates::consonantMask。
+    uint32_t consonantMask = 0;
+    uint16_t entryCount = 0;
+    uint8_t childCount = 0;
+    uint8_t label = 0;
+    /// 恰好以該節點結尾的讀音；不是完整讀音的話則為空。
+    PackedReading reading;
+  };
+
+  /// 詞條：指向字串區內的注音文字，另附其 PackedReading。
+  struct Entry {
+    uint32_t textOffset = 0;
+    uint16_t textLength = 0;
+    PackedReading reading;
+  };
+
+  /// 反查索引的條目：讀音（不含聲調）及其拼音拼寫，按讀音排序。
+  struct Spelling {
+    PackedReading reading;
+    uint16_t keyLength = 0;
+    uint32_t keyOffset = 0;
+  };
+
+  /// 編譯檔（影像）的檔頭；各區段的位移量皆以影像開頭為基準。
+  struct CompiledHeader {
+    char magic[8];
+    uint32_t version;
+    /// 寫入 0x01020304，用來拒絕位元組順序不同的機器所產生的檔案。
+    uint32_t byteOrderMark;
+    int32_t parser;
+    uint32_t imageSize;
+    uint32_t nodeOffset;
+    uint32_t nodeCount;
+    uint32_t entryOffset;
+    uint32_t entryCount;
+    uint32_t spellingOffset;
+    uint32_t spellingCount;
+    uint32_t textOffset;
+    uint32_t textSize;
+  };
+
+  static constexpr char compiledMagic[8] = {'T', 'e', 'k', 'k',
+                                            'o', 'n', 'P', 'T'};
+  /// 影像格式有任何變動時都要遞增，舊版的檔案會被 mapCompiled 拒絕。
+  static constexpr uint32_t compiledVersion = 3;
+  static constexpr uint32_t compiledByteOrderMark = 0x01020304;
+
+  MandarinParser parser;
+
+  /// 初始化 CompactPinyinTrie
+  explicit CompactPinyinTrie(MandarinParser parser) : parser(parser) {
+    StringPairTable table = pinyinReadingTable(parser);
+    bool withEntries = !table.empty();
+    if (!withEntries) table = _hanyuPinyinTable.view();
+
+    // 先以暫時的字首樹收集各節點，再按廣度優先的順序攤平。
+    struct BuildNode {
+      std::map<uint8_t, uint32_t> children;
+      std::vector<std::string_view> entries;
+    };
+    std::vector<BuildNode> buildNodes(1);
+    std::vector<Spelling> spellings;
+    std::string text;
+    for (const StringPair& pair : table) {
+      uint32_t current = 0;
+      for (char c : pair.key) {
+        uint8_t label = static_cast<uint8_t>(c);
+        auto it = buildNodes[current].children.find(label);
+        if (it != buildNodes[current].children.end()) {
+          current = it->second;
+          continue;
+        }
+        uint32_t created = static_cast<uint32_t>(buildNodes.size());
+        buildNodes[current].children[label] = created;
+        buildNodes.emplace_back();
+        current = created;
+      }
+      if (!withEntries) continue;
+      buildNodes[current].entries.push_back(pair.value);
+      Spelling spelling;
+      spelling.reading = PackedReading::fromString(pair.value);
+      spelling.keyLength = static_cast<uint16_t>(pair.key.size());
+      spelling.keyOffset = static_cast<uint32_t>(text.size());
+      spellings.push_back(spelling);
+      text += pair.key;
+    }
+    std::sort(spellings.begin(), spellings.end(),
+              [](const Spelling& lhs, const Spelling& rhs) {
+                return lhs.reading.raw < rhs.reading.raw;
+              });
+
+    std::vector<uint32_t> queue = {0};
+    std::vector<Node> nodes(buildNodes.size());
+    for (size_t head = 0; head < queue.size(); head++) {
+      BuildNode& source = buildNodes[queue[head]];
+      Node& node = nodes[head];
+      node.firstChild = static_cast<uint32_t>(queue.size());
+      node.childCount = static_cast<uint8_t>(source.children.size());
+      node.entryCount = static_cast<uint16_t>(source.entries.size());
+      if (!source.entries.empty()) {
+        node.reading = PackedReading::fromString(source.entries.front());
+      }
+      for (const auto& child : source.children) {
+        nodes[queue.size()].label = child.first;
+        queue.push_back(child.second);
+      }
+    }
+
+    // 詞條按深度優先的前序排列（與 PinyinTrie::search 的順序相同）。
+    std::vector<Entry> entries;
+    auto layOutEntries = [&](auto& self, uint32_t index) -> void {
+      nodes[index].firstEntry = static_cast<uint32_t>(entries.size());
+      for (std::string_view value : buildNodes[queue[index]].entries) {
+        Entry entry;
+        entry.textOffset = static_cast<uint32_t>(text.size());
+        entry.textLength = static_cast<uint16_t>(value.size());
+        entry.reading = PackedReading::fromString(value);
+        entries.push_back(entry);
+        text += value;
+      }
+      for (uint32_t i = 0; i < nodes[index].childCount; i++) {
+        self(self, nodes[index].firstChild + i);
+      }
+      nodes[index].subtreeEntryEnd = static_cast<uint32_t>(entries.size());
+      for (uint32_t i = nodes[index].firstEntry; i < entries.size(); i++) {
+        nodes[index].consonantMask |= consonantBit(entries[i].reading);
+      }
+    };
+    layOutEntries(layOutEntries, 0);
+    _assembleImage(nodes, entries, spellings, text);
+  }
+
+  // 各區段的指標指向影像本身，故不可複製或搬移。
+  CompactPinyinTrie(const CompactPinyinTrie&) = delete;
+  CompactPinyinTrie& operator=(const CompactPinyinTrie&) = delete;
+
+  /// 取得指定 parser 對應的共用 CompactPinyinTrie 實例。
+  /// 若尚未存在則新建並快取；已建立的實例不需上鎖即可取得。
+  static const CompactPinyinTrie& shared(MandarinParser parser) {
+    return _SharedParserRegistry<CompactPinyinTrie>::get(parser);
+  }
+
+  /// 取得指定 parser 對應的共用 CompactPinyinTrie 實例的共享所有權。
+  static std::shared_ptr<const CompactPinyinTrie> sharedHandle(
+      MandarinParser parser) {
+    return _SharedParserRegistry<CompactPinyinTrie>::handle(parser);
+  }
+
+  /// 將給定的字首樹（通常來自 mapCompiled）登記為其 parser 的共用實例。
+  /// @return 該 parser 的共用實例已經存在的話，則不做任何事並回傳 false。
+  static bool installShared(std::unique_ptr<CompactPinyinTrie> trie) {
+    if (!trie) return false;
+    if (!_SharedParserRegistry<CompactPinyinTrie>::publish(trie->parser,
+                                                           trie.get())) {
+      return false;
+    }
+    trie.release();
+    return true;
+  }
+
+  // MARK: Compiled Images
+
+  // 這兩個函式要用到平台的檔案 I/O，故定義在 TekkonCompiledImage.hh，
+  // 需要它們的地方再引入該標頭檔即可。
+
+  /// 將影像寫入指定路徑。
+  ///
+  /// 先寫到同目錄下名稱唯一的暫存檔再改名取代，故其他行程已經映射的舊檔案
+  /// 不受影響，多個行程同時寫入同一路徑時也不會互相覆寫半成品。
+  /// @return 寫入成功與否。
+  inline bool saveCompiled(const std::string& path) const;
+
+  /// 將 saveCompiled 所寫出的檔案以唯讀方式映射進來，查詢時直接讀取映射的分頁。
+  ///
+  /// 檔頭與各區段（含每個節點的子節點與詞條範圍）都會先經過檢查，
+  /// 損毀、版本不符或位元組順序不同的檔案一律拒絕。
+  /// 不支援 mmap 的平台則改為整個讀進記憶體。
+  /// @return 失敗時回傳空指標。
+  inline static std::unique_ptr<CompactPinyinTrie> mapCompiled(
+      const std::string& path);
+
+  /// 是否直接讀取映射的檔案。
+  bool isMapped() const { return _mapping != nullptr; }
+
+  /// 整個影像（亦即 saveCompiled 所寫出的內容）。
+  std::string_view compiledImage() const {
+    return std::string_view(_image, _imageSize);
+  }
+
+  // MARK: Queries
+
+  size_t nodeCount() const { return _nodeCount; }
+
+  const Node& node(uint32_t index) const { return _nodes[index]; }
+
+  /// 以給定的 key 為前綴的所有詞條（不持有資料）。
+  using EntrySpan = ArrayView<Entry>;
+
+  /// 取得給定節點及其所有後代的詞條。
+  EntrySpan subtreeEntries(uint32_t node) const {
+    const Node& current = _nodes[node];
+    return EntrySpan(_entries + current.firstEntry,
+                     _entries + current.subtreeEntryEnd);
+  }
+
+  /// 搜索給定的 key，返回所有匹配的詞條，順序與 search() 相同。
+  ///
+  /// 結果直接指向字首樹內的詞條，不配置記憶體，耗時只與 key 的長度成正比。
+  /// 各詞條的 reading（亦可換算成 readingID()）與 text() 可直接取用。
+  EntrySpan searchEntries(std::string_view key) const {
+    uint32_t node = 0;
+    for (char c : key) {
+      node = child(node, c);
+      if (!node) return EntrySpan();
+    }
+    return subtreeEntries(node);
+  }
+
+  /// 取得詞條的注音文字（指向影像本身）。
+  std::string_view text(const Entry& entry) const {
+    return std::string_view(_text + entry.textOffset, entry.textLength);
+  }
+
+  /// 反查給定讀音（聲調會被忽略）在該拼音排列下的拼寫；查無結果時回傳空值。
+  std::string_view spellingOf(PackedReading reading) const {
+    uint16_t target = reading.without(PhoneType::intonation).raw;
+    const Spelling* end = _spellings + _spellingCount;
+    const Spelling* found =
+        std::lower_bound(_spellings, end, target,
+                         [](const Spelling& spelling, uint16_t raw) {
+                           return spelling.reading.raw < raw;
+                         });
+    if (found == end || found->reading.raw != target) return {};
+    return std::string_view(_text + found->keyOffset, found->keyLength);
+  }
+
+  /// 取得給定節點經由給定字元抵達的子節點；沒有的話則回傳 0。
+  uint32_t child(uint32_t node, char c) const {
+    uint8_t label = static_cast<uint8_t>(c);
+    const Node& parent = _nodes[node];
+    uint32_t end = parent.firstChild + parent.childCount;
+    for (uint32_t i = parent.firstChild; i < end; i++) {
+      if (_nodes[i].label == label) return i;
+      if (_nodes[i].label > label) break;
+    }
+    return 0;
+  }
+
+  /// 搜索給定的 key，返回所有匹配的注音
+  std::vector<std::string> search(const std::string& key) const {
+    EntrySpan found = searchEntries(key);
+    std::vector<std::string> result;
+    result.reserve(found.size());
+    for (const Entry& entry : found) result.emplace_back(text(entry));
+    return result;
+  }
+
+  /// 用來像智能狂拼/搜狗拼音那樣處理一個連續的簡拼字串、切割成多個可能的合理讀音前綴。
+  ///
+  /// 從當前位置沿字首樹走到最深處，走過的部分即為最長的合理讀音前綴；
+  /// 連一個字元都走不動的話，則單獨切出。耗時與「輸入長度×最長讀音長度」成正比。
+  ///
+  /// 比如說全拼「shi4jie4da4zhan4」可能會簡拼成「shjdaz」。
+  /// 此時的理想切片結果是：["sh","j","da","z"]。
+  /// @param readingComplex 要切割的字串。
+  /// @param result 用來接收切割結果的陣列，各切片皆指向 readingComplex 本身。
+  void chop(std::string_view readingComplex,
+            std::vector<std::string_view>& result) const {
+    result.clear();
+    size_t position = 0;
+    while (position < readingComplex.size()) {
+      uint32_t node = 0;
+      size_t length = 0;
+      while (position + length < readingComplex.size()) {
+        uint32_t next = child(node, readingComplex[position + length]);
+        if (!next) break;
+        node = next;
+        length++;
+      }
+      if (length == 0) length = 1;
+      result.push_back(readingComplex.substr(position, length));
+      position += length;
+    }
+  }
+
+  /// 用來像智能狂拼/搜狗拼音那樣處理一個連續的簡拼字串、切割成多個可能的合理讀音前綴。
+  ///
+  /// 比如說全拼「shi4jie4da4zhan4」可能會簡拼成「shjdaz」。
+  /// 此時的理想切片結果是：["sh","j","da","z"]。
+  std::vector<std::string> chop(const std::string& readingComplex) const {
+    std::vector<std::string_view> slices;
+    chop(readingComplex, slices);
+    return std::vector<std::string>(slices.begin(), slices.end());
+  }
+
+  /// 拿已經 chop 段切過的拼音來算出可能的注音 chop 結果。
+  /// 行為與 PinyinTrie::deductChoppedPinyinToZhuyin() 相同。
+  std::vector<std::string> deductChoppedPinyinToZhuyin(
+      const std::vector<std::string>& chopped, char chopCaseSeparator = '&',
+      bool initialZhuyinOnly = true) const {
+    if (parser < 100) return chopped;  // Not pinyin
+    std::vector<std::string> choppedZhuyinCandidates;
+    for (const auto& slice : chopped) {
+      choppedZhuyinCandidates.push_back(_mergeZhuyinCandidates(
+          slice, search(slice), chopCaseSeparator, initialZhuyinOnly));
+    }
+    return choppedZhuyinCandidates;
+  }
+
+  /// 單個拼音切片的候選讀音摘要（結構化的 deductChoppedPinyinToZhuyin 用）。
+  struct SliceCandidates {
+    /// 切片本身（指向呼叫端所給的字串）。
+    std::string_view slice;
+    /// 候選讀音的聲母集合：第 i 個聲母（從 1 起算，見 allowedConsonants）
+    /// 對應第 i - 1 個位元；另有無聲母的讀音時，再設立 withoutConsonantBit。
+    uint32_t consonantMask = 0;
+    /// 所有候選讀音（以該切片為前綴的所有讀音），按字首樹的前序排列。
+    EntrySpan readings;
+
+    /// 該切片是否有任何候選讀音；沒有的話，呼叫端通常會原樣保留切片。
+    bool matched() const { return !readings.empty(); }
+  };
+
+  /// SliceCandidates::consonantMask 當中「有無聲母的讀音」的位元。
+  static constexpr uint32_t withoutConsonantBit = uint32_t{1} << 31;
+
+  /// 取得給定讀音的聲母在 consonantMask 當中所對應的位元。
+  static constexpr uint32_t consonantBit(PackedReading reading) {
+    uint8_t index = reading.consonantIndex();
+    return index ? uint32_t{1} << (index - 1) : withoutConsonantBit;
+  }
+
+  /// 拿已經 chop 段切過的拼音來算出每個切片的候選讀音，但不組成字串。
+  ///
+  /// 每個切片只需沿字首樹走到對應的節點，再直接取用建樹時預先算好的聲母摘要
+  /// 與詞條範圍，故不排序、不去重、也不配置記憶體（result 的容量足夠時）。
+  /// 非拼音排列的字首樹不帶詞條，故所有切片皆無候選。
+  /// @param chopped 切片，通常來自 chop()。
+  /// @param result 用來接收結果的陣列，與 chopped 一一對應。
+  void deductChoppedPinyinToZhuyin(
+      const std::vector<std::string_view>& chopped,
+      std::vector<SliceCandidates>& result) const {
+    result.clear();
+    for (std::string_view slice : chopped) {
+      SliceCandidates candidates;
+      candidates.slice = slice;
+      uint32_t node = 0;
+      for (char c : slice) {
+        node = child(node, c);
+        if (!node) break;
+      }
+      if (node || slice.empty()) {
+        candidates.consonantMask = _nodes[node].consonantMask;
+        candidates.readings = subtreeEntries(node);
+      }
+      result.push_back(candidates);
+    }
+  }
+
+  /// 該字首樹所佔用的堆積記憶體位元組數（不含物件本身）。
+  /// 映射檔案的字首樹不佔用堆積，故為 0。
+  size_t memoryFootprint() const {
+    return _buffer.capacity() * sizeof(uint32_t);
+  }
+
+ private:
+  static_assert(sizeof(Node) == 24 && sizeof(Entry) == 8 &&
+                    sizeof(Spelling) == 8 && sizeof(CompiledHeader) == 56,
+                "The compiled image layout must stay fixed.");
+
+  /// 影像所在的緩衝區；以 uint32_t 為單位，確保各區段的對齊。
+  std::vector<uint32_t> _buffer;
+  /// 映射進來的檔案；最後一份參照放掉時即解除映射。
+  std::shared_ptr<const void> _mapping;
+  const char* _image = nullptr;
+  size_t _imageSize = 0;
+  const Node* _nodes = nullptr;
+  uint32_t _nodeCount = 0;
+  const Entry* _entries = nullptr;
+  uint32_t _entryCount = 0;
+  const Spelling* _spellings = nullptr;
+  uint32_t _spellingCount = 0;
+  const char* _text = nullptr;
+  uint32_t _textSize = 0;
+
+  /// 給 mapCompiled 用：parser 之後由檔頭決定。
+  CompactPinyinTrie() : parser(ofDachen) {}
+
+  /// 將各區段依序排進 _buffer（各區段皆按 4 位元組對齊），再指向該影像。
+  void _assembleImage(const std::vector<Node>& nodes,
+                      const std::vector<Entry>& entries,
+                      const std::vector<Spelling>& spellings,
+                      const std::string& text) {
+    auto aligned = [](size_t size) { return (size + 3) & ~size_t{3}; };
+    CompiledHeader header{};
+    std::memcpy(header.magic, compiledMagic, sizeof(header.magic));
+    header.version = compiledVersion;
+    header.byteOrderMark = compiledByteOrderMark;
+    header.parser = static_cast<int32_t>(parser);
+    size_t size = aligned(sizeof(CompiledHeader));
+    auto place = [&](uint32_t& offset, uint32_t& count, size_t itemCount,
+                     size_t itemSize) {
+      offset = static_cast<uint32_t>(size);
+      count = static_cast<uint32_t>(itemCount);
+      size += aligned(itemCount * itemSize);
+    };
+    place(header.nodeOffset, header.nodeCount, nodes.size(), sizeof(Node));
+    place(header.entryOffset, header.entryCount, entries.size(),
+          sizeof(Entry));
+    place(header.spellingOffset, header.spellingCount, spellings.size(),
+          sizeof(Spelling));
+    place(header.textOffset, header.textSize, text.size(), 1);
+    header.imageSize = static_cast<uint32_t>(size);
+
+    _buffer.assign(size / sizeof(uint32_t), 0);
+    char* image = reinterpret_cast<char*>(_buffer.data());
+    std::memcpy(image, &header, sizeof(header));
+    std::memcpy(image + header.nodeOffset, nodes.data(),
+                nodes.size() * sizeof(Node));
+    std::memcpy(image + header.entryOffset, entries.data(),
+                entries.size() * sizeof(Entry));
+    std::memcpy(image + header.spellingOffset, spellings.data(),
+                spellings.size() * sizeof(Spelling));
+    std::memcpy(image + header.textOffset, text.data(), text.size());
+    _attach(image, size);
+  }
+
+  /// 檢查影像並令各區段的指標指向它。
+  /// @return 影像損毀、版本不符或位元組順序不同時回傳 false。
+  bool _attach(const char* image, size_t size) {
+    if (size < sizeof(CompiledHeader)) return false;
+    CompiledHeader header;
+    std::memcpy(&header, image, sizeof(header));
+    if (std::memcmp(header.magic, compiledMagic, sizeof(header.magic)) != 0 ||
+        header.version != compiledVersion ||
+        header.byteOrderMark != compiledByteOrderMark ||
+        header.imageSize != size || header.nodeCount == 0) {
+      return false;
+    }
+    auto fits = [&](uint32_t offset, uint32_t count, size_t itemSize) {
+      return offset % 4 == 0 &&
+             uint64_t{offset} + uint64_t{count} * itemSize <= size;
+    };
+    if (!fits(header.nodeOffset, header.nodeCount, sizeof(Node)) ||
+        !fits(header.entryOffset, header.entryCount, sizeof(Entry)) ||
+        !fits(header.spellingOffset, header.spellingCount, sizeof(Spelling)) ||
+        !fits(header.textOffset, header.textSize, 1)) {
+      return false;
+    }
+    const auto* nodes =
+        reinterpret_cast<const Node*>(image + header.nodeOffset);
+    const auto* entries =
+        reinterpret_cast<const Entry*>(image + header.entryOffset);
+    const auto* spellings =
+        reinterpret_cast<const Spelling*>(image + header.spellingOffset);
+    // 子節點的序號必定大於父節點，故檢查過範圍之後，遍歷時不會繞圈。
+    for (uint32_t i = 0; i < header.nodeCount; i++) {
+      const Node& node = nodes[i];
+      if ((node.childCount && node.firstChild <= i) ||
+          uint64_t{node.firstChild} + node.childCount > header.nodeCount ||
+          uint64_t{node.firstEntry} + node.entryCount > node.subtreeEntryEnd ||
+          node.subtreeEntryEnd > header.entryCount) {
+        return false;
+      }
+    }
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+      if (uint64_t{entries[i].textOffset} + entries[i].textLength >
+          header.textSize) {
+        return false;
+      }
+    }
+    for (uint32_t i = 0; i < header.spellingCount; i++) {
+      if (uint64_t{spellings[i].keyOffset} + spellings[i].keyLength >
+              header.textSize ||
+          (i && spellings[i - 1].reading.raw >= spellings[i].reading.raw)) {
+        return false;
+      }
+    }
+    parser = static_cast<MandarinParser>(header.parser);
+    _image = image;
+    _imageSize = size;
+    _nodes = nodes;
+    _nodeCount = header.nodeCount;
+    _entries = entries;
+    _entryCount = header.entryCount;
+    _spellings = spellings;
+    _spellingCount = header.spellingCount;
+    _text = image + header.textOffset;
+    _textSize = header.textSize;
+    return true;
+  }
+};
+
+// MARK: - Incremental Chop Sessions
+
+/// 逐字元追加、退格的 chop 工作階段，給連續輸入簡拼或全拼的場合使用。
+///
+/// chop() 的切法是「從當前位置沿字首樹走到最深處」，故除最後一段以外，
+/// 每一段都是因為下一個字元走不下去才結束的：在尾端追加字元時，
+/// 只可能延長最後一段、或另起新的一段，前面的切割結果都不會變。
+/// 工作階段因此只需記住最後一段在字首樹上抵達的節點（前沿），
+/// 每次追加與退格都是 O(1)，與緩衝區的長度無關。
+///
+/// 任何時候的切割結果都與 CompactPinyinTrie::chop(buffer()) 完全相同。
+/// 注意：buffer() 與 segment() 所回傳的 string_view 會在下次追加之後失效。
+class ChopSession {
+ public:
+  explicit ChopSession(MandarinParser parser)
+      : ChopSession(CompactPinyinTrie::shared(parser)) {}
+  explicit ChopSession(const CompactPinyinTrie& trie) : _trie(&trie) {}
+
+  /// 在尾端追加一個字元。
+  void append(char c) {
+    uint32_t next = frontier() ? _trie->child(frontier(), c) : 0;
+    if (!next) {
+      // 最後一段走不下去了，從這個字元另起新的一段。
+      _segmentStarts.push_back(static_cast<uint32_t>(_buffer.size()));
+      next = _trie->child(0, c);
+    }
+    _buffer.push_back(c);
+    _frontiers.push_back(next);
+  }
+
+  /// 在尾端追加一串字元。
+  void append(std::string_view input) {
+    for (char c : input) append(c);
+  }
+
+  /// 刪去最後一個字元，切割結果退回到追加該字元之前的狀態。
+  /// @return 緩衝區原本就是空的話回傳 false。
+  bool backspace() {
+    if (_buffer.empty()) return false;
+    _buffer.pop_back();
+    _frontiers.pop_back();
+    if (_segmentStarts.back() == _buffer.size()) _segmentStarts.pop_back();
+    return true;
+  }
+
+  /// 以給定的字串取代整個緩衝區。
+  void assign(std::string_view input) {
+    clear();
+    append(input);
+  }
+
+  void clear() {
+    _buffer.clear();
+    _frontiers.clear();
+    _segmentStarts.clear();
+  }
+
+  const CompactPinyinTrie& trie() const { return *_trie; }
+  std::string_view buffer() const { return _buffer; }
+  bool empty() const { return _buffer.empty(); }
+  size_t segmentCount() const { return _segmentStarts.size(); }
+
+  /// 取得第 i 段切片。
+  std::string_view segment(size_t i) const {
+    size_t end = i + 1 < _segmentStarts.size() ? _segmentStarts[i + 1]
+                                                : _buffer.size();
+    return buffer().substr(_segmentStarts[i], end - _segmentStarts[i]);
+  }
+
+  /// 取得最後一段切片；緩衝區為空時回傳空值。
+  std::string_view lastSegment() const {
+    return empty() ? std::string_view() : segment(segmentCount() - 1);
+  }
+
+  /// 最後一段在字首樹上抵達的節點；該段已經無法再延長的話則為 0。
+  /// 該段恰好是完整讀音的話，trie().node(frontier()).reading 即為其讀音。
+  uint32_t frontier() const {
+    return _frontiers.empty() ? 0 : _frontiers.back();
+  }
+
+  /// 取得所有切片，結果與 CompactPinyinTrie::chop() 相同。
+  void segments(std::vector<std::string_view>& result) const {
+    result.clear();
+    for (size_t i = 0; i < segmentCount(); i++) result.push_back(segment(i));
+  }
+
+ private:
+  const CompactPinyinTrie* _trie;
+  std::string _buffer;
+  /// 第 i 格是追加第 i 個字元之後的前沿，退格時直接退回上一格。
+  std::vector<uint32_t> _frontiers;
+  std::vector<uint32_t> _segmentStarts;
+};
+
+// MARK: - Segmentation Lattice
+
+/// 拼音字串的切割網格：收錄輸入當中所有「能沿字首樹從根走到的」片段，
+/// 亦即每個完整讀音與每個讀音前綴（簡拼），以便列舉 chop() 之外的其他切法。
+///
+/// 比如「xian」除了 chop() 給出的 ["xian"] 以外，還能切成 ["xi", "an"]；
+/// 「fangan」則能切成 ["fan", "gan"] 或 ["fang", "an"]。
+///
+/// 建構時從每個位置沿字首樹往下走一遍，耗時與「輸入長度×最長讀音長度」成正比。
+/// 某位置連一個字元都走不動的話，則收錄一條單字元的「無法辨識」邊（與 chop()
+/// 相同），故從頭到尾必定至少有一條路徑。各邊按起點、再按終點排序存放。
+class ChopLattice {
+ public:
+  /// 網格上的一條邊，涵蓋輸入的 [begin, end)。
+  struct Edge {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    /// 該片段在字首樹上抵達的節點；無法辨識的片段則為 0。
+    uint32_t node = 0;
+    /// 片段恰好是完整讀音的話即為其讀音，否則為空。
+    PackedReading reading;
+
+    bool isSyllable() const { return !reading.isEmpty(); }
+    bool isUnknown() const { return node == 0; }
+  };
+
+  /// 一條從頭到尾的切割路徑。
+  struct Path {
+    double cost = 0;
+    /// 依序經過的邊在 edges() 當中的序號。
+    std::vector<uint32_t> edges;
+  };
+
+  ChopLattice(const CompactPinyinTrie& trie, std::string_view input)
+      : _trie(&trie), _input(input) {
+    _edgeStarts.reserve(_input.size() + 1);
+    for (size_t begin = 0; begin < _input.size(); begin++) {
+      _edgeStarts.push_back(static_cast<uint32_t>(_edges.size()));
+      uint32_t node = 0;
+      for (size_t end = begin; end < _input.size(); end++) {
+        node = trie.child(node, _input[end]);
+        if (!node) break;
+        Edge edge;
+        edge.begin = static_cast<uint32_t>(begin);
+        edge.end = static_cast<uint32_t>(end + 1);
+        edge.node = node;
+        edge.reading = trie.node(node).reading;
+        _edges.push_back(edge);
+      }
+      if (_edges.size() == _edgeStarts.back()) {
+        Edge edge;
+        edge.begin = static_cast<uint32_t>(begin);
+        edge.end = static_cast<uint32_t>(begin + 1);
+        _edges.push_back(edge);
+      }
+    }
+    _edgeStarts.push_back(static_cast<uint32_t>(_edges.size()));
+  }
+
+  const CompactPinyinTrie& trie() const { return *_trie; }
+  std::string_view input() const { return _input; }
+  ArrayView<Edge> edges() const {
+    return ArrayView<Edge>(_edges.data(), _edges.data() + _edges.size());
+  }
+
+  /// 取得從給定位置出發的所有邊（按終點由近到遠排列）。
+  ArrayView<Edge> edgesFrom(size_t position) const {
+    if (position >= _input.size()) return ArrayView<Edge>();
+    return ArrayView<Edge>(_edges.data() + _edgeStarts[position],
+                           _edges.data() + _edgeStarts[position + 1]);
+  }
+
+  /// 取得給定邊所涵蓋的片段（指向網格自己保存的輸入）。
+  std::string_view text(const Edge& edge) const {
+    return input().substr(edge.begin, edge.end - edge.begin);
+  }
+
+  /// 預設的邊權重（越小越好）：每段的基本成本為 1，
+  /// 不是完整讀音的前綴另加 0.5，無法辨識的字元另加 3。
+  /// 段數越少、完整讀音越多的切法越優先。
+  static double defaultWeight(const Edge& edge) {
+    if (edge.isUnknown()) return 4;
+    return edge.isSyllable() ? 1 : 1.5;
+  }
+
+  /// 按總成本由低到高列舉至多 k 條從頭到尾的路徑。
+  ///
+  /// 在網格上按位置順序做 k-best 動態規劃：每個位置只保留至多 k 條最佳的
+  /// 部分路徑，耗時約為「邊數×k×k」。總成本相同的路徑按出現的先後排列。
+  /// @param k 欲取得的路徑數量。
+  /// @param weight 邊的權重函式，簽名為 double(const ChopLattice::Edge&)。
+  /// 回傳無限大（或 NaN）的邊會被排除。
+  template <typename Weight>
+  std::vector<Path> bestPaths(size_t k, Weight&& weight) const {
+    // 部分路徑：總成本、最後一條邊、以及該邊起點上的名次（用於回溯）。
+    struct Partial {
+      double cost;
+      uint32_t edge;
+      uint32_t rank;
+    };
+    constexpr uint32_t noEdge = UINT32_MAX;
+    std::vector<Path> result;
+    if (k == 0) return result;
+    std::vector<std::vector<Partial>> best(_input.size() + 1);
+    best[0].push_back({0, noEdge, 0});
+    // 邊只會往後連，故處理到某位置時，抵達該位置的部分路徑皆已定案。
+    for (size_t position = 0; position < _input.size(); position++) {
+      const std::vector<Partial>& sources = best[position];
+      if (sources.empty()) continue;
+      for (uint32_t e = _edgeStarts[position]; e < _edgeStarts[position + 1];
+           e++) {
+        double edgeCost = weight(_edges[e]);
+        if (!(edgeCost < std::numeric_limits<double>::infinity())) continue;
+        std::vector<Partial>& targets = best[_edges[e].end];
+        for (uint32_t rank = 0; rank < sources.size(); rank++) {
+          double cost = sources[rank].cost + edgeCost;
+          // sources 已按成本排好，後面的只會更差。
+          if (targets.size() == k && !(cost < targets.back().cost)) break;
+          auto insertion = std::upper_bound(
+              targets.begin(), targets.end(), cost,
+              [](double lhs, const Partial& rhs) { return lhs < rhs.cost; });
+          targets.insert(insertion, {cost, e, rank});
+          if (targets.size() > k) targets.pop_back();
+        }
+      }
+    }
+    for (const Partial& last : best[_input.size()]) {
+      Path path;
+      path.cost = last.cost;
+      for (Partial current = last; current.edge != noEdge;) {
+        path.edges.push_back(current.edge);
+        current = best[_edges[current.edge].begin][current.rank];
+      }
+      std::reverse(path.edges.begin(), path.edges.end());
+      result.push_back(std::move(path));
+    }
+    return result;
+  }
+
+  /// 以 defaultWeight() 列舉至多 k 條路徑。
+  std::vector<Path> bestPaths(size_t k) const {
+    return bestPaths(k, defaultWeight);
+  }
+
+  /// 取得路徑上的各個切片。
+  void segments(const Path& path, std::vector<std::string_view>& result) const {
+    result.clear();
+    for (uint32_t e : path.edges) result.push_back(text(_edges[e]));
+  }
+
+ private:
+  const CompactPinyinTrie* _trie;
+  std::string _input;
+  std::vector<Edge> _edges;
+  /// 從位置 i 出發的邊是 _edges[_edgeStarts[i], _edgeStarts[i + 1])。
+  std::vector<uint32_t> _edgeStarts;
+};
+
+// MARK: - Key Sequence Cache
+
+/// 非拼音排列的擊鍵序列快取：記錄「注音排列、糾正與 CSV 順序開關、擊鍵序列」
+/// 所對應的最終讀音，供 Composer::receiveSequence() 直接重播。
+///
+/// 快取預設停用，需以 setCapacity() 啟用。每個擊鍵序列按雜湊值固定對應到
+/// 一個槽位，新的序列會直接蓋掉舊的，故記憶體用量有上限。
+/// 超過 maxSequenceLength 的擊鍵序列不會被快取。
+///
+/// 該類型可以跨執行緒共用，且查詢與記錄皆不上鎖：每個槽位各自帶有一個
+/// 序號鎖（seqlock），讀取時若撞上寫入中的槽位便視為未命中，兩個執行緒同時
+/// 寫入同一槽位時則由後到者放棄。快取的內容只是可重算的結果，故這樣的取捨
+/// 不影響正確性。
+class KeySequenceCache {
+ public:
+  static constexpr size_t maxSequenceLength = 15;
+
+  /// 取得所有 Composer 共用的快取實例。
+  static KeySequenceCache& shared() {
+    static KeySequenceCache instance;
+    return instance;
+  }
+
+  /// 設定槽位數（會進位到 2 的冪），並清空快取與統計；0 表示停用。
+  ///
+  /// 其他執行緒可能仍在使用先前的槽位陣列，故換下的陣列會保留到快取解構時
+  /// 才釋放；同一尺寸的陣列只會配置一次、再次選用時清空沿用，
+  /// 故總用量不超過曾設定過的最大槽位數的兩倍。
+  void setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(_configMutex);
+    size_t rounded = 0;
+    size_t level = 0;
+    if (capacity) {
+      rounded = 1;
+      while (rounded < capacity) {
+        rounded <<= 1;
+        level++;
+      }
+    }
+    Table* table = nullptr;
+    if (rounded) {
+      std::unique_ptr<Table>& owned = _tables[level];
+      if (owned) {
+        for (size_t i = 0; i < owned->size; i++) _write(owned->slots[i], {});
+      } else {
+        owned = std::make_unique<Table>(rounded);
+      }
+      table = owned.get();
+    }
+    _table.store(table, std::memory_order_release);
+    for (Counter& counter : _counters) {
+      counter.hits.store(0, std::memory_order_relaxed);
+      counter.misses.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  size_t capacity() const {
+    const Table* table = _table.load(std::memory_order_acquire);
+    return table ? table->size : 0;
+  }
+  bool isEnabled() const { return capacity() != 0; }
+  uint64_t hits() const {
+    uint64_t result = 0;
+    for (const Counter& counter : _counters)
+      result += counter.hits.load(std::memory_order_relaxed);
+    return result;
+  }
+  uint64_t misses() const {
+    uint64_t result = 0;
+    for (const Counter& counter : _counters)
+      result += counter.misses.load(std::memory_order_relaxed);
+    return result;
+  }
+
+  /// 查詢擊鍵序列的最終讀音。
+  /// @param parser 注音排列。
+  /// @param flags 糾正與 CSV 順序開關，參見 Composer::receiveSequence()。
+  /// @param sequence 擊鍵序列。
+  /// @return 有快取時回傳該讀音，否則回傳空值並計為一次未命中。
+  std::optional<PackedReading> find(MandarinParser parser, uint8_t flags,
+                                    std::string_view sequence) {
+    if (sequence.size() > maxSequenceLength) return std::nullopt;
+    Table* table = _table.load(std::memory_order_acquire);
+    if (!table) return std::nullopt;
+    Record key = _recordOf(parser, flags, sequence, PackedReading());
+    size_t index = _slotOf(parser, flags, sequence) & (table->size - 1);
+    Slot& slot = table->slots[index];
+    Counter& counter = _counters[index % _counters.size()];
+    uint32_t before = slot.sequence.load(std::memory_order_acquire);
+    if (!(before & 1)) {
+      Record found;
+      for (size_t i = 0; i < found.words.size(); i++)
+        found.words[i] = slot.words[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) == before &&
+          found.matches(key)) {
+        counter.hits.fetch_add(1, std::memory_order_relaxed);
+        return found.reading();
+      }
+    }
+    counter.misses.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+
+  /// 記下擊鍵序列的最終讀音。
+  void store(MandarinParser parser, uint8_t flags, std::string_view sequence,
+             PackedReading reading) {
+    if (sequence.size() > maxSequenceLength) return;
+    Table* table = _table.load(std::memory_order_acquire);
+    if (!table) return;
+    size_t index = _slotOf(parser, flags, sequence) & (table->size - 1);
+    _write(table->slots[index], _recordOf(parser, flags, sequence, reading));
+  }
+
+ private:
+  /// 槽位內容：前兩個字組是擊鍵序列（末位元組為長度），第三個字組依序是
+  /// 佔用旗標、注音排列、開關、讀音。
+  struct Record {
+    std::array<uint64_t, 3> words{};
+
+    static constexpr uint64_t tagMask = 0xFFFFFFFF;
+
+    bool matches(const Record& key) const {
+      return words[0] == key.words[0] && words[1] == key.words[1] &&
+             (words[2] & tagMask) == (key.words[2] & tagMask);
+    }
+    PackedReading reading() const {
+      return PackedReading(static_cast<uint16_t>(words[2] >> 32));
+    }
+  };
+
+  /// 單個槽位：序號為奇數時表示正在寫入。
+  struct alignas(32) Slot {
+    std::atomic<uint32_t> sequence{0};
+    std::array<std::atomic<uint64_t>, 3> words{};
+  };
+
+  struct Table {
+    size_t size;
+    std::unique_ptr<Slot[]> slots;
+
+    explicit Table(size_t theSize)
+        : size(theSize), slots(std::make_unique<Slot[]>(theSize)) {}
+  };
+
+  /// 命中統計按槽位分散到多組計數器，免得所有執行緒擠在同一條快取行上。
+  struct alignas(64) Counter {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+  };
+
+  static Record _recordOf(MandarinParser parser, uint8_t flags,
+                          std::string_view sequence, PackedReading reading) {
+    char keys[16] = {};
+    sequence.copy(keys, sequence.size());
+    keys[15] = static_cast<char>(sequence.size());
+    Record result;
+    std::memcpy(result.words.data(), keys, sizeof(keys));
+    result.words[2] = 1 | static_cast<uint64_t>(parser & 0xFF) << 8 |
+                      static_cast<uint64_t>(flags) << 16 |
+                      static_cast<uint64_t>(reading.raw) << 32;
+    return result;
+  }
+
+  /// 以序號鎖寫入槽位；槽位正被其他執行緒寫入的話就放棄。
+  static void _write(Slot& slot, const Record& record) {
+    uint32_t before = slot.sequence.load(std::memory_order_relaxed);
+    if ((before & 1) ||
+        !slot.sequence.compare_exchange_strong(before, before + 1,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed))
+      return;
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < record.words.size(); i++)
+      slot.words[i].store(record.words[i], std::memory_order_relaxed);
+    slot.sequence.store(before + 2, std::memory_order_release);
+  }
+
+  static size_t _slotOf(MandarinParser parser, uint8_t flags,
+                        std::string_view sequence) {
+    uint32_t seed = static_cast<uint32_t>(parser) << 8 | flags;
+    return _syllableHash(sequence, seed);
+  }
+
+  std::mutex _configMutex;
+  std::array<std::unique_ptr<Table>, std::numeric_limits<size_t>::digits>
+      _tables;
+  std::atomic<Table*> _table{nullptr};
+  std::array<Counter, 16> _counters;
+};
+
+// MARK: - Composer
+
+class Composer {
+ public:
+  // 聲介韻調。寫這樣囉唆是為了直接在這裡初期化。
+  // 注意：這些為公開唯讀，不應直接修改。
+  // 使用 receiveKey()、receiveSequence() 或 clear() 來修改組字器狀態。
+  Phonabet consonant = Phonabet(), semivowel = Phonabet(), vowel = Phonabet(),
+           intonation = Phonabet();
+
+  /// 為拉丁字母專用的組音區。
+  /// 注意：此為公開唯讀，不應直接修改。
+  std::string romajiBuffer;
+
+  /// 注音排列種類。預設情況下是大千排列（Windows / macOS 預設注音排列）。
+  /// 注意：此為公開唯讀。使用 ensureParser() 來變更解析器。
+  MandarinParser parser = ofDachen;
 
   /// 是否對錯誤的注音讀音組合做出自動糾正處理。
   bool phonabetCombinationCorrectionEnabled;
@@ -1731,13 +4713,19 @@ class Composer {
   /// 當 phonabet 槽位變更時設為 true，讀取 romajiBuffer 前若為 true 則先重建。
   bool _needsRomajiUpdate = true;
 
+  /// 拼音組音區在字首樹上的游標：第 i 格是 romajiBuffer 的前 i+1 個字元
+  /// 所抵達的節點（0 表示已經走出字首樹）。擊鍵時前進一格、退格時退回一格。
+  std::array<uint32_t, 8> _romajiPath{};
+  size_t _romajiPathDepth = 0;
+  /// 游標是否與 romajiBuffer 一致；組音區被整個換掉之後需要重走一遍。
+  bool _romajiPathSynced = false;
+  /// 游標所屬的字首樹，會在切換注音排列時失效。
+  const CompactPinyinTrie* _romajiTrie = nullptr;
+
   /// 內容值，會直接按照正確的順序拼裝自己的聲介韻調內容、再回傳。
   /// 注意：直接取這個參數的內容的話，陰平聲調會成為一個空格。
   /// 如果是要取不帶空格的注音的話，請使用「.getComposition()」而非「.Value」。
-  std::string value() {
-    return consonant.value() + semivowel.value() + vowel.value() +
-           intonation.value();
-  };
+  std::string value() { return packedReading().value(); };
 
   /// 當前注拼槽是否處於拼音模式。
   bool isPinyinMode() { return parser >= 100; }
@@ -1746,11 +4734,7 @@ class Composer {
   ///
   /// @param withIntonation 是否統計聲調。
   int count(bool withIntonation = false) {
-    int result = (intonation.isValid() && withIntonation) ? 1 : 0;
-    result += consonant.isValid() ? 1 : 0;
-    result += semivowel.isValid() ? 1 : 0;
-    result += vowel.isValid() ? 1 : 0;
-    return result;
+    return packedReading().count(withIntonation);
   }
 
   /// 與 value 類似，這個函式就是用來決定輸入法組字區內顯示的注音/拼音內容，
@@ -1786,26 +4770,10 @@ class Composer {
   std::string getInlineCompositionForDisplay(bool isHanyuPinyin = false) {
     _refreshRomajiBufferIfNeeded();
     if (!isPinyinMode()) return getComposition(isHanyuPinyin);
-    std::string result;
-    std::string toneReturned;
-    switch (hashify(intonation.value().c_str())) {
-      case hashify(" "):
-        toneReturned = "1";
-        break;
-      case hashify("ˊ"):
-        toneReturned = "2";
-        break;
-      case hashify("ˇ"):
-        toneReturned = "3";
-        break;
-      case hashify("ˋ"):
-        toneReturned = "4";
-        break;
-      case hashify("˙"):
-        toneReturned = "5";
-        break;
-    }
-    result = romajiBuffer + toneReturned;
+    std::string result = romajiBuffer;
+    // 聲調索引依序對應「 」「ˊ」「ˇ」「ˋ」「˙」，恰為數字調號 1-5。
+    uint8_t tone = packedReading().intonationIndex();
+    if (tone) result += static_cast<char>('0' + tone);
     replaceOccurrences(result, "v", "ü");
     return result;
   }
@@ -1813,14 +4781,17 @@ class Composer {
   /// 注拼槽內容是否為空。
   bool isEmpty() {
     if (isPinyinMode()) return intonation.isEmpty() && romajiBuffer.empty();
-    return consonant.isEmpty() && semivowel.isEmpty() && vowel.isEmpty() &&
-           intonation.isEmpty();
+    return packedReading().isEmpty();
   }
 
   /// 注拼槽內容是否可唸。
-  bool isPronounceable() {
-    return !vowel.isEmpty() || !semivowel.isEmpty() || !consonant.isEmpty();
-  }
+  bool isPronounceable() { return packedReading().isPronounceable(); }
+
+  /// 注拼槽內容（不計聲調）是否為實際存在的國語音節。
+  ///
+  /// 與 isPronounceable() 不同，這會排除「ㄅㄩ」這類湊不成音節的中間狀態，
+  /// 可在查詢辭典之前先行過濾掉不可能有結果的讀音。
+  bool isValidSyllable() { return packedReading().isValidSyllable(); }
 
   /// 描述連續拼音輸入在當前拍次應如何自動 chop 的結果。
   struct PinyinAutoChopResult {
@@ -1860,6 +4831,8 @@ class Composer {
     intonation.clear();
     romajiBuffer.clear();
     _needsRomajiUpdate = false;
+    _romajiPathDepth = 0;
+    _romajiPathSynced = true;
   }
 
   /// 用於檢測「某個輸入字元訊號的合規性」的函式。
@@ -1868,8 +4841,20 @@ class Composer {
   ///
   /// @param inputCharCode 傳入的 charCode 內容。
   [[nodiscard]] bool inputValidityCheck(char inputCharCode) {
-    std::string inputKey(1, inputCharCode);
-    return ((int)inputCharCode < 128) && inputValidityCheckStr(inputKey);
+    if (static_cast<unsigned char>(inputCharCode) >= 128) return false;
+    switch (parser) {
+      case ofWadeGilesPinyin:
+        return mapWadeGilesPinyinKeys.find(inputCharCode) !=
+               std::string_view::npos;
+      case ofHanyuPinyin:
+      case ofSecondaryPinyin:
+      case ofYalePinyin:
+      case ofHualuoPinyin:
+      case ofUniversalPinyin:
+        return mapArayuruPinyin.find(inputCharCode) != std::string_view::npos;
+      default:
+        return lookupAsciiKey(parser, inputCharCode) != 0;
+    }
   }
 
   /// 用於檢測「某個輸入字元訊號的合規性」的函式。
@@ -1878,43 +4863,22 @@ class Composer {
   ///
   /// @param charStr 傳入的字元（String）。
   [[nodiscard]] bool inputValidityCheckStr(std::string charStr) {
+    // 單個字元的情形直接查 ASCII 表，不必經過 std::map。
+    if (charStr.size() == 1) return inputValidityCheck(charStr[0]);
+    if (charStr.empty()) return false;
     switch (parser) {
-      case ofDachen:
-        return mapQwertyDachen.find(charStr) != mapQwertyDachen.end();
-      case ofDachen26:
-        return mapDachenCP26StaticKeys.find(charStr) !=
-               mapDachenCP26StaticKeys.end();
-      case ofETen:
-        return mapQwertyETenTraditional.find(charStr) !=
-               mapQwertyETenTraditional.end();
-      case ofHsu:
-        return mapHsuStaticKeys.find(charStr) != mapHsuStaticKeys.end();
-      case ofETen26:
-        return mapETen26StaticKeys.find(charStr) != mapETen26StaticKeys.end();
-      case ofIBM:
-        return mapQwertyIBM.find(charStr) != mapQwertyIBM.end();
-      case ofMiTAC:
-        return mapQwertyMiTAC.find(charStr) != mapQwertyMiTAC.end();
-      case ofSeigyou:
-        return mapSeigyou.find(charStr) != mapSeigyou.end();
-      case ofFakeSeigyou:
-        return mapFakeSeigyou.find(charStr) != mapFakeSeigyou.end();
-      case ofStarlight:
-        return mapStarlightStaticKeys.find(charStr) !=
-               mapStarlightStaticKeys.end();
-      case ofAlvinLiu:
-        return mapAlvinLiuStaticKeys.find(charStr) !=
-               mapAlvinLiuStaticKeys.end();
       case ofWadeGilesPinyin:
-        return stringInclusion(mapWadeGilesPinyinKeys, charStr);
+        return mapWadeGilesPinyinKeys.find(charStr) != std::string_view::npos;
       case ofHanyuPinyin:
       case ofSecondaryPinyin:
       case ofYalePinyin:
       case ofHualuoPinyin:
       case ofUniversalPinyin:
-        return stringInclusion(mapArayuruPinyin, charStr);
+        return mapArayuruPinyin.find(charStr) != std::string_view::npos;
+      default:
+        // 注音排列的按鍵都是單個字元。
+        return false;
     }
-    return false;
   }
 
   /// 自我變換單個注音資料值。
@@ -1947,12 +4911,12 @@ class Composer {
   /// @return 若按鍵被接受則為 true，被拒絕則為 false。
   bool receiveKey(std::string input) {
     if (!isPinyinMode()) {
+      if (input.size() == 1) return receiveKey(input[0]);
       return receiveKeyFromPhonabet(translate(input));
     }
-    int maxCount;
-    if (mapArayuruPinyinIntonation.count(input)) {
-      std::string theTone = mapArayuruPinyinIntonation[input];
-      intonation = Phonabet(theTone);
+    size_t maxCount;
+    if (auto theTone = _arayuruPinyinIntonationTable.view().find(input)) {
+      intonation = Phonabet(std::string(*theTone));
     } else {
       // 為了防止 RomajiBuffer 越敲越長帶來算力負擔，
       // 這裡讓它在要溢出時自動丟掉最早輸入的音頭。
@@ -1960,10 +4924,17 @@ class Composer {
       maxCount = (parser == ofWadeGilesPinyin) ? 7 : 6;
       if (romajiBuffer.length() > maxCount - 1) {
         romajiBuffer.erase(0, 1);
+        // 開頭變了，游標得重走一遍（至多 maxCount 步）。
+        _romajiPathSynced = false;
       }
-      std::string romajiBufferBackup = romajiBuffer + input;
-      receiveSequence(romajiBufferBackup, true);
-      romajiBuffer = romajiBufferBackup;
+      if (!_romajiPathSynced || !_romajiTrie) _syncRomajiPath();
+      for (char c : input) _stepRomajiPath(c);
+      romajiBuffer += input;
+      uint32_t node = _romajiPathSynced && _romajiPathDepth
+                          ? _romajiPath[_romajiPathDepth - 1]
+                          : 0;
+      _receivePinyinReading(node ? _romajiTrie->node(node).reading
+                                 : PackedReading());
       _needsRomajiUpdate = false;
     }
     return true;
@@ -1976,7 +4947,41 @@ class Composer {
   ///
   /// @param input 傳入的 UniChar 內容。
   /// @return 若按鍵被接受則為 true，被拒絕則為 false。
-  bool receiveKey(char input) { return receiveKey((charToString(input))); };
+  bool receiveKey(char input) {
+    // 靜態注音排列直接查 ASCII 表，全程不建立任何字串。
+    switch (parser) {
+      case ofDachen:
+      case ofETen:
+      case ofIBM:
+      case ofMiTAC:
+      case ofSeigyou:
+      case ofFakeSeigyou: {
+        char32_t phonabet = lookupAsciiKey(parser, input);
+        return phonabet ? receiveKeyFromPhonabet(phonabet) : true;
+      }
+      default:
+        break;
+    }
+    // 動態注音排列查狀態轉移表。
+    // 狀態轉移表不處理 enforceCSVTOrdering 的拒絕情形，此時改走原始流程。
+    if (!isPinyinMode() && !enforceCSVTOrdering) {
+      DynamicLayoutTransitionTable* table =
+          _transitionTable(parser, phonabetCombinationCorrectionEnabled);
+      if (table) {
+        PackedReading oldState = packedReading();
+        uint16_t state = DynamicLayoutTransitionTable::stateIndex(oldState);
+        uint32_t cell =
+            _transit(*table, parser, phonabetCombinationCorrectionEnabled,
+                     state, table->slotOf(input));
+        PackedReading newState = DynamicLayoutTransitionTable::newState(cell);
+        if (newState != oldState) setPackedReading(newState);
+        return true;
+      }
+    }
+    std::string inputStr = charToString(input);
+    if (isPinyinMode()) return receiveKey(inputStr);
+    return receiveKeyFromPhonabet(translate(inputStr));
+  };
 
   /// 接受傳入的按鍵訊號時的處理，處理對象為單個注音符號。
   /// 主要就是將注音符號拆分辨識且分配到正確的貯存位置而已。
@@ -1990,80 +4995,16 @@ class Composer {
   bool receiveKeyFromPhonabet(char32_t phonabet) {
     Phonabet thePhone = Phonabet(phonabet);
     if (phonabetCombinationCorrectionEnabled) {
-      switch (phonabet) {
-        case U'ㄧ':
-        case U'ㄩ':
-          if (vowel.scalar() == U'ㄜ') vowel = Phonabet(U'ㄝ');
-          break;
-        case U'ㄜ':
-          if (semivowel.scalar() == U'ㄨ') semivowel = Phonabet(U'ㄩ');
-          if (semivowel.scalar() == U'ㄧ' || semivowel.scalar() == U'ㄩ')
-            thePhone = Phonabet(U'ㄝ');
-          break;
-        case U'ㄝ':
-          if (semivowel.scalar() == U'ㄨ') semivowel = Phonabet(U'ㄩ');
-          break;
-        case U'ㄛ':
-          if (semivowel.scalar() == U'ㄩ') semivowel = Phonabet(U'ㄨ');
-          if ((consonant.scalar() == U'ㄅ' || consonant.scalar() == U'ㄆ' ||
-               consonant.scalar() == U'ㄇ' || consonant.scalar() == U'ㄈ') &&
-              semivowel.scalar() == U'ㄨ')
-            semivowel.clear();
-          break;
-        case U'ㄥ':
-          if ((consonant.scalar() == U'ㄅ' || consonant.scalar() == U'ㄆ' ||
-               consonant.scalar() == U'ㄇ' || consonant.scalar() == U'ㄈ') &&
-              semivowel.scalar() == U'ㄨ')
-            semivowel.clear();
-          break;
-        case U'ㄟ':
-          if ((consonant.scalar() == U'ㄋ' || consonant.scalar() == U'ㄌ') &&
-              (semivowel.scalar() == U'ㄨ'))
-            semivowel.clear();
-          break;
-        case U'ㄨ':
-          if ((consonant.scalar() == U'ㄅ' || consonant.scalar() == U'ㄆ' ||
-               consonant.scalar() == U'ㄇ' || consonant.scalar() == U'ㄈ') &&
-              (vowel.scalar() == U'ㄛ' || vowel.scalar() == U'ㄥ'))
-            vowel.clear();
-          if ((consonant.scalar() == U'ㄋ' || consonant.scalar() == U'ㄌ') &&
-              (vowel.scalar() == U'ㄟ'))
-            vowel.clear();
-          if (vowel.scalar() == U'ㄜ') vowel = Phonabet(U'ㄝ');
-          if (vowel.scalar() == U'ㄝ') thePhone = Phonabet(U'ㄩ');
-          break;
-        case U'ㄅ':
-        case U'ㄆ':
-        case U'ㄇ':
-        case U'ㄈ':
-          if ((semivowel.scalar() == U'ㄨ' && vowel.scalar() == U'ㄛ') ||
-              (semivowel.scalar() == U'ㄨ' && vowel.scalar() == U'ㄥ'))
-            semivowel.clear();
-          break;
-        default:
-          break;
-      }
-      if ((thePhone.type == PhoneType::vowel ||
-           thePhone.type == PhoneType::intonation) &&
-          (consonant.scalar() == U'ㄓ' || consonant.scalar() == U'ㄔ' ||
-           consonant.scalar() == U'ㄕ' || consonant.scalar() == U'ㄗ' ||
-           consonant.scalar() == U'ㄘ' || consonant.scalar() == U'ㄙ')) {
-        switch (semivowel.scalar()) {
-          case U'ㄧ':
-            semivowel.clear();
-            break;
-          case U'ㄩ':
-            if (consonant.scalar() == U'ㄓ' || consonant.scalar() == U'ㄗ')
-              consonant = Phonabet(U'ㄐ');
-            if (consonant.scalar() == U'ㄔ' || consonant.scalar() == U'ㄘ')
-              consonant = Phonabet(U'ㄑ');
-            if (consonant.scalar() == U'ㄕ' || consonant.scalar() == U'ㄙ')
-              consonant = Phonabet(U'ㄒ');
-            break;
-          default:
-            break;
-        }
+      // 並擊糾正直接查編譯期生成的表。
+      PackedReading current = packedReading();
+      uint32_t cell = _correctCombination(current, phonabet);
+      PackedReading corrected = DynamicLayoutTransitionTable::newState(cell);
+      if (corrected != current) {
+        consonant = Phonabet(corrected.consonant());
+        semivowel = Phonabet(corrected.semivowel());
+        vowel = Phonabet(corrected.vowel());
       }
+      thePhone = Phonabet(DynamicLayoutTransitionTable::emittedPhonabet(cell));
     }
 
     // 個別情形需強制聲介韻調的輸入順序。
@@ -2137,51 +5078,78 @@ class Composer {
 
   /// 處理一連串的按鍵輸入、且返回被處理之後的注音（陰平為空格）。
   ///
+  /// 非拼音排列的場合，若已啟用 KeySequenceCache，則會優先查詢快取。
+  ///
   /// @param givenSequence 傳入的 String 內容，用以處理一整串擊鍵輸入。
   /// @param isRomaji 若輸入的字串是基於西文字母的各種拼音的話，請啟用此選項。
   std::string receiveSequence(std::string givenSequence = "",
                               bool isRomaji = false) {
     clear();
     if (!isRomaji) {
+      // 同樣的擊鍵序列從空白狀態開始，結果必然相同，故可以查快取。
+      KeySequenceCache& cache = KeySequenceCache::shared();
+      bool cacheable = !isPinyinMode() && cache.isEnabled();
+      uint8_t flags = (phonabetCombinationCorrectionEnabled ? 1 : 0) |
+                      (enforceCSVTOrdering ? 2 : 0);
+      if (cacheable) {
+        if (auto cached = cache.find(parser, flags, givenSequence)) {
+          setPackedReading(*cached);
+          return value();
+        }
+      }
       // 使用 for 迴圈，以利 enforceCSVTOrdering 拒絕時提前終止。
       for (char key : givenSequence) {
         if (!receiveKey(key)) break;
       }
+      if (cacheable) cache.store(parser, flags, givenSequence, packedReading());
       return value();
     }
-    std::vector<std::string> dictResult = {};
-    switch (parser) {
-      case ofHanyuPinyin:
-        if (mapHanyuPinyin.count(givenSequence))
-          dictResult = splitByCodepoint(mapHanyuPinyin[givenSequence]);
-        break;
-      case ofSecondaryPinyin:
-        if (mapSecondaryPinyin.count(givenSequence))
-          dictResult = splitByCodepoint(mapSecondaryPinyin[givenSequence]);
-        break;
-      case ofYalePinyin:
-        if (mapYalePinyin.count(givenSequence))
-          dictResult = splitByCodepoint(mapYalePinyin[givenSequence]);
-        break;
-      case ofHualuoPinyin:
-        if (mapHualuoPinyin.count(givenSequence))
-          dictResult = splitByCodepoint(mapHualuoPinyin[givenSequence]);
-        break;
-      case ofUniversalPinyin:
-        if (mapUniversalPinyin.count(givenSequence))
-          dictResult = splitByCodepoint(mapUniversalPinyin[givenSequence]);
-        break;
-      case ofWadeGilesPinyin:
-        if (mapWadeGilesPinyin.count(givenSequence))
-          dictResult = splitByCodepoint(mapWadeGilesPinyin[givenSequence]);
-        break;
-      default:
-        break;
-    }
-    for (std::string phonabet : dictResult) receiveKeyFromPhonabet(phonabet);
+    const SyllableHashView::Slot* slot =
+        pinyinSyllableHash(parser).find(givenSequence);
+    if (slot != nullptr) _receivePinyinReading(slot->reading);
     return value();
   }
 
+  /// 將一整串擊鍵（例如一整句話）切分成多個讀音，於聲調處與各排列的
+  /// 斷字處斷開。
+  ///
+  /// 注音排列的場合，等同於以單個 Composer 逐鍵處理、每逢聲調便收下讀音並清空；
+  /// 各排列的聲調按鍵（包括倚天二十六鍵等排列當中兼作聲調的字母鍵）皆由該排列
+  /// 自行判定。此外，若某個按鍵所對應的注音符號要填入的槽位已經有內容
+  /// （例如「ㄋㄧ」之後再來一個聲母），則先收下既有的讀音、再以該按鍵起頭。
+  ///
+  /// 拼音排列的場合，兩個聲調之間的字母串會沿字首樹切分成多個音節
+  /// （每段取最長的完整音節），聲調只套用到最後一個音節上；
+  /// 例如「nihao3」會切成「ㄋㄧ」與「ㄏㄠˇ」。湊不成音節的切片會被略過。
+  ///
+  /// 整個過程重複使用同一個 Composer，每個讀音不會另行配置記憶體。
+  /// 只有聲調而無聲介韻的讀音會被略過；結尾處未帶聲調的讀音也會被收下。
+  ///
+  /// @param keys 擊鍵串。
+  /// @param arrange 注音排列。
+  /// @param result 用來接收結果的陣列，會先被清空。
+  /// @param correction 是否對錯誤的注音讀音組合做出自動糾正處理。
+  static void parseKeyStream(std::string_view keys, MandarinParser arrange,
+                             std::vector<PackedReading>& result,
+                             bool correction = false) {
+    result.clear();
+    _parseKeyStream(keys, arrange, correction,
+                    [&result](PackedReading reading) {
+                      result.push_back(reading);
+                    });
+  }
+
+  /// 同上，但回傳讀音序號（參見 PackedReading::readingID()）。
+  static void parseKeyStream(std::string_view keys, MandarinParser arrange,
+                             std::vector<uint16_t>& result,
+                             bool correction = false) {
+    result.clear();
+    _parseKeyStream(keys, arrange, correction,
+                    [&result](PackedReading reading) {
+                      result.push_back(reading.readingID());
+                    });
+  }
+
   /// 專門用來響應使用者摁下 BackSpace 按鍵時的行為。
   /// 刪除順序：調、韻、介、聲。
   ///
@@ -2194,6 +5162,11 @@ class Composer {
       } else {
         romajiBuffer.pop_back();
         _needsRomajiUpdate = false;
+        if (_romajiPathSynced && _romajiPathDepth) {
+          _romajiPathDepth--;
+        } else {
+          _romajiPathSynced = false;
+        }
       }
     } else if (!intonation.isEmpty()) {
       intonation.clear();
@@ -2217,97 +5190,32 @@ class Composer {
     if (!isPinyinMode() || !intonation.isEmpty()) return std::nullopt;
     if (input.empty()) return std::nullopt;
     if (!inputValidityCheckStr(input)) return std::nullopt;
-    if (mapArayuruPinyinIntonation.count(input)) return std::nullopt;
+    if (_arayuruPinyinIntonationTable.view().contains(input))
+      return std::nullopt;
 
-    const std::map<std::string, std::string>* readingMap = nullptr;
-    switch (parser) {
-      case ofHanyuPinyin:
-        readingMap = &mapHanyuPinyin;
-        break;
-      case ofSecondaryPinyin:
-        readingMap = &mapSecondaryPinyin;
-        break;
-      case ofYalePinyin:
-        readingMap = &mapYalePinyin;
-        break;
-      case ofHualuoPinyin:
-        readingMap = &mapHualuoPinyin;
-        break;
-      case ofUniversalPinyin:
-        readingMap = &mapUniversalPinyin;
-        break;
-      case ofWadeGilesPinyin:
-        readingMap = &mapWadeGilesPinyin;
-        break;
-      default:
-        return std::nullopt;
-    }
+    const StringPairTable readingTable = pinyinReadingTable(parser);
+    if (readingTable.empty()) return std::nullopt;
 
+    // 延伸後仍是單一可唸讀音的話，就不需要 chop。
+    // 讀音表內的每個條目都能組出可唸讀音，故直接查表即可，
+    // 不必另起一個注拼槽來驗證。
     std::string appended = romajiBuffer + input;
-    Composer validationComposer = *this;
-    validationComposer.clear();
-    validationComposer.receiveSequence(appended, true);
-    if (validationComposer.isPronounceable()) return std::nullopt;
-
-    // Build allPossibleReadings inline (sorted by length descending)
-    std::vector<std::string> allPossibleReadings;
-    for (const auto& pair : *readingMap) {
-      allPossibleReadings.push_back(pair.first);
-    }
-    std::sort(allPossibleReadings.begin(), allPossibleReadings.end(),
-              [](const std::string& a, const std::string& b) {
-                if (a.length() != b.length()) {
-                  return a.length() > b.length();
-                }
-                return a > b;
-              });
-
-    // Chop algorithm inline
-    std::vector<std::string> chopped;
-    int complexLength = static_cast<int>(appended.length());
-    int longestReadingLength =
-        allPossibleReadings.empty()
-            ? 1
-            : static_cast<int>(allPossibleReadings[0].length());
-    int maxScopeSize = std::min(complexLength, longestReadingLength);
-    int currentPosition = 0;
-
-    while (currentPosition < complexLength) {
-      bool foundMatch = false;
-      int longPossibleScopeSize =
-          std::min(maxScopeSize, complexLength - currentPosition);
-
-      for (int scopeSize = longPossibleScopeSize; scopeSize >= 1; scopeSize--) {
-        std::string currentBlob = appended.substr(currentPosition, scopeSize);
-        for (const auto& currentReading : allPossibleReadings) {
-          if (currentReading.find(currentBlob) == 0) {
-            chopped.push_back(currentBlob);
-            currentPosition += scopeSize;
-            foundMatch = true;
-            break;
-          }
-        }
-        if (foundMatch) break;
-      }
-
-      if (!foundMatch) {
-        chopped.push_back(appended.substr(currentPosition, 1));
-        currentPosition++;
-      }
-    }
+    if (readingTable.contains(appended)) return std::nullopt;
 
+    // 切割交給共用的 CompactPinyinTrie，
+    // 不必每拍都重建並排序整個讀音清單。
+    std::vector<std::string_view> chopped;
+    CompactPinyinTrie::shared(parser).chop(appended, chopped);
     if (chopped.size() < 2) return std::nullopt;
 
-    std::string remainingRomaji = chopped.back();
-    std::vector<std::string> leadingSlices(chopped.begin(), chopped.end() - 1);
-    if (leadingSlices.empty()) return std::nullopt;
-
     std::vector<std::string> committedReadings;
-    for (const std::string& slice : leadingSlices) {
-      auto it = readingMap->find(slice);
-      if (it == readingMap->end()) return std::nullopt;
-      committedReadings.push_back(it->second);
+    committedReadings.reserve(chopped.size() - 1);
+    for (size_t i = 0; i + 1 < chopped.size(); i++) {
+      auto reading = readingTable.find(chopped[i]);
+      if (!reading) return std::nullopt;
+      committedReadings.emplace_back(*reading);
     }
+    std::string remainingRomaji(chopped.back());
 
     PinyinAutoChopResult result;
     result.committedReadings = committedReadings;
@@ -2324,31 +5232,269 @@ class Composer {
     receiveSequence(romaji, true);
     romajiBuffer = romaji;
     _needsRomajiUpdate = false;
+    _romajiPathSynced = false;
   }
 
   /// 用來檢測是否有調號的函式，預設情況下不判定聲調以外的內容的存無。
   ///
   /// @param withNothingElse 追加判定「槽內是否僅有調號」。
   bool hasIntonation(bool withNothingElse = false) {
-    return withNothingElse ? (!intonation.isEmpty() && vowel.isEmpty() &&
-                              semivowel.isEmpty() && consonant.isEmpty())
-                           : !intonation.isEmpty();
+    return packedReading().hasIntonation(withNothingElse);
+  }
+
+  /// 將聲介韻調壓縮成單個 PackedReading 整數，可用作注拼槽的快照。
+  ///
+  /// 各槽位的 Phonabet 已於賦值時記下自身的索引，故這裡只是幾次位元運算；
+  /// count()、isEmpty()、isPronounceable()、hasIntonation() 與 value()
+  /// 皆經由這個整數求值。
+  PackedReading packedReading() {
+    return PackedReading(static_cast<uint16_t>(
+        _slotIndex(consonant, PhoneType::consonant) |
+        (_slotIndex(semivowel, PhoneType::semivowel) << 5) |
+        (_slotIndex(vowel, PhoneType::vowel) << 7) |
+        (_slotIndex(intonation, PhoneType::intonation) << 11)));
+  }
+
+  /// 以 PackedReading 快照直接覆寫聲介韻調，不經過任何糾錯處理。
+  /// 拼音模式下的 romajiBuffer 會在下次讀取時依照新的聲介韻重建。
+  /// @param reading 欲寫入的讀音。
+  void setPackedReading(PackedReading reading) {
+    consonant = Phonabet(reading.consonant());
+    semivowel = Phonabet(reading.semivowel());
+    vowel = Phonabet(reading.vowel());
+    intonation = Phonabet(reading.intonation());
+    updateRomajiBuffer();
   }
 
   /// 設定該 Composer 處於何種鍵盤排列分析模式。
   ///
   /// @param arrange 給該注拼槽指定注音排列。
-  void ensureParser(MandarinParser arrange) { parser = arrange; };
+  void ensureParser(MandarinParser arrange) {
+    parser = arrange;
+    _romajiTrie = nullptr;
+    _romajiPathSynced = false;
+  };
+
+  /// 事先算出指定動態注音排列的整張狀態轉移表。
+  ///
+  /// 狀態轉移表平時會在擊鍵時按需填寫，故該函式並非必須呼叫；
+  /// 但若想避免首次擊鍵時的計算延遲，可以在初期化輸入法時呼叫。
+  /// 對非動態注音排列呼叫該函式的話，不會有任何效果。
+  ///
+  /// @param arrange 動態注音排列。
+  /// @param correction 是否對錯誤的注音讀音組合做出自動糾正處理。
+  static void prepareTransitionTable(MandarinParser arrange,
+                                     bool correction = false) {
+    DynamicLayoutTransitionTable* table = _transitionTable(arrange, correction);
+    if (!table) return;
+    for (uint16_t state = 0; state < DynamicLayoutTransitionTable::stateCount;
+         state++) {
+      for (size_t slot = 0; slot < table->slotCount(); slot++) {
+        _transit(*table, arrange, correction, state,
+                 static_cast<uint8_t>(slot));
+      }
+    }
+  }
 
   // MARK: Private
 
+  /// 取得槽位內的注音符號的索引；符號不屬於該槽位的話視為空。
+  static uint16_t _slotIndex(const Phonabet& slot, PhoneType type) {
+    return slot.type == type ? slot.index() : 0;
+  }
+
+  /// 取得指定動態注音排列的狀態轉移表；非動態注音排列則回傳空指標。
+  ///
+  /// 各表格在首次被取用時才建立。
+  /// @param arrange 注音排列。
+  /// @param correction 是否對錯誤的注音讀音組合做出自動糾正處理。
+  static DynamicLayoutTransitionTable* _transitionTable(MandarinParser arrange,
+                                                        bool correction) {
+    switch (arrange) {
+      case ofDachen26:
+        return correction ? &_transitionTableOf<ofDachen26, true>()
+                          : &_transitionTableOf<ofDachen26, false>();
+      case ofETen26:
+        return correction ? &_transitionTableOf<ofETen26, true>()
+                          : &_transitionTableOf<ofETen26, false>();
+      case ofHsu:
+        return correction ? &_transitionTableOf<ofHsu, true>()
+                          : &_transitionTableOf<ofHsu, false>();
+      case ofStarlight:
+        return correction ? &_transitionTableOf<ofStarlight, true>()
+                          : &_transitionTableOf<ofStarlight, false>();
+      case ofAlvinLiu:
+        return correction ? &_transitionTableOf<ofAlvinLiu, true>()
+                          : &_transitionTableOf<ofAlvinLiu, false>();
+      default:
+        return nullptr;
+    }
+  }
+
+  template <MandarinParser Arrange, bool Correction>
+  static DynamicLayoutTransitionTable& _transitionTableOf() {
+    static DynamicLayoutTransitionTable table(*asciiKeyTable(Arrange));
+    return table;
+  }
+
+  /// 查詢狀態轉移表的一格；該格尚未算出的話，就交給 handleXXX 函式算出並記下。
+  ///
+  /// @param table 狀態轉移表。
+  /// @param arrange 該表格所屬的注音排列。
+  /// @param correction 該表格是否對應自動糾正模式。
+  /// @param state 注拼槽狀態的緊湊序號。
+  /// @param slot 按鍵序號。
+  static uint32_t _transit(DynamicLayoutTransitionTable& table,
+                           MandarinParser arrange, bool correction,
+                           uint16_t state, uint8_t slot) {
+    std::atomic<uint32_t>& cell = table.cell(state, slot);
+    uint32_t result = cell.load(std::memory_order_relaxed);
+    if (result & DynamicLayoutTransitionTable::computedFlag) return result;
+    Composer scratch = Composer("", arrange, correction);
+    scratch.setPackedReading(DynamicLayoutTransitionTable::readingAt(state));
+    std::string emitted = scratch.translate(charToString(table.keyAt(slot)));
+    scratch.receiveKeyFromPhonabet(emitted);
+    result = DynamicLayoutTransitionTable::encode(
+        scratch.packedReading(), classifyPhonabet(Phonabet(emitted).scalar()));
+    // 同一格的計算結果必然相同，故多個執行緒同時寫入也無妨。
+    cell.store(result, std::memory_order_relaxed);
+    return result;
+  }
+
   /// 若 romajiBuffer 需要重建（phonabet 槽位已變更但尚未反映到 romajiBuffer），
   /// 則從當前的聲介韻重新計算並寫入 romajiBuffer。
   void _refreshRomajiBufferIfNeeded() {
     if (!_needsRomajiUpdate) return;
-    romajiBuffer = Tekkon::cnvPhonaToHanyuPinyin(
-        consonant.value() + semivowel.value() + vowel.value());
+    romajiBuffer.clear();
+    Tekkon::cnvPhonaToHanyuPinyin(
+        consonant.value() + semivowel.value() + vowel.value(), romajiBuffer);
     _needsRomajiUpdate = false;
+    _romajiPathSynced = false;
+  }
+
+  /// parseKeyStream() 的本體。
+  /// @param emit 每切出一個讀音便呼叫一次。
+  template <typename Emit>
+  static void _parseKeyStream(std::string_view keys, MandarinParser arrange,
+                              bool correction, Emit&& emit) {
+    Composer composer("", arrange, correction);
+    if (composer.isPinyinMode()) {
+      composer._parsePinyinKeyStream(keys, emit);
+      return;
+    }
+    DynamicLayoutTransitionTable* table = _transitionTable(arrange, correction);
+    for (char key : keys) {
+      PackedReading current = composer.packedReading();
+      if (current.isPronounceable()) {
+        // 動態排列的按鍵所對應的注音符號取決於當前的狀態，故查狀態轉移表。
+        char32_t incoming =
+            table ? DynamicLayoutTransitionTable::emittedPhonabet(_transit(
+                        *table, arrange, correction,
+                        DynamicLayoutTransitionTable::stateIndex(current),
+                        table->slotOf(key)))
+                  : lookupAsciiKey(arrange, key);
+        PhoneType type = PackedReading::typeOf(incoming);
+        if (type != null && type != PhoneType::intonation &&
+            current.indexAt(type)) {
+          emit(current);
+          composer.clear();
+        }
+      }
+      composer.receiveKey(key);
+      if (composer.intonation.isEmpty()) continue;
+      PackedReading reading = composer.packedReading();
+      if (reading.isPronounceable()) emit(reading);
+      composer.clear();
+    }
+    PackedReading rest = composer.packedReading();
+    if (rest.isPronounceable()) emit(rest);
+  }
+
+  /// _parseKeyStream() 在拼音排列下的本體：以聲調按鍵分段，
+  /// 段內的字母串再沿字首樹切成音節。
+  template <typename Emit>
+  void _parsePinyinKeyStream(std::string_view keys, Emit& emit) {
+    const CompactPinyinTrie& trie = CompactPinyinTrie::shared(parser);
+    StringPairTable tones = _arayuruPinyinIntonationTable.view();
+    size_t runBegin = 0;
+    for (size_t i = 0; i <= keys.size(); i++) {
+      uint8_t tone = 0;
+      if (i < keys.size()) {
+        auto theTone = tones.find(keys.substr(i, 1));
+        if (!theTone) continue;
+        tone = PackedReading::fromString(*theTone).intonationIndex();
+      }
+      std::string_view run = keys.substr(runBegin, i - runBegin);
+      runBegin = i + 1;
+      size_t position = 0;
+      while (position < run.size()) {
+        // 與 CompactPinyinTrie::chop() 一樣沿字首樹往深處走，
+        // 但停在最後一個完整音節上，免得切出「gon」這類半截的拼寫。
+        uint32_t node = 0;
+        uint32_t syllableNode = 0;
+        size_t length = 0;
+        size_t syllableLength = 0;
+        while (position + length < run.size()) {
+          node = trie.child(node, run[position + length]);
+          if (!node) break;
+          length++;
+          if (!trie.node(node).reading.isEmpty()) {
+            syllableNode = node;
+            syllableLength = length;
+          }
+        }
+        if (!syllableNode) {
+          // 連一個完整音節都湊不成的話，略過走過的部分（至少一個字元）。
+          position += std::max<size_t>(1, length);
+          continue;
+        }
+        position += syllableLength;
+        PackedReading reading = trie.node(syllableNode).reading;
+        if (position == run.size())
+          reading = reading.withIndex(PhoneType::intonation, tone);
+        _receivePinyinReading(reading);
+        if (isPronounceable()) emit(packedReading());
+      }
+    }
+  }
+
+  /// 讓拼音游標從字首樹的根部重走一遍 romajiBuffer。
+  void _syncRomajiPath() {
+    if (!_romajiTrie) _romajiTrie = &CompactPinyinTrie::shared(parser);
+    _romajiPathDepth = 0;
+    _romajiPathSynced = true;
+    for (char c : romajiBuffer) _stepRomajiPath(c);
+  }
+
+  /// 讓拼音游標沿著給定的字元前進一格。
+  /// 組音區長到游標裝不下的話，就不再追蹤（這麼長的字串也不可能是讀音）。
+  void _stepRomajiPath(char c) {
+    if (!_romajiPathSynced) return;
+    if (_romajiPathDepth == _romajiPath.size()) {
+      _romajiPathSynced = false;
+      return;
+    }
+    uint32_t node = 0;
+    if (_romajiPathDepth == 0) {
+      node = _romajiTrie->child(0, c);
+    } else if (uint32_t parent = _romajiPath[_romajiPathDepth - 1]) {
+      node = _romajiTrie->child(parent, c);
+    }
+    _romajiPath[_romajiPathDepth++] = node;
+  }
+
+  /// 以拼音查得的讀音取代聲介韻調的內容。
+  void _receivePinyinReading(PackedReading reading) {
+    if (!phonabetCombinationCorrectionEnabled && !enforceCSVTOrdering) {
+      // 拼音表內的讀音皆已合規，直接整組寫入即可。
+      setPackedReading(reading);
+      return;
+    }
+    setPackedReading(PackedReading());
+    for (char32_t phonabet : {reading.consonant(), reading.semivowel(),
+                              reading.vowel(), reading.intonation()}) {
+      if (phonabet != 0) receiveKeyFromPhonabet(phonabet);
+    }
   }
 
   /// 拿取用來進行索引檢索用的注音字串。
@@ -2368,6 +5514,18 @@ class Composer {
     return validKeyAvailable ? readingKey : "";
   }
 
+  /// 拿取用來進行索引檢索用的讀音序號，不必建立任何字串。
+  ///
+  /// 判定規則與 phonabetKeyForQuery() 相同，後者回傳空字串的場合這裡回傳 0；
+  /// 否則 readingIDToZhuyin() 的結果即為 phonabetKeyForQuery() 的結果。
+  /// @param pronounceableOnly 是否可以唸出。
+  uint16_t readingIDForQuery(bool pronounceableOnly) {
+    PackedReading reading = packedReading();
+    if ((isPinyinMode() || pronounceableOnly) && !reading.isPronounceable())
+      return 0;
+    return reading.readingID();
+  }
+
  protected:
   // MARK: - Parser Processings
 
@@ -2382,25 +5540,18 @@ class Composer {
     if (isPinyinMode()) return "";
     switch (parser) {
       case ofDachen:
-        return mapQwertyDachen.count(key) ? mapQwertyDachen[key] : "";
+      case ofETen:
+      case ofIBM:
+      case ofMiTAC:
+      case ofSeigyou:
+      case ofFakeSeigyou:
+        return staticKeyPhonabet(parser, key);
       case ofDachen26:
         return handleDachen26(key);
-      case ofETen:
-        return mapQwertyETenTraditional.count(key)
-                   ? mapQwertyETenTraditional[key]
-                   : "";
       case ofHsu:
         return handleHsu(key);
       case ofETen26:
         return handleETen26(key);
-      case ofIBM:
-        return mapQwertyIBM.count(key) ? mapQwertyIBM[key] : "";
-      case ofMiTAC:
-        return mapQwertyMiTAC.count(key) ? mapQwertyMiTAC[key] : "";
-      case ofSeigyou:
-        return mapSeigyou.count(key) ? mapSeigyou[key] : "";
-      case ofFakeSeigyou:
-        return mapFakeSeigyou.count(key) ? mapFakeSeigyou[key] : "";
       case ofStarlight:
         return handleStarlight(key);
       case ofAlvinLiu:
@@ -2417,8 +5568,7 @@ class Composer {
   ///
   /// @param key 傳入的 std::string 訊號。
   std::string handleETen26(std::string key) {
-    std::string strReturn =
-        (mapETen26StaticKeys.count(key)) ? mapETen26StaticKeys[key] : "";
+    std::string strReturn = staticKeyPhonabet(ofETen26, key);
 
     std::string keysToHandleHere = "dfhjklmnpqtw";
 
@@ -2497,8 +5647,7 @@ class Composer {
   ///
   /// @param key 傳入的 std::string 訊號。
   std::string handleHsu(std::string key) {
-    std::string strReturn =
-        (mapHsuStaticKeys.count(key)) ? mapHsuStaticKeys[key] : "";
+    std::string strReturn = staticKeyPhonabet(ofHsu, key);
 
     std::string keysToHandleHere = "acdefghjklmns";
 
@@ -2589,8 +5738,7 @@ class Composer {
   ///
   /// @param key 傳入的 std::string 訊號。
   std::string handleStarlight(std::string key) {
-    std::string strReturn =
-        (mapStarlightStaticKeys.count(key)) ? mapStarlightStaticKeys[key] : "";
+    std::string strReturn = staticKeyPhonabet(ofStarlight, key);
 
     std::string keysToHandleHere = "efgklmnt";
 
@@ -2653,9 +5801,7 @@ class Composer {
   ///
   /// @param key 傳入的 std::string 訊號。
   std::string handleDachen26(std::string key) {
-    std::string strReturn = (mapDachenCP26StaticKeys.count(key))
-                                ? mapDachenCP26StaticKeys[key]
-                                : "";
+    std::string strReturn = staticKeyPhonabet(ofDachen26, key);
 
     switch (hashify(key.c_str())) {
       case (hashify("e")):
@@ -2746,8 +5892,7 @@ class Composer {
   /// @remark 該處理兼顧了「原旨排列方案」與「微軟新注音相容排列方案」。
   /// @param key 傳入的 std::string 訊號。
   std::string handleAlvinLiu(std::string key) {
-    std::string strReturn =
-        (mapAlvinLiuStaticKeys.count(key)) ? mapAlvinLiuStaticKeys[key] : "";
+    std::string strReturn = staticKeyPhonabet(ofAlvinLiu, key);
 
     // 前置處理專有特殊情形。
     if (strReturn != "ㄦ" && !vowel.isEmpty()) fixValue("ㄦ", "ㄌ");
@@ -2944,59 +6089,59 @@ class PinyinTrie {
     updateAllPossibleReadings();
 
     // Key 是拼音，Value 是注音，所以要反過來建樹
-    const std::map<std::string, std::string>* table = nullptr;
-    switch (parser) {
-      case ofHanyuPinyin:
-        table = &mapHanyuPinyin;
-        break;
-      case ofSecondaryPinyin:
-        table = &mapSecondaryPinyin;
-        break;
-      case ofYalePinyin:
-        table = &mapYalePinyin;
-        break;
-      case ofHualuoPinyin:
-        table = &mapHualuoPinyin;
-        break;
-      case ofUniversalPinyin:
-        table = &mapUniversalPinyin;
-        break;
-      case ofWadeGilesPinyin:
-        table = &mapWadeGilesPinyin;
-        break;
-      default:
-        break;
-    }
-
-    if (table) {
-      for (const auto& pair : *table) {
-        insert(pair.first, pair.second);
-      }
+    const StringPairTable table = pinyinReadingTable(parser);
+    for (size_t i = 0; i < table.size(); i++) {
+      const StringPair& pair = table.sortedAt(i);
+      insert(std::string(pair.key), std::string(pair.value));
     }
+    // 到此為止的內容與 parser 的讀音表完全一致。
+    _isModified = false;
   }
 
   // MARK: Shared Cache
 
   /// 取得指定 parser 對應的快取 PinyinTrie 實例。
-  /// 若尚未存在則新建並快取。
+  /// 若尚未存在則新建並快取；已建立的實例不需上鎖即可取得。
+  /// 經由這裡取得過的實例會一直保留到程式結束，故參照永遠有效；
+  /// 需要在 clearSharedCache() 之後釋放記憶體的話，請改用 sharedHandle()。
   static PinyinTrie& shared(MandarinParser parser) {
-    int cacheKey = static_cast<int>(parser);
-    std::lock_guard<std::mutex> lock(sharedCacheMutex);
-    auto it = sharedCache.find(cacheKey);
-    if (it != sharedCache.end()) return *it->second;
-    auto* created = new PinyinTrie(parser);
-    sharedCache[cacheKey] = created;
-    return *created;
+    return _SharedParserRegistry<PinyinTrie>::get(parser);
+  }
+
+  /// 取得指定 parser 對應的快取 PinyinTrie 實例的共享所有權。
+  /// 實例在 clearSharedCache() 之後、最後一個 handle 放掉時即被釋放。
+  static std::shared_ptr<PinyinTrie> sharedHandle(MandarinParser parser) {
+    return _SharedParserRegistry<PinyinTrie>::handle(parser);
   }
 
-  /// 清除所有已快取的 PinyinTrie 實例。
+  /// 清除所有已快取的 PinyinTrie 實例，之後的 shared() 會重新建立。
+  /// 舊的實例只在沒有 handle 持有、也未經 shared() 交出參照時才會釋放，
+  /// 故其他執行緒手上既有的參照與 handle 仍然有效。
   static void clearSharedCache() {
-    std::lock_guard<std::mutex> lock(sharedCacheMutex);
-    for (auto& pair : sharedCache) delete pair.second;
-    sharedCache.clear();
+    _SharedParserRegistry<PinyinTrie>::retireAll();
   }
 
+  // MARK: Compiled Images
+
+  /// 將該 parser 的字首樹（連同反查索引）以 CompactPinyinTrie 的影像格式
+  /// 寫到指定路徑，供 mapCompiled() 載入。
+  /// @return 寫入成功與否。
+  /// @note 定義於 TekkonCompiledImage.hh。
+  inline bool saveCompiled(const std::string& path) const;
+
+  /// 映射 saveCompiled() 寫出的檔案，其 search()、chop() 等查詢直接讀取
+  /// 映射的分頁，載入耗時與讀音表的大小無關。
+  /// 再交給 CompactPinyinTrie::installShared() 的話，chop() 與 Composer
+  /// 也會改用這份映射。
+  /// @return 檔案不存在、損毀或版本不符時回傳空指標。
+  /// @note 定義於 TekkonCompiledImage.hh。
+  inline static std::unique_ptr<CompactPinyinTrie> mapCompiled(
+      const std::string& path);
+
   /// 插入一個拼音到注音的映射
+  ///
+  /// 插入之後，該實例的 search() 與 deductChoppedPinyinToZhuyin() 會改為走訪
+  /// nodes，以便查到新插入的映射。
   void insert(const std::string& key, const std::string& entry) {
     TNode* currentNode = &nodes[0];
 
@@ -3026,11 +6171,19 @@ class PinyinTrie {
     // 在最終節點添加詞條
     currentNode->readingKey = key;
     currentNode->entries.push_back(entry);
+    _isModified = true;
   }
 
+  /// 是否曾在建構之後以 insert() 加入映射。
+  bool isModified() const { return _isModified; }
+
   /// 搜索給定的 key，返回所有匹配的注音
-  std::vector<std::string> search(const std::string& key) {
-    TNode* currentNode = &nodes[0];
+  ///
+  /// 未經 insert() 修改的字首樹與 parser 的讀音表完全一致，故直接交給共用的
+  /// CompactPinyinTrie：前綴底下的詞條是連續的一段，不必遍歷 nodes 的子樹。
+  std::vector<std::string> search(const std::string& key) const {
+    if (!_isModified) return CompactPinyinTrie::shared(parser).search(key);
+    const TNode* currentNode = &nodes.at(0);
 
     for (char c : key) {
       std::string charStr(1, c);
@@ -3038,64 +6191,60 @@ class PinyinTrie {
       if (it == currentNode->children.end() || !nodes.count(it->second)) {
         return {};
       }
-      currentNode = &nodes[it->second];
+      currentNode = &nodes.at(it->second);
     }
 
     return collectAllDescendantEntries(*currentNode);
   }
 
+  /// 與 search() 的結果相同，但直接指向共用 CompactPinyinTrie 內的詞條：
+  /// 不配置記憶體，耗時只與 key 的長度成正比。詞條文字請用 text() 取得。
+  /// 共用的字首樹只含 parser 的讀音表，故不含經由 insert() 加入的映射。
+  CompactPinyinTrie::EntrySpan searchEntries(std::string_view key) const {
+    return CompactPinyinTrie::shared(parser).searchEntries(key);
+  }
+
+  /// 結構化版本的 deductChoppedPinyinToZhuyin()：不組成字串，
+  /// 而是直接給出每個切片的聲母摘要與候選讀音範圍。
+  /// 詳見 CompactPinyinTrie::deductChoppedPinyinToZhuyin()。
+  void deductChoppedPinyinToZhuyin(
+      const std::vector<std::string_view>& chopped,
+      std::vector<CompactPinyinTrie::SliceCandidates>& result) const {
+    CompactPinyinTrie::shared(parser).deductChoppedPinyinToZhuyin(chopped,
+                                                                  result);
+  }
+
+  /// 取得 searchEntries() 所回傳的詞條的注音文字。
+  std::string_view text(const CompactPinyinTrie::Entry& entry) const {
+    return CompactPinyinTrie::shared(parser).text(entry);
+  }
+
   /// 用來像智能狂拼/搜狗拼音那樣處理一個連續的簡拼字串、切割成多個可能的合理讀音前綴。
   ///
   /// 比如說全拼「shi4jie4da4zhan4」可能會簡拼成「shjdaz」。
   /// 此時的理想切片結果是：["sh","j","da","z"]。
+  ///
+  /// 切割時沿字首樹從各個位置往下走，故耗時與「輸入長度×最長讀音長度」成正比。
+  /// 切割結果只取決於 parser 的讀音表，故直接交給共用的 CompactPinyinTrie 處理。
+  /// 逐字元輸入時每拍都重切整個字串的話，請改用 ChopSession。
   std::vector<std::string> chop(const std::string& readingComplex) {
-    std::vector<std::string> result;
-    int complexLength = static_cast<int>(readingComplex.length());
-
-    int longestReadingLength =
-        allPossibleReadings.empty()
-            ? 1
-            : static_cast<int>(allPossibleReadings[0].length());
-    int maxScopeSize = std::min(complexLength, longestReadingLength);
-    int currentPosition = 0;
-
-    while (currentPosition < complexLength) {
-      bool foundMatch = false;
-
-      // 嘗試從最長的可能前綴開始比對
-      int longPossibleScopeSize =
-          std::min(maxScopeSize, complexLength - currentPosition);
-
-      for (int scopeSize = longPossibleScopeSize; scopeSize >= 1; scopeSize--) {
-        int endPosition = currentPosition + scopeSize;
-        if (endPosition > complexLength) {
-          continue;
-        }
-
-        std::string currentBlob =
-            readingComplex.substr(currentPosition, scopeSize);
-
-        // 檢查是否有任何讀音以這個字串開頭
-        for (const auto& currentReading : allPossibleReadings) {
-          if (currentReading.find(currentBlob) == 0) {  // hasPrefix
-            result.push_back(currentBlob);
-            currentPosition = endPosition;
-            foundMatch = true;
-            break;
-          }
-        }
-
-        if (foundMatch) break;
-      }
+    return CompactPinyinTrie::shared(parser).chop(readingComplex);
+  }
 
-      // 如果沒找到相符的條目，將當前字元作為單獨的一項
-      if (!foundMatch) {
-        result.push_back(readingComplex.substr(currentPosition, 1));
-        currentPosition++;
-      }
-    }
+  /// 與上述 chop() 相同，但切割結果是指向 readingComplex 本身的 string_view，
+  /// 不會配置新的字串。
+  ///
+  /// @param readingComplex 要切割的字串。
+  /// @param result 用來接收切割結果的陣列。
+  void chop(std::string_view readingComplex,
+            std::vector<std::string_view>& result) {
+    CompactPinyinTrie::shared(parser).chop(readingComplex, result);
+  }
 
-    return result;
+  /// 建立給定字串的切割網格，可從中列舉 chop() 以外的其他切法。
+  /// 詳見 ChopLattice。
+  ChopLattice buildLattice(std::string_view input) const {
+    return ChopLattice(CompactPinyinTrie::shared(parser), input);
   }
 
   /// 拿已經 chop 段切過的拼音來算出可能的注音 chop 結果。單個拼音 chop
@@ -3108,79 +6257,37 @@ class PinyinTrie {
   /// ["ㄅ", "ㄩㄝ", "ㄓ&ㄗ", "ㄑ", "ㄕ&ㄙ", "ㄌ", "ㄌ"]
   std::vector<std::string> deductChoppedPinyinToZhuyin(
       const std::vector<std::string>& chopped, char chopCaseSeparator = '&',
-      bool initialZhuyinOnly = true) {
+      bool initialZhuyinOnly = true) const {
+    if (!_isModified) {
+      return CompactPinyinTrie::shared(parser).deductChoppedPinyinToZhuyin(
+          chopped, chopCaseSeparator, initialZhuyinOnly);
+    }
     if (parser < 100) {  // Not pinyin
       return chopped;
     }
 
     std::vector<std::string> choppedZhuyinCandidates;
-
     for (const auto& slice : chopped) {
-      auto fetched = search(slice);
-
-      switch (fetched.size()) {
-        case 0:
-          choppedZhuyinCandidates.push_back(slice);
-          break;
-        case 1:
-          choppedZhuyinCandidates.push_back(fetched[0]);
-          break;
-        default: {
-          // 去重並排序
-          std::vector<std::string> uniqueFetched = fetched;
-          std::sort(uniqueFetched.begin(), uniqueFetched.end());
-          uniqueFetched.erase(
-              std::unique(uniqueFetched.begin(), uniqueFetched.end()),
-              uniqueFetched.end());
-
-          // 如果 initialZhuyinOnly 為 true，只保留聲母部分
-          if (initialZhuyinOnly) {
-            std::vector<std::string> prefixes;
-            for (int i = 3; i >= 1; i--) {
-              if (uniqueFetched.size() <= static_cast<size_t>(i)) break;
-
-              std::set<std::string> prefixSet;
-              for (const auto& item : fetched) {
-                auto split = splitByCodepoint(item);
-                if (!split.empty() && split.size() >= static_cast<size_t>(i)) {
-                  std::string prefix;
-                  for (size_t j = 0;
-                       j < static_cast<size_t>(i) && j < split.size(); j++) {
-                    prefix += split[j];
-                  }
-                  prefixSet.insert(prefix);
-                }
-              }
-              uniqueFetched.assign(prefixSet.begin(), prefixSet.end());
-              std::sort(uniqueFetched.begin(), uniqueFetched.end());
-            }
-          }
-
-          // 用分隔符連接
-          std::string joined;
-          for (size_t i = 0; i < uniqueFetched.size(); i++) {
-            if (i > 0) joined += chopCaseSeparator;
-            joined += uniqueFetched[i];
-          }
-          choppedZhuyinCandidates.push_back(joined);
-          break;
-        }
-      }
+      choppedZhuyinCandidates.push_back(_mergeZhuyinCandidates(
+          slice, search(slice), chopCaseSeparator, initialZhuyinOnly));
     }
 
     return choppedZhuyinCandidates;
   }
 
  private:
+  bool _isModified = false;
+
   /// 收集節點及其所有後代的詞條
-  std::vector<std::string> collectAllDescendantEntries(const TNode& node) {
+  std::vector<std::string> collectAllDescendantEntries(
+      const TNode& node) const {
     std::vector<std::string> result = node.entries;
 
     // 遍歷所有子節點
     for (const auto& pair : node.children) {
-      int childNodeID = pair.second;
-      if (nodes.count(childNodeID)) {
-        auto childEntries = collectAllDescendantEntries(nodes[childNodeID]);
+      auto child = nodes.find(pair.second);
+      if (child != nodes.end()) {
+        auto childEntries = collectAllDescendantEntries(child->second);
         result.insert(result.end(), childEntries.begin(), childEntries.end());
       }
     }
@@ -3192,36 +6299,11 @@ class PinyinTrie {
   void updateAllPossibleReadings() {
     allPossibleReadings.clear();
 
-    const std::map<std::string, std::string>* table = nullptr;
-    switch (parser) {
-      case ofHanyuPinyin:
-        table = &mapHanyuPinyin;
-        break;
-      case ofSecondaryPinyin:
-        table = &mapSecondaryPinyin;
-        break;
-      case ofYalePinyin:
-        table = &mapYalePinyin;
-        break;
-      case ofHualuoPinyin:
-        table = &mapHualuoPinyin;
-        break;
-      case ofUniversalPinyin:
-        table = &mapUniversalPinyin;
-        break;
-      case ofWadeGilesPinyin:
-        table = &mapWadeGilesPinyin;
-        break;
-      default:
-        // For non-pinyin parsers, use Hanyu Pinyin values as base
-        table = &mapHanyuPinyin;
-        break;
-    }
-
-    if (table) {
-      for (const auto& pair : *table) {
-        allPossibleReadings.push_back(pair.first);
-      }
+    StringPairTable table = pinyinReadingTable(parser);
+    // For non-pinyin parsers, use Hanyu Pinyin values as base
+    if (table.empty()) table = _hanyuPinyinTable.view();
+    for (const StringPair& pair : table) {
+      allPossibleReadings.emplace_back(pair.key);
     }
 
     // Sort by length (descending) then alphabetically
@@ -3233,13 +6315,18 @@ class PinyinTrie {
                 return a > b;
               });
   }
-
-  // MARK: Shared Cache (private static)
-
-  static inline std::mutex sharedCacheMutex;
-  static inline std::map<int, PinyinTrie*> sharedCache;
 };
 
 }  // namespace Tekkon
 
+/// 讓 PackedReading 可以直接拿來當作 std::unordered_map 等容器的鍵。
+namespace std {
+template <>
+struct hash<Tekkon::PackedReading> {
+  size_t operator()(const Tekkon::PackedReading& reading) const noexcept {
+    return std::hash<uint16_t>()(reading.raw);
+  }
+};
+}  // namespace std
+
 #endif
@@ -0,0 +1,131 @@
+// (c) 2022 and onwards The vChewing Project (LGPL v3.0 License or later).
+// ====================
+// This code is released under the SPDX-License-Identifier: `LGPL-3.0-or-later`.
+
+// ADVICE: Save as UTF8 without BOM signature!!!
+
+/// CompactPinyinTrie 編譯影像的檔案存取（saveCompiled 與 mapCompiled）。
+///
+/// 這部分要用到 mmap 等平台的檔案 I/O 介面，為了不讓 Tekkon.hh 的每個使用者
+/// 都被迫引入 <fcntl.h>、<sys/mman.h>、<unistd.h>，故另外放在這個標頭檔裡；
+/// 只有實際讀寫編譯檔的地方才需要引入它。
+
+#ifndef TEKKON_COMPILED_IMAGE_HH_
+#define TEKKON_COMPILED_IMAGE_HH_
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "Tekkon.hh"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Tekkon {
+
+inline bool CompactPinyinTrie::saveCompiled(const std::string& path) const {
+#if defined(_WIN32)
+  // 沒有 mkstemp 可用，以時戳與行程內的序號湊出不重複的暫存檔名。
+  static std::atomic<uint64_t> serial{0};
+  std::string temporaryPath =
+      path + "." +
+      std::to_string(
+          std::chrono::steady_clock::now().time_since_epoch().count()) +
+      "-" + std::to_string(serial.fetch_add(1)) + ".tmp";
+  {
+    std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+    stream.write(_image, static_cast<std::streamsize>(_imageSize));
+    if (!stream.good()) {
+      stream.close();
+      std::remove(temporaryPath.c_str());
+      return false;
+    }
+  }
+#else
+  std::string temporaryPath = path + ".XXXXXX";
+  int fd = mkstemp(temporaryPath.data());
+  if (fd < 0) return false;
+  // mkstemp 建出的檔案只有擁有者可讀；編譯檔要給其他行程映射，故放寬成 0644。
+  bool succeeded = fchmod(fd, 0644) == 0;
+  for (size_t written = 0; succeeded && written < _imageSize;) {
+    ssize_t result = write(fd, _image + written, _imageSize - written);
+    if (result < 0) {
+      succeeded = errno == EINTR;
+      continue;
+    }
+    written += static_cast<size_t>(result);
+  }
+  if (close(fd) != 0) succeeded = false;
+  if (!succeeded) {
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+#endif
+  if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+    std::remove(temporaryPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+inline std::unique_ptr<CompactPinyinTrie> CompactPinyinTrie::mapCompiled(
+    const std::string& path) {
+  std::unique_ptr<CompactPinyinTrie> trie(new CompactPinyinTrie());
+#if defined(_WIN32)
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) return nullptr;
+  std::string bytes((std::istreambuf_iterator<char>(stream)),
+                    std::istreambuf_iterator<char>());
+  trie->_buffer.resize((bytes.size() + 3) / 4);
+  std::memcpy(trie->_buffer.data(), bytes.data(), bytes.size());
+  if (!trie->_attach(reinterpret_cast<const char*>(trie->_buffer.data()),
+                     bytes.size())) {
+    return nullptr;
+  }
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat info;
+  size_t size = 0;
+  void* mapped = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    size = static_cast<size_t>(info.st_size);
+    mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapped == MAP_FAILED) return nullptr;
+  trie->_mapping = std::shared_ptr<const void>(
+      mapped, [size](const void* region) {
+        munmap(const_cast<void*>(region), size);
+      });
+  if (!trie->_attach(static_cast<const char*>(mapped), size)) {
+    return nullptr;
+  }
+#endif
+  return trie;
+}
+
+inline bool PinyinTrie::saveCompiled(const std::string& path) const {
+  return CompactPinyinTrie::shared(parser).saveCompiled(path);
+}
+
+inline std::unique_ptr<CompactPinyinTrie> PinyinTrie::mapCompiled(
+    const std::string& path) {
+  return CompactPinyinTrie::mapCompiled(path);
+}
+
+}  // namespace Tekkon
+
+#endif
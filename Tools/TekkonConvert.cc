@@ -0,0 +1,251 @@
+// (c) 2022 and onwards The vChewing Project (LGPL v3.0 License or later).
+// ====================
+// This code is released under the SPDX-License-Identifier: `LGPL-3.0-or-later`.
+
+// tekkon-convert：在注音與各種數字標調的拼音之間轉換大型語料檔案。
+//
+// 用法：tekkon-convert --from <方案> --to <方案> [--threads N]
+//                      [--chunk-mb N] <輸入檔> [輸出檔]
+// 方案：zhuyin、hanyu、secondary、yale、hualuo、universal、wadegiles。
+//
+// 輸入檔會被映射到記憶體，按行切成若干區塊交給多個執行緒轉換，
+// 再按原本的順序寫出（未指定輸出檔時寫到標準輸出）。
+// 無法辨識的內容（標點、漢字、不存在的音節等）一律原樣保留。
+// 處理速度會在結束時輸出到標準錯誤。
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "TekkonConvert.hh"
+
+namespace {
+
+using namespace TekkonConvert;
+
+/// 唯讀映射整個輸入檔；管線等無法映射的輸入則整個讀進記憶體。
+class MappedFile {
+ public:
+  explicit MappedFile(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    struct stat info;
+    if (fstat(fd, &info) == 0) {
+      if (S_ISREG(info.st_mode)) {
+        _map(fd, static_cast<size_t>(info.st_size));
+      } else {
+        _readAll(fd);
+      }
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (_mapped) munmap(const_cast<char*>(_data), _size);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool ok() const { return _ok; }
+  std::string_view view() const { return std::string_view(_data, _size); }
+
+ private:
+  void _map(int fd, size_t size) {
+    _size = size;
+    if (size == 0) {
+      _ok = true;
+      return;
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) return;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    _data = static_cast<const char*>(mapped);
+    _mapped = true;
+    _ok = true;
+  }
+
+  void _readAll(int fd) {
+    char buffer[1 << 16];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+      _buffer.append(buffer, static_cast<size_t>(count));
+    }
+    _data = _buffer.data();
+    _size = _buffer.size();
+    _ok = count == 0;
+  }
+
+  std::string _buffer;
+  const char* _data = nullptr;
+  size_t _size = 0;
+  bool _mapped = false;
+  bool _ok = false;
+};
+
+/// 按行切分區塊：每個區塊約 chunkSize 位元組，且必定結束於換行之後。
+std::vector<std::string_view> splitIntoChunks(std::string_view input,
+                                              size_t chunkSize) {
+  std::vector<std::string_view> chunks;
+  size_t begin = 0;
+  while (begin < input.size()) {
+    size_t end = std::min(begin + chunkSize, input.size());
+    if (end < input.size()) {
+      size_t newline = input.find('\n', end);
+      end = newline == std::string_view::npos ? input.size() : newline + 1;
+    }
+    chunks.push_back(input.substr(begin, end - begin));
+    begin = end;
+  }
+  return chunks;
+}
+
+int usage(const char* program) {
+  std::fprintf(stderr,
+               "Usage: %s --from <scheme> --to <scheme> [--threads N] "
+               "[--chunk-mb N] <input> [output]\n"
+               "Schemes: zhuyin, hanyu, secondary, yale, hualuo, universal, "
+               "wadegiles.\n",
+               program);
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  std::optional<Scheme> from;
+  std::optional<Scheme> to;
+  size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+  size_t chunkSize = 4 << 20;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--from" && hasValue) {
+      from = schemeNamed(argv[++i]);
+      if (!from) return usage(argv[0]);
+    } else if (arg == "--to" && hasValue) {
+      to = schemeNamed(argv[++i]);
+      if (!to) return usage(argv[0]);
+    } else if (arg == "--threads" && hasValue) {
+      threadCount = std::max(1L, std::strtol(argv[++i], nullptr, 10));
+    } else if (arg == "--chunk-mb" && hasValue) {
+      chunkSize = std::max(1L, std::strtol(argv[++i], nullptr, 10)) << 20;
+    } else if (!arg.empty() && arg[0] != '-') {
+      paths.push_back(argv[i]);
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (!from || !to || paths.empty() || paths.size() > 2) return usage(argv[0]);
+
+  MappedFile input(paths[0]);
+  if (!input.ok()) {
+    std::fprintf(stderr, "Cannot read %s: %s\n", paths[0], strerror(errno));
+    return 1;
+  }
+  FILE* output = paths.size() == 2 ? std::fopen(paths[1], "wb") : stdout;
+  if (!output) {
+    std::fprintf(stderr, "Cannot write %s: %s\n", paths[1], strerror(errno));
+    return 1;
+  }
+
+  auto startTime = std::chrono::steady_clock::now();
+  Converter converter(*from, *to);
+  std::vector<std::string_view> chunks =
+      splitIntoChunks(input.view(), chunkSize);
+  std::vector<std::string> results(chunks.size());
+  std::vector<bool> finished(chunks.size(), false);
+  std::atomic<size_t> syllableCount{0};
+
+  // 各執行緒依序領取區塊；為了限制記憶體用量，已轉換但尚未寫出的區塊
+  // 不超過執行緒數的兩倍。
+  size_t window = threadCount * 2;
+  size_t nextChunk = 0;
+  size_t written = 0;
+  std::mutex mutex;
+  std::condition_variable chunkTaken;
+  std::condition_variable chunkFinished;
+  auto work = [&]() {
+    while (true) {
+      size_t index;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        chunkTaken.wait(lock, [&] {
+          return nextChunk >= chunks.size() || nextChunk < written + window;
+        });
+        if (nextChunk >= chunks.size()) return;
+        index = nextChunk++;
+      }
+      std::string converted;
+      converted.reserve(chunks[index].size() * 2);
+      syllableCount += converter.convert(chunks[index], converted);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        results[index] = std::move(converted);
+        finished[index] = true;
+      }
+      chunkFinished.notify_one();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < std::min(threadCount, chunks.size()); i++) {
+    workers.emplace_back(work);
+  }
+
+  // 主執行緒按順序寫出。
+  size_t outputBytes = 0;
+  bool writeFailed = false;
+  while (written < chunks.size()) {
+    std::string chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      chunkFinished.wait(lock, [&] { return finished[written]; });
+      chunk = std::move(results[written]);
+    }
+    if (!writeFailed &&
+        std::fwrite(chunk.data(), 1, chunk.size(), output) != chunk.size()) {
+      writeFailed = true;
+    }
+    outputBytes += chunk.size();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      written++;
+    }
+    chunkTaken.notify_all();
+  }
+  for (std::thread& worker : workers) worker.join();
+  if (std::fflush(output) != 0) writeFailed = true;
+  if (output != stdout) std::fclose(output);
+  if (writeFailed) {
+    std::fprintf(stderr, "Failed to write the output.\n");
+    return 1;
+  }
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+  double megabytes = input.view().size() / 1048576.0;
+  std::fprintf(stderr,
+               "%s -> %s: %.1f MiB in, %.1f MiB out, %zu syllables, "
+               "%zu chunks, %zu threads, %.3f s (%.1f MiB/s)\n",
+               from->name, to->name, megabytes, outputBytes / 1048576.0,
+               syllableCount.load(), chunks.size(), workers.size(), seconds,
+               seconds > 0 ? megabytes / seconds : 0.0);
+  return 0;
+}
@@ -0,0 +1,197 @@
+// (c) 2022 and onwards The vChewing Project (LGPL v3.0 License or later).
+// ====================
+// This code is released under the SPDX-License-Identifier: `LGPL-3.0-or-later`.
+
+// tekkon-convert 的轉換核心，獨立成標頭檔以便單元測試直接取用。
+// 檔案映射與多執行緒排程等部分見 TekkonConvert.cc。
+
+#ifndef TEKKON_CONVERT_HH_
+#define TEKKON_CONVERT_HH_
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "../Sources/Tekkon/include/Tekkon.hh"
+
+namespace TekkonConvert {
+
+using namespace Tekkon;
+
+/// 轉換方案；拼音方案直接沿用 MandarinParser，注音則另以 ofDachen 代表。
+struct Scheme {
+  const char* name;
+  MandarinParser parser;
+  bool isZhuyin;
+};
+
+inline constexpr Scheme kSchemes[] = {
+    {"zhuyin", ofDachen, true},
+    {"hanyu", ofHanyuPinyin, false},
+    {"secondary", ofSecondaryPinyin, false},
+    {"yale", ofYalePinyin, false},
+    {"hualuo", ofHualuoPinyin, false},
+    {"universal", ofUniversalPinyin, false},
+    {"wadegiles", ofWadeGilesPinyin, false},
+};
+
+inline std::optional<Scheme> schemeNamed(std::string_view name) {
+  for (const Scheme& scheme : kSchemes) {
+    if (name == scheme.name) return scheme;
+  }
+  return std::nullopt;
+}
+
+/// 讀音（不計聲調）到拼音音節的反查表，以 PackedReading 的聲介韻部分為索引。
+/// 各拼音對照表的注音一側皆無重複，故反查結果唯一。
+class SyllableSpellings {
+ public:
+  explicit SyllableSpellings(MandarinParser parser) {
+    for (const StringPair& pair : pinyinReadingTable(parser)) {
+      _spellings[PackedReading::fromString(pair.value).raw] = pair.key;
+    }
+  }
+
+  std::string_view spellingOf(PackedReading reading) const {
+    return _spellings[reading.without(PhoneType::intonation).raw];
+  }
+
+ private:
+  // 聲介韻共佔 11 個位元。
+  std::array<std::string_view, 1 << 11> _spellings{};
+};
+
+/// 單個區塊的轉換器，各執行緒共用（唯讀）。
+class Converter {
+ public:
+  Converter(Scheme from, Scheme to) : _from(from), _to(to) {
+    if (!to.isZhuyin) _spellings.emplace(to.parser);
+  }
+
+  /// 轉換一個區塊並將結果附加到 output 之後。
+  /// @return 成功轉換的音節數。
+  size_t convert(std::string_view input, std::string& output) const {
+    return _from.isZhuyin ? _convertZhuyin(input, output)
+                          : _convertPinyin(input, output);
+  }
+
+ private:
+  Scheme _from;
+  Scheme _to;
+  std::optional<SyllableSpellings> _spellings;
+
+  /// 寫出讀音；目標方案沒有該音節的話回傳 false，交由呼叫端原樣保留。
+  /// 拼音一律標出數字調號（陰平與無聲調皆標作 1），以免音節彼此黏連、
+  /// 也讓轉換結果能夠原樣轉換回來。
+  bool _emit(PackedReading reading, std::string& output) const {
+    if (!reading.isValidSyllable()) return false;
+    if (_to.isZhuyin) {
+      for (char32_t phonabet : {reading.consonant(), reading.semivowel(),
+                                reading.vowel()}) {
+        if (phonabet) output += char32ToString(phonabet);
+      }
+      // 陰平不標。
+      if (reading.intonationIndex() > 1) {
+        output += char32ToString(reading.intonation());
+      }
+      return true;
+    }
+    std::string_view spelling = _spellings->spellingOf(reading);
+    if (spelling.empty()) return false;
+    output += spelling;
+    uint8_t tone = std::max<uint8_t>(1, reading.intonationIndex());
+    output += static_cast<char>('0' + tone);
+    return true;
+  }
+
+  /// 拼音音節的組成字元（威妥瑪拼音另含送氣符號）。
+  bool _isSpellingChar(char c) const {
+    return (c >= 'a' && c <= 'z') ||
+           (c == '\'' && _from.parser == ofWadeGilesPinyin);
+  }
+
+  size_t _convertPinyin(std::string_view input, std::string& output) const {
+    SyllableHashView hash = pinyinSyllableHash(_from.parser);
+    size_t converted = 0;
+    size_t i = 0;
+    while (i < input.size()) {
+      if (!_isSpellingChar(input[i])) {
+        size_t begin = i;
+        while (i < input.size() && !_isSpellingChar(input[i])) i++;
+        output.append(input.data() + begin, i - begin);
+        continue;
+      }
+      size_t begin = i;
+      while (i < input.size() && _isSpellingChar(input[i])) i++;
+      std::string_view spelling = input.substr(begin, i - begin);
+      uint8_t tone = 0;
+      if (i < input.size() && input[i] >= '1' && input[i] <= '5') {
+        tone = static_cast<uint8_t>(input[i++] - '0');
+      }
+      std::string_view token = input.substr(begin, i - begin);
+      const SyllableHashView::Slot* slot = hash.find(spelling);
+      if (slot && _emit(slot->reading.withIndex(PhoneType::intonation, tone),
+                        output)) {
+        converted++;
+      } else {
+        output += token;
+      }
+    }
+    return converted;
+  }
+
+  size_t _convertZhuyin(std::string_view input, std::string& output) const {
+    size_t converted = 0;
+    PackedReading reading;
+    size_t readingBegin = 0;
+    size_t readingEnd = 0;
+    auto flush = [&]() {
+      if (reading.isEmpty()) return;
+      if (_emit(reading, output)) {
+        converted++;
+      } else {
+        output += input.substr(readingBegin, readingEnd - readingBegin);
+      }
+      reading = PackedReading();
+    };
+    size_t i = 0;
+    while (i < input.size()) {
+      size_t length = utf8ByteCount(static_cast<unsigned char>(input[i]));
+      length = std::min(length, input.size() - i);
+      char32_t scalar = 0;
+      if (length == 2) {
+        scalar = ((input[i] & 0x1F) << 6) | (input[i + 1] & 0x3F);
+      } else if (length == 3) {
+        scalar = ((input[i] & 0x0F) << 12) | ((input[i + 1] & 0x3F) << 6) |
+                 (input[i + 2] & 0x3F);
+      }
+      PhoneType type = PackedReading::typeOf(scalar);
+      // 陰平的空格在這裡當作分隔符號處理。
+      if (type == PhoneType::null || scalar == U' ') {
+        flush();
+        output.append(input.data() + i, length);
+        i += length;
+        continue;
+      }
+      // 已填的槽位不在新符號之前的話，表示這是下一個讀音的開頭。
+      bool startsNext = false;
+      for (int slot = type; slot <= PhoneType::intonation; slot++) {
+        startsNext |= reading.indexAt(static_cast<PhoneType>(slot)) != 0;
+      }
+      if (startsNext) flush();
+      if (reading.isEmpty()) readingBegin = i;
+      reading = reading.with(scalar);
+      i += length;
+      readingEnd = i;
+      if (type == PhoneType::intonation) flush();
+    }
+    flush();
+    return converted;
+  }
+};
+
+}  // namespace TekkonConvert
+
+#endif  // TEKKON_CONVERT_HH_